@@ -0,0 +1,265 @@
+#include "csftools.h"
+
+static char *
+CSFBatch_Copy(CSFBatch *Batch, const char *String, size_t StringLength)
+{
+    char *Copy;
+
+    if((Copy = arena_alloc(Batch->Arena, StringLength + 1)))
+    {
+        memcpy(Copy, String, StringLength);
+        Copy[StringLength] = '\0';
+    }
+
+    return Copy;
+}
+
+CSFBatch *
+CSFBatch_Create(CSFContext *Context, int ToCSF)
+{
+    CSFBatch *Batch;
+
+    // With ToCSF, every job converts a STR file to a CSF file, otherwise a CSF file to a STR file
+    if(!(Batch = calloc_c(Context, 1, sizeof(CSFBatch))))
+    {
+        return NULL;
+    }
+
+    Batch->Context = Context;
+    Batch->ToCSF = ToCSF;
+
+    if(!(Batch->Arena = arena_create(Context, ARENA_BLOCK_MIN)))
+    {
+        free(Batch);
+        return NULL;
+    }
+
+    return Batch;
+}
+
+int
+CSFBatch_Add(CSFBatch *Batch, const char *InputPath, const char *OutputPath, const char *LanguageString)
+{
+    CSFBatchJob *Job;
+
+    // LanguageString is only used with ToCSF, it's checked when the job runs so a wrong one only fails that job
+    // All jobs run at the same time, so none of them can read from stdin or write to stdout
+    if(!strcmp(InputPath, "-") || !strcmp(OutputPath, "-"))
+    {
+        return csf_error(Batch->Context, CSF_ERROR_OPEN, "stdin and stdout can't be used in a batch", "", 0);
+    }
+
+    if(Batch->NumJobs == Batch->JobCapacity)
+    {
+        if(!(Job = realloc_c(Batch->Context, Batch->Job, (Batch->JobCapacity ? Batch->JobCapacity * 2 : 16) * sizeof(CSFBatchJob))))
+        {
+            return Batch->Context->Error;
+        }
+
+        Batch->Job = Job;
+        Batch->JobCapacity = Batch->JobCapacity ? Batch->JobCapacity * 2 : 16;
+    }
+
+    Job = &Batch->Job[Batch->NumJobs];
+    memset(Job, 0, sizeof(CSFBatchJob));
+
+    if(!(Job->InputPath = CSFBatch_Copy(Batch, InputPath, strlen(InputPath)))
+        || !(Job->OutputPath = CSFBatch_Copy(Batch, OutputPath, strlen(OutputPath)))
+        || (LanguageString && !(Job->LanguageString = CSFBatch_Copy(Batch, LanguageString, strlen(LanguageString)))))
+    {
+        return Batch->Context->Error;
+    }
+
+    Batch->NumJobs++;
+
+    return CSF_OK;
+}
+
+int
+CSFBatch_AddList(CSFBatch *Batch, char *ListFile_Path)
+{
+    STRReader *Reader;
+    char *Line, *Field[3];
+    char *Fields = NULL;
+    size_t Line_Len, i;
+    int NumFields, NumFields_Expected = Batch->ToCSF ? 3 : 2;
+
+    // A list file has one job per line, an input and an output file and, with ToCSF, a language, separated by spaces or tabs
+    // Blank lines and lines starting with // are skipped, just like in STR files, whose reader reads the list as well
+    if(!(Reader = STRReader_Open(Batch->Context, ListFile_Path, 0)))
+    {
+        return Batch->Context->Error;
+    }
+
+    while(!Batch->Context->Error && (Line = STRReader_NextLine(Reader, &Line_Len)))
+    {
+        if(!Line_Len || (Line_Len > 1 && Line[0] == '/' && Line[1] == '/'))
+        {
+            continue;
+        }
+
+        // Split a null-terminated copy of the line into its fields
+        free(Fields);
+
+        if(!(Fields = malloc_c(Batch->Context, Line_Len + 1)))
+        {
+            break;
+        }
+
+        memcpy(Fields, Line, Line_Len);
+        Fields[Line_Len] = '\0';
+
+        for(i = 0, NumFields = 0; i < Line_Len;)
+        {
+            if(NumFields == NumFields_Expected)
+            {
+                NumFields++;
+                break;
+            }
+
+            Field[NumFields++] = Fields + i;
+
+            while(i < Line_Len && !isspace((unsigned char)Fields[i]))
+            {
+                i++;
+            }
+
+            while(i < Line_Len && isspace((unsigned char)Fields[i]))
+            {
+                Fields[i++] = '\0';
+            }
+        }
+
+        if(NumFields != NumFields_Expected)
+        {
+            csf_error(Batch->Context, CSF_ERROR_FORMAT, Batch->ToCSF ? "Malformed list file, expected an input file, an output file and a language" : "Malformed list file, expected an input file and an output file", "", 0);
+            Batch->Context->ErrorLine = Reader->Line;
+
+            break;
+        }
+
+        CSFBatch_Add(Batch, Field[0], Field[1], Batch->ToCSF ? Field[2] : NULL);
+    }
+
+    free(Fields);
+    STRReader_Close(Reader);
+
+    return Batch->Context->Error;
+}
+
+int
+CSFBatch_AddDirectory(CSFBatch *Batch, const char *Directory, const char *Pattern, const char *LanguageString)
+{
+    char **Names;
+    char *InputPath, *OutputPath, *Extension;
+    uint32_t NumNames, NumJobs = Batch->NumJobs;
+    size_t Directory_Len = strlen(Directory);
+    uint32_t i;
+
+    // Add a job for every file in Directory that matches Pattern, the output goes next to it with its extension replaced by .csf or .str
+    if(!(Names = dir_list(Batch->Arena, Directory, &NumNames)))
+    {
+        return Batch->Context->Error;
+    }
+
+    for(i = 0; i < NumNames && !Batch->Context->Error; i++)
+    {
+        if(!wildcard_match(Pattern, Names[i]))
+        {
+            continue;
+        }
+
+        if(!(InputPath = arena_alloc(Batch->Arena, Directory_Len + strlen(Names[i]) + 2))
+            || !(OutputPath = arena_alloc(Batch->Arena, Directory_Len + strlen(Names[i]) + 6)))
+        {
+            break;
+        }
+
+        sprintf(InputPath, "%s/%s", Directory, Names[i]);
+        strcpy(OutputPath, InputPath);
+
+        if((Extension = strrchr(OutputPath + Directory_Len + 1, '.')))
+        {
+            *Extension = '\0';
+        }
+
+        strcat(OutputPath, Batch->ToCSF ? ".csf" : ".str");
+
+        CSFBatch_Add(Batch, InputPath, OutputPath, LanguageString);
+    }
+
+    if(!Batch->Context->Error && Batch->NumJobs == NumJobs)
+    {
+        csf_error(Batch->Context, CSF_ERROR_OPEN, "No files in the directory match ", Pattern, strlen(Pattern));
+    }
+
+    return Batch->Context->Error;
+}
+
+static void *
+CSFBatch_RunJob(void *Args)
+{
+    CSFBatchJob *Job = Args;
+
+    // Each file is converted on a single thread, the batch runs several of them at the same time instead
+    if(Job->Batch->ToCSF)
+    {
+        if(!STRFile_ConvertToCSFFile(&Job->Context, Job->InputPath, Job->OutputPath, Job->LanguageString, 1, Job->Batch->Pipelined) && Job->Batch->WriteIndex)
+        {
+            CSFIndexFile_Write(&Job->Context, Job->OutputPath, NULL);
+        }
+    }
+    else
+    {
+        if(!CSFFile_ConvertToSTRFile(&Job->Context, Job->InputPath, Job->OutputPath, 1, Job->Batch->Pipelined) && Job->Batch->WriteIndex)
+        {
+            CSFIndexFile_Write(&Job->Context, Job->InputPath, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+uint32_t
+CSFBatch_Run(CSFBatch *Batch, int NumThreads)
+{
+    uint32_t NumFailed = 0;
+    uint32_t i;
+
+    // Run all jobs on a pool of NumThreads threads, returns the number of jobs that failed
+    // Whatever went wrong is in the context of each job
+    for(i = 0; i < Batch->NumJobs; i++)
+    {
+        Batch->Job[i].Batch = Batch;
+
+        CSFContext_Init(&Batch->Job[i].Context);
+        Batch->Job[i].Context.Log = Batch->Log;
+        Batch->Job[i].Context.UserData = &Batch->Job[i];
+        Batch->Job[i].Context.Stats = Batch->Context->Stats;
+    }
+
+    threads_run_pool(NumThreads, CSFBatch_RunJob, Batch->Job, sizeof(CSFBatchJob), Batch->NumJobs);
+
+    for(i = 0; i < Batch->NumJobs; i++)
+    {
+        if(Batch->Job[i].Context.Error)
+        {
+            NumFailed++;
+        }
+    }
+
+    return NumFailed;
+}
+
+void
+CSFBatch_Free(CSFBatch *Batch)
+{
+    if(Batch == NULL)
+    {
+        return;
+    }
+
+    arena_free(Batch->Arena);
+    free(Batch->Job);
+    free(Batch);
+}
@@ -0,0 +1,498 @@
+#include "csftools.h"
+
+#include <time.h>
+#include <sys/resource.h>
+
+#define TOOLNAME "csfbench"
+
+typedef struct BenchState BenchState;
+typedef struct BenchResult BenchResult;
+
+struct BenchState
+{
+    CSFContext *Context;
+    char *CSFFile_Path;
+    char *STRFile_Path;
+    int NumThreads;
+    CSFFile *CSFFile;
+    CSFFile *STRFile;
+    CSFTable *CSFTable;
+    CSFTable *STRTable;
+};
+
+struct BenchResult
+{
+    const char *Name;
+    uint64_t Bytes;
+    uint32_t NumLabels;
+    double Best;
+    double Mean;
+    long PeakRSS;
+};
+
+static void
+printf_help_exit()
+{
+    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    printf("%s supports the following arguments:\n\n", TOOLNAME);
+    printf("%s [-r runs] [-j threads] [-c commit] [-o results.json] <csf file> <str file> to time reading and writing both files\n", TOOLNAME);
+    printf("-r is how often each part runs, the best and the mean time are reported, 5 by default\n");
+    printf("-j also times the parallel parsers on the given number of threads\n");
+    printf("-c is stored in the results to tell them apart, i.e. a git commit\n");
+    printf("-o writes the results as json, - for stdout\n\n");
+    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
+    exit(1);
+}
+
+static double
+time_now()
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+
+    return Now.tv_sec + Now.tv_nsec / 1e9;
+}
+
+static void
+rss_reset()
+{
+    FILE *Handle;
+
+    // Linux can reset the peak RSS of a process, so every part gets its own, everywhere else it's the peak of the whole run
+    if((Handle = fopen("/proc/self/clear_refs", "w")))
+    {
+        fputs("5", Handle);
+        fclose(Handle);
+    }
+}
+
+static long
+rss_peak()
+{
+    struct rusage Usage;
+    FILE *Handle;
+    char Line[256];
+    long PeakRSS = -1;
+
+    // In KB
+    if((Handle = fopen("/proc/self/status", "r")))
+    {
+        while(fgets(Line, sizeof(Line), Handle))
+        {
+            if(!strncmp(Line, "VmHWM:", 6))
+            {
+                PeakRSS = strtol(Line + 6, NULL, 10);
+            }
+        }
+
+        fclose(Handle);
+    }
+
+    if(PeakRSS < 0 && !getrusage(RUSAGE_SELF, &Usage))
+    {
+        PeakRSS = Usage.ru_maxrss;
+    }
+
+    return PeakRSS;
+}
+
+static int
+bench_parse(BenchState *State, int NumThreads, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    CSFReader *Reader;
+    CSFArena *Arena = NULL;
+    CSFHeader *CSFFile_Header = NULL;
+
+    if((Reader = CSFReader_Open(State->Context, State->CSFFile_Path, 1))
+        && (Arena = arena_create(State->Context, Reader->Header.NumLabels * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString)))))
+    {
+        CSFFile_Header = CSFFileHeader_ParseParallel(Reader, Arena, NumThreads);
+    }
+
+    if(CSFFile_Header)
+    {
+        *Bytes = Reader->Size;
+        *NumLabels = CSFFile_Header->NumLabels;
+    }
+
+    arena_free(Arena);
+    CSFReader_Close(Reader);
+
+    return State->Context->Error;
+}
+
+static int
+bench_csf_parse(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_parse(State, 1, Bytes, NumLabels);
+}
+
+static int
+bench_csf_parse_parallel(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_parse(State, State->NumThreads, Bytes, NumLabels);
+}
+
+static int
+bench_create(BenchState *State, int NumThreads, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    STRReader *Reader;
+    CSFArena *Arena = NULL;
+    CSFHeader *CSFFile_Header = NULL;
+
+    if((Reader = STRReader_Open(State->Context, State->STRFile_Path, 1))
+        && (Arena = arena_create(State->Context, (Reader->Mapped ? Reader->Size : STRREADER_WINDOW_SIZE) / 32 * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString)))))
+    {
+        if(Reader->Mapped && NumThreads > 1)
+        {
+            CSFFile_Header = CSFFileHeader_CreateParallel(Reader, CSF_LANGUAGE_ID_ENUS, Arena, NULL, NumThreads);
+        }
+        else
+        {
+            CSFFile_Header = CSFFileHeader_Create(Reader, CSF_LANGUAGE_ID_ENUS, Arena, NULL);
+        }
+    }
+
+    if(CSFFile_Header)
+    {
+        *Bytes = Reader->Size;
+        *NumLabels = CSFFile_Header->NumLabels;
+    }
+
+    arena_free(Arena);
+    STRReader_Close(Reader);
+
+    return State->Context->Error;
+}
+
+static int
+bench_str_create(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_create(State, 1, Bytes, NumLabels);
+}
+
+static int
+bench_str_create_parallel(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_create(State, State->NumThreads, Bytes, NumLabels);
+}
+
+static int
+bench_write(BenchState *State, int ToCSF, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    CSFHeader *CSFFile_Header = ToCSF ? State->STRFile->CSFFile_Header : State->CSFFile->CSFFile_Header;
+    CSFWriteBuffer *Buffer = NULL;
+    FILE *Handle;
+    uint32_t i;
+
+    // Writes the Labels that were read from the other file into a temporary file, so both writers get the same Labels as in a conversion
+    if(!(Handle = tmpfile()))
+    {
+        return csf_error(State->Context, CSF_ERROR_OPEN, "Couldn't create a temporary file", "", 0);
+    }
+
+    if((Buffer = writebuffer_create(State->Context, Handle)))
+    {
+        if(ToCSF)
+        {
+            writebuffer_write(Buffer, CSFFile_Header, sizeof(CSFHeader));
+        }
+
+        for(i = 0; i < CSFFile_Header->NumLabels; i++)
+        {
+            if(ToCSF)
+            {
+                CSFFile_WriteLabel(Buffer, CSFFile_Header->Label[i]);
+            }
+            else
+            {
+                STRFile_WriteLabel(Buffer, CSFFile_Header->Label[i]);
+            }
+        }
+
+        writebuffer_close(Buffer);
+    }
+
+    *Bytes = ftell(Handle);
+    *NumLabels = CSFFile_Header->NumLabels;
+
+    fclose(Handle);
+
+    return State->Context->Error;
+}
+
+static int
+bench_csf_write(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_write(State, 1, Bytes, NumLabels);
+}
+
+static int
+bench_str_write(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_write(State, 0, Bytes, NumLabels);
+}
+
+static int
+bench_table_load(BenchState *State, int FromCSF, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    CSFTable *Table;
+    char *Path = FromCSF ? State->CSFFile_Path : State->STRFile_Path;
+
+    if((Table = CSFTable_Load(State->Context, Path, CSF_LANGUAGE_ID_ENUS)))
+    {
+        *Bytes = FromCSF ? State->CSFFile->CSFReader->Size : State->STRFile->STRReader->Size;
+        *NumLabels = Table->Header.NumLabels;
+    }
+
+    CSFTable_Free(Table);
+
+    return State->Context->Error;
+}
+
+static int
+bench_csf_table_load(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_table_load(State, 1, Bytes, NumLabels);
+}
+
+static int
+bench_str_table_load(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_table_load(State, 0, Bytes, NumLabels);
+}
+
+static int
+bench_table_write(BenchState *State, int ToCSF, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    CSFTable *Table = ToCSF ? State->STRTable : State->CSFTable;
+    CSFWriteBuffer *Buffer = NULL;
+    CSFLabel Label;
+    CSFString String;
+    FILE *Handle;
+    uint32_t i;
+
+    // Same as bench_write, but the Labels come from a CSFTable
+    if(!(Handle = tmpfile()))
+    {
+        return csf_error(State->Context, CSF_ERROR_OPEN, "Couldn't create a temporary file", "", 0);
+    }
+
+    if((Buffer = writebuffer_create(State->Context, Handle)))
+    {
+        if(ToCSF)
+        {
+            writebuffer_write(Buffer, &Table->Header, sizeof(CSFHeader));
+        }
+
+        for(i = 0; i < Table->Header.NumLabels; i++)
+        {
+            CSFTable_GetLabel(Table, i, &Label, &String);
+
+            if(ToCSF)
+            {
+                CSFFile_WriteLabel(Buffer, &Label);
+            }
+            else
+            {
+                STRFile_WriteLabel(Buffer, &Label);
+            }
+        }
+
+        writebuffer_close(Buffer);
+    }
+
+    *Bytes = ftell(Handle);
+    *NumLabels = Table->Header.NumLabels;
+
+    fclose(Handle);
+
+    return State->Context->Error;
+}
+
+static int
+bench_csf_table_write(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_table_write(State, 1, Bytes, NumLabels);
+}
+
+static int
+bench_str_table_write(BenchState *State, uint64_t *Bytes, uint32_t *NumLabels)
+{
+    return bench_table_write(State, 0, Bytes, NumLabels);
+}
+
+static int
+bench_run(BenchState *State, const char *Name, int (*Function)(BenchState *, uint64_t *, uint32_t *), int Runs, BenchResult *Result)
+{
+    double Start, Time;
+    int i;
+
+    memset(Result, 0, sizeof(BenchResult));
+    Result->Name = Name;
+
+    rss_reset();
+
+    for(i = 0; i < Runs; i++)
+    {
+        Start = time_now();
+
+        if(Function(State, &Result->Bytes, &Result->NumLabels))
+        {
+            return State->Context->Error;
+        }
+
+        Time = time_now() - Start;
+
+        if(!i || Time < Result->Best)
+        {
+            Result->Best = Time;
+        }
+
+        Result->Mean += Time / Runs;
+    }
+
+    Result->PeakRSS = rss_peak();
+
+    printf("%-32s %10.1f MB/s %10.2f M labels/s %10ld KB peak RSS\n", Name, Result->Bytes / Result->Best / 1e6, Result->NumLabels / Result->Best / 1e6, Result->PeakRSS);
+
+    return CSF_OK;
+}
+
+static void
+fprintf_json_string(FILE *Stream, const char *String)
+{
+    fputc('"', Stream);
+
+    for(; *String; String++)
+    {
+        if(*String == '"' || *String == '\\')
+        {
+            fputc('\\', Stream);
+        }
+
+        fputc(*String, Stream);
+    }
+
+    fputc('"', Stream);
+}
+
+static int
+write_json(char *Path, BenchState *State, const char *Commit, int Runs, BenchResult *Result, int NumResults)
+{
+    FILE *Handle;
+    int i;
+
+    if(!(Handle = fopen_c(State->Context, Path, "w")))
+    {
+        return State->Context->Error;
+    }
+
+    fprintf(Handle, "{\n    \"tool\": \"%s\",\n    \"version\": \"%i.%i\",\n    \"commit\": ", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    fprintf_json_string(Handle, Commit);
+    fprintf(Handle, ",\n    \"csf_file\": ");
+    fprintf_json_string(Handle, State->CSFFile_Path);
+    fprintf(Handle, ",\n    \"str_file\": ");
+    fprintf_json_string(Handle, State->STRFile_Path);
+    fprintf(Handle, ",\n    \"runs\": %i,\n    \"threads\": %i,\n    \"results\":\n    [\n", Runs, State->NumThreads);
+
+    for(i = 0; i < NumResults; i++)
+    {
+        fprintf(Handle, "        { \"name\": \"%s\", \"bytes\": %llu, \"labels\": %u, \"best_seconds\": %.6f, \"mean_seconds\": %.6f, \"mb_per_s\": %.2f, \"labels_per_s\": %.0f, \"peak_rss_kb\": %ld }%s\n",
+            Result[i].Name, (unsigned long long)Result[i].Bytes, Result[i].NumLabels, Result[i].Best, Result[i].Mean,
+            Result[i].Bytes / Result[i].Best / 1e6, Result[i].NumLabels / Result[i].Best, Result[i].PeakRSS, i + 1 < NumResults ? "," : "");
+    }
+
+    fprintf(Handle, "    ]\n}\n");
+
+    if(fclose_c(Handle))
+    {
+        return csf_error(State->Context, CSF_ERROR_WRITE, "Couldn't write to ", Path, strlen(Path));
+    }
+
+    return CSF_OK;
+}
+
+int
+main(int argc, char *argv[])
+{
+    CSFContext Context;
+    BenchState State;
+    BenchResult Result[10];
+    char *JSONFile_Path = NULL;
+    char *Commit = "";
+    int NumResults = 0;
+    int Runs = 5;
+    int i;
+
+    memset(&State, 0, sizeof(BenchState));
+    State.NumThreads = 1;
+
+    for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if(!strcmp(argv[i], "-r") && i + 1 < argc)
+        {
+            Runs = atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            State.NumThreads = atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-c") && i + 1 < argc)
+        {
+            Commit = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            JSONFile_Path = argv[++i];
+        }
+        else
+        {
+            printf_help_exit();
+        }
+    }
+
+    if(argc - i != 2 || Runs < 1 || State.NumThreads < 1)
+    {
+        printf_help_exit();
+    }
+
+    CSFContext_Init(&Context);
+    State.Context = &Context;
+    State.CSFFile_Path = argv[i];
+    State.STRFile_Path = argv[i + 1];
+
+    // The writers write what was read from the other file, so both are read once up front, and once more as tables for the table writers
+    if((State.CSFFile = CSFFile_Load(&Context, State.CSFFile_Path, CSF_LANGUAGE_ID_ENUS, 1))
+        && (State.STRFile = CSFFile_Load(&Context, State.STRFile_Path, CSF_LANGUAGE_ID_ENUS, 1))
+        && !bench_run(&State, "CSFFileHeader_Parse", bench_csf_parse, Runs, &Result[NumResults++])
+        && (State.NumThreads < 2 || !bench_run(&State, "CSFFileHeader_ParseParallel", bench_csf_parse_parallel, Runs, &Result[NumResults++]))
+        && !bench_run(&State, "CSFFileHeader_Create", bench_str_create, Runs, &Result[NumResults++])
+        && (State.NumThreads < 2 || !bench_run(&State, "CSFFileHeader_CreateParallel", bench_str_create_parallel, Runs, &Result[NumResults++]))
+        && !bench_run(&State, "CSFFile_WriteLabel", bench_csf_write, Runs, &Result[NumResults++])
+        && !bench_run(&State, "STRFile_WriteLabel", bench_str_write, Runs, &Result[NumResults++])
+        && !bench_run(&State, "CSFTable_Load csf", bench_csf_table_load, Runs, &Result[NumResults++])
+        && !bench_run(&State, "CSFTable_Load str", bench_str_table_load, Runs, &Result[NumResults++])
+        && (State.CSFTable = CSFTable_Load(&Context, State.CSFFile_Path, CSF_LANGUAGE_ID_ENUS))
+        && (State.STRTable = CSFTable_Load(&Context, State.STRFile_Path, CSF_LANGUAGE_ID_ENUS))
+        && !bench_run(&State, "CSFTable csf write", bench_csf_table_write, Runs, &Result[NumResults++])
+        && !bench_run(&State, "CSFTable str write", bench_str_table_write, Runs, &Result[NumResults++])
+        && JSONFile_Path)
+    {
+        write_json(JSONFile_Path, &State, Commit, Runs, Result, NumResults);
+    }
+
+    CSFFile_Free(State.CSFFile);
+    CSFFile_Free(State.STRFile);
+    CSFTable_Free(State.CSFTable);
+    CSFTable_Free(State.STRTable);
+
+    if(Context.Error)
+    {
+        printf("Error: %s%s\n", Context.ErrorMessage, Context.ErrorDetail);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,223 @@
+#include "csftools.h"
+
+#define TOOLNAME "csfgen"
+
+static const char *Categories[] = { "GUI", "OBJECT", "TOOLTIP", "CONTROLBAR", "MAP", "DIALOGEVENT", "SCRIPT", "LOAD" };
+
+static void
+printf_help_exit()
+{
+    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    printf("%s supports the following arguments:\n\n", TOOLNAME);
+    printf("%s [options] <output> to write a csf or str file full of made up labels, depending on the extension of output\n", TOOLNAME);
+    printf("-n labels is the number of labels, 100000 by default\n");
+    printf("-s seed picks other labels, the same seed always gives the same file\n");
+    printf("-l min and -L max are the shortest and longest value, 0 and 200 by default\n");
+    printf("-d uniform or -d exp picks value lengths evenly between min and max, or mostly short ones with a mean of about a quarter of max\n");
+    printf("-N permille is how many of every 1000 chars of a value are newlines, 10 by default\n");
+    printf("-e permille is how many of every 1000 labels have an empty value, 20 by default\n");
+    printf("-w permille is how many of every 1000 labels are STRW with an extra value, 0 by default\n\n");
+    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
+    exit(1);
+}
+
+static uint64_t
+random_next(uint64_t *State)
+{
+    uint64_t Value;
+
+    // splitmix64, good enough for made up text and the same on every platform
+    Value = (*State += 0x9E3779B97F4A7C15ULL);
+    Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBULL;
+
+    return Value ^ (Value >> 31);
+}
+
+static uint32_t
+random_below(uint64_t *State, uint32_t Limit)
+{
+    return Limit ? (uint32_t)(random_next(State) % Limit) : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    CSFContext Context;
+    FILE *Handle;
+    CSFWriteBuffer *Buffer = NULL;
+    CSFHeader CSFFile_Header;
+    CSFLabel Label;
+    CSFString String;
+    char LabelName[64];
+    char *Value = NULL;
+    uint8_t ExtraValue[16];
+    uint64_t State = 1;
+    uint32_t NumLabels = 100000;
+    uint32_t MinLength = 0, MaxLength = 200;
+    uint32_t NewlinePermille = 10, EmptyPermille = 20, STRWPermille = 0;
+    uint32_t ExtraValueLength, Length, i, j;
+    int Exponential = 0;
+    int IsCSF;
+    size_t Path_Len;
+    int k;
+
+    for(k = 1; k < argc - 1; k++)
+    {
+        if(!strcmp(argv[k], "-n"))
+        {
+            NumLabels = strtoul(argv[++k], NULL, 10);
+        }
+        else if(!strcmp(argv[k], "-s"))
+        {
+            State = strtoull(argv[++k], NULL, 10);
+        }
+        else if(!strcmp(argv[k], "-l"))
+        {
+            MinLength = strtoul(argv[++k], NULL, 10);
+        }
+        else if(!strcmp(argv[k], "-L"))
+        {
+            MaxLength = strtoul(argv[++k], NULL, 10);
+        }
+        else if(!strcmp(argv[k], "-d") && !strcmp(argv[k + 1], "uniform"))
+        {
+            Exponential = 0;
+            k++;
+        }
+        else if(!strcmp(argv[k], "-d") && !strcmp(argv[k + 1], "exp"))
+        {
+            Exponential = 1;
+            k++;
+        }
+        else if(!strcmp(argv[k], "-N"))
+        {
+            NewlinePermille = strtoul(argv[++k], NULL, 10);
+        }
+        else if(!strcmp(argv[k], "-e"))
+        {
+            EmptyPermille = strtoul(argv[++k], NULL, 10);
+        }
+        else if(!strcmp(argv[k], "-w"))
+        {
+            STRWPermille = strtoul(argv[++k], NULL, 10);
+        }
+        else
+        {
+            printf_help_exit();
+        }
+    }
+
+    if(k != argc - 1 || MinLength > MaxLength)
+    {
+        printf_help_exit();
+    }
+
+    Path_Len = strlen(argv[k]);
+    IsCSF = Path_Len >= 4 && !strcmp(argv[k] + Path_Len - 4, ".csf");
+
+    CSFContext_Init(&Context);
+
+    if(!(Value = malloc_c(&Context, MaxLength + (size_t)1)))
+    {
+        return 1;
+    }
+
+    if((Handle = fopen_c(&Context, argv[k], "wb")))
+    {
+        Buffer = writebuffer_create(&Context, Handle);
+    }
+
+    if(Buffer && IsCSF)
+    {
+        CSFFileHeader_Init(&CSFFile_Header, CSF_LANGUAGE_ID_ENUS);
+        CSFFile_Header.NumLabels = CSFFile_Header.NumStrings = NumLabels;
+
+        writebuffer_write(Buffer, &CSFFile_Header, sizeof(CSFHeader));
+    }
+
+    Label.MagicHeader = LBL_MAGIC;
+    Label.NumStringPairs = 1;
+    Label.LabelName = LabelName;
+    Label.String = &String;
+    String.Value = Value;
+    String.ExtraValue = ExtraValue;
+
+    for(i = 0; i < NumLabels && Buffer && !Context.Error; i++)
+    {
+        Label.LabelNameLength = sprintf(LabelName, "%s:Label%u", Categories[random_below(&State, sizeof(Categories) / sizeof(Categories[0]))], i);
+
+        // Exponential lengths are really geometric, every char gets another one after it with the same chance, which needs no floating point
+        if(random_below(&State, 1000) < EmptyPermille)
+        {
+            Length = 0;
+        }
+        else if(Exponential)
+        {
+            for(Length = MinLength; Length < MaxLength && random_below(&State, (MaxLength - MinLength) / 4 + 1); Length++);
+        }
+        else
+        {
+            Length = MinLength + random_below(&State, MaxLength - MinLength + 1);
+        }
+
+        // Printable ASCII with spaces more often than anything else, like text
+        for(j = 0; j < Length; j++)
+        {
+            if(random_below(&State, 1000) < NewlinePermille)
+            {
+                Value[j] = '\n';
+            }
+            else if(!random_below(&State, 6))
+            {
+                Value[j] = ' ';
+            }
+            else
+            {
+                Value[j] = (char)(0x21 + random_below(&State, 0x7F - 0x21));
+            }
+        }
+
+        String.ValueLength = Length;
+
+        ExtraValueLength = random_below(&State, 1000) < STRWPermille ? 1 + random_below(&State, sizeof(ExtraValue)) : 0;
+
+        // Made up names of speech files
+        for(j = 0; j < ExtraValueLength; j++)
+        {
+            ExtraValue[j] = (uint8_t)('a' + random_below(&State, 26));
+        }
+
+        String.MagicHeader = ExtraValueLength ? STRW_MAGIC : STR_MAGIC;
+        String.ExtraValueLength = ExtraValueLength;
+
+        if(IsCSF)
+        {
+            CSFFile_WriteLabel(Buffer, &Label);
+        }
+        else
+        {
+            STRFile_WriteLabel(Buffer, &Label);
+        }
+    }
+
+    if(Buffer)
+    {
+        writebuffer_close(Buffer);
+    }
+
+    if(Handle && fclose_c(Handle))
+    {
+        csf_error(&Context, CSF_ERROR_WRITE, "Couldn't write to ", argv[k], strlen(argv[k]));
+    }
+
+    free(Value);
+
+    if(Context.Error)
+    {
+        printf("Error: %s%s\n", Context.ErrorMessage, Context.ErrorDetail);
+        return 1;
+    }
+
+    return 0;
+}
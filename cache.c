@@ -0,0 +1,161 @@
+#include "csftools.h"
+
+CSFCache *
+CSFCache_Open(CSFContext *Context, char *CSFFile_Path)
+{
+    CSFContext ReaderContext;
+    CSFCache *Cache;
+    CSFCacheEntry *Entry;
+    CSFLabel *Label;
+    uint32_t i, Slot;
+
+    // Reads a previously written CSF file, so the Labels that didn't change can be copied from it instead of being encoded again
+    // If the file doesn't exist or is broken the cache is just empty and everything is encoded, so a first build works the same way
+    // Only returns NULL if there's no memory
+    if(!(Cache = calloc_c(Context, 1, sizeof(CSFCache))))
+    {
+        return NULL;
+    }
+
+    Cache->Context = Context;
+
+    // The reader gets a context of its own, its errors only mean there's nothing to copy
+    CSFContext_Init(&ReaderContext);
+    ReaderContext.Stats = Context->Stats;
+
+    if((Cache->Reader = CSFReader_Open(&ReaderContext, CSFFile_Path, 1)) && !Cache->Reader->Mapped)
+    {
+        csf_error(&ReaderContext, CSF_ERROR_OPEN, "Not a regular file", "", 0);
+    }
+
+    if(Cache->Reader && !ReaderContext.Error)
+    {
+        // Values stay encoded, only where each Label starts and ends is needed
+        Cache->Reader->Prescan = 1;
+        Cache->Complete = 1;
+
+        if(!(Cache->Entry = malloc_c(Context, Cache->Reader->Header.NumLabels * sizeof(CSFCacheEntry) + 1)))
+        {
+            CSFCache_Close(Cache);
+            return NULL;
+        }
+
+        while((Label = CSFReader_Next(Cache->Reader)))
+        {
+            // Labels from a STR file always have one String, anything else can't be the same as one of them
+            if(Label->NumStringPairs != 1)
+            {
+                Cache->Complete = 0;
+                continue;
+            }
+
+            Entry = &Cache->Entry[Cache->NumEntries++];
+            Entry->Offset = Cache->Reader->LabelOffset;
+            Entry->Size = Cache->Reader->Offset - Cache->Reader->LabelOffset;
+            Entry->LabelName = Label->LabelName;
+            Entry->LabelNameLength = Label->LabelNameLength;
+            Entry->MagicHeader = Label->String->MagicHeader;
+            Entry->EncodedValue = (uint8_t *)Label->String->Value;
+            Entry->ValueLength = Label->String->ValueLength;
+            Entry->ExtraValue = Label->String->ExtraValue;
+            Entry->ExtraValueLength = Label->String->ExtraValueLength;
+        }
+
+        // Complete means the entries are every byte of the file after its header, in order
+        if(Cache->Reader->Offset != Cache->Reader->Size)
+        {
+            Cache->Complete = 0;
+        }
+    }
+
+    if(ReaderContext.Error)
+    {
+        csf_log(Context, ReaderContext.Error == CSF_ERROR_OPEN ? CSF_LOG_INFO : CSF_LOG_WARNING, "Couldn't use %s as the previous CSF file, all Labels are encoded again: %s%s", CSFFile_Path, ReaderContext.ErrorMessage, ReaderContext.ErrorDetail);
+
+        CSFReader_Close(Cache->Reader);
+        Cache->Reader = NULL;
+        Cache->NumEntries = 0;
+        Cache->Complete = 0;
+    }
+
+    // The reader's own context ends here, CSFReader_Close still needs one
+    if(Cache->Reader)
+    {
+        Cache->Reader->Context = Context;
+    }
+
+    // Same as the hash table of CSFIndex, but with exact LabelNames since the bytes have to be the same
+    for(Cache->NumSlots = 2; Cache->NumSlots < Cache->NumEntries * (uint64_t)2; Cache->NumSlots *= 2);
+
+    if(!(Cache->Slot = calloc_c(Context, Cache->NumSlots, sizeof(uint32_t))))
+    {
+        CSFCache_Close(Cache);
+        return NULL;
+    }
+
+    for(i = 0; i < Cache->NumEntries; i++)
+    {
+        Entry = &Cache->Entry[i];
+        Entry->Hash = CSFIndex_Hash(Entry->LabelName, Entry->LabelNameLength);
+
+        for(Slot = Entry->Hash & (Cache->NumSlots - 1); Cache->Slot[Slot]; Slot = (Slot + 1) & (Cache->NumSlots - 1))
+        {
+            if(Cache->Entry[Cache->Slot[Slot] - 1].LabelNameLength == Entry->LabelNameLength
+                && !memcmp(Cache->Entry[Cache->Slot[Slot] - 1].LabelName, Entry->LabelName, Entry->LabelNameLength))
+            {
+                break;
+            }
+        }
+
+        if(!Cache->Slot[Slot])
+        {
+            Cache->Slot[Slot] = i + 1;
+        }
+    }
+
+    return Cache;
+}
+
+CSFCacheEntry *
+CSFCache_Find(CSFCache *Cache, CSFLabel *Label)
+{
+    CSFCacheEntry *Entry;
+    uint64_t Hash;
+    uint32_t Slot;
+
+    // Returns the entry of the previous CSF file with exactly this LabelName and value, or NULL if it changed or is new
+    Hash = CSFIndex_Hash(Label->LabelName, Label->LabelNameLength);
+
+    for(Slot = Hash & (Cache->NumSlots - 1); Cache->Slot[Slot]; Slot = (Slot + 1) & (Cache->NumSlots - 1))
+    {
+        Entry = &Cache->Entry[Cache->Slot[Slot] - 1];
+
+        if(Entry->Hash == Hash && Entry->LabelNameLength == Label->LabelNameLength && !memcmp(Entry->LabelName, Label->LabelName, Label->LabelNameLength))
+        {
+            if(Label->NumStringPairs != 1 || Label->String->MagicHeader != Entry->MagicHeader || Label->String->ExtraValueLength != Entry->ExtraValueLength
+                || (Entry->ExtraValueLength && memcmp(Label->String->ExtraValue, Entry->ExtraValue, Entry->ExtraValueLength)))
+            {
+                return NULL;
+            }
+
+            // The value is compared with the encoded one as it is, so only the Labels that changed are ever encoded
+            return CSFString_EqualEncoded(Label->String->Value, Label->String->ValueLength, Entry->EncodedValue, Entry->ValueLength) ? Entry : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+void
+CSFCache_Close(CSFCache *Cache)
+{
+    if(Cache == NULL)
+    {
+        return;
+    }
+
+    CSFReader_Close(Cache->Reader);
+    free(Cache->Entry);
+    free(Cache->Slot);
+    free(Cache);
+}
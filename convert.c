@@ -0,0 +1,514 @@
+#include "csftools.h"
+
+static void *
+CSFExporter_Thread(void *Args)
+{
+    CSFExporter *Exporter = Args;
+    uint32_t i;
+
+    // Writes all Labels to one output, every output has a thread of its own and only reads the Labels
+    for(i = 0; i < Exporter->CSFFile_Header->NumLabels && !Exporter->Context.Error; i++)
+    {
+        CSFExporter_WriteLabel(Exporter, Exporter->CSFFile_Header->Label[i]);
+    }
+
+    return NULL;
+}
+
+int
+CSFFile_Export(CSFContext *Context, char *CSFFile_Path, char **Output_Path, int NumOutputs, int NumThreads, int Pipelined, int Threaded)
+{
+    CSFReader *Reader = NULL;
+    CSFHeader *CSFFile_Header = NULL;
+    CSFLabel *Label = NULL;
+    CSFArena *Arena = NULL;
+    CSFExporter *Exporter = NULL;
+    char *LanguageString = NULL;
+    uint64_t TotalStart, Start;
+    uint32_t i;
+    int j, NumOpen = 0;
+
+    // Writes the Labels of a CSF file to NumOutputs files at once, each one as STR, JSON, CSV or PO depending on its extension, every value is only decoded once for all of them
+    // Decoding on several threads needs all values at once, so they're decoded in place then
+    // With Threaded, every output is written on a thread of its own, which needs all values at once as well
+    // Pipelined, the CSF file is read and the outputs written on threads of their own while Labels are decoded one at a time, NumThreads doesn't matter then
+    TotalStart = Start = csf_stats_start(Context);
+
+    Threaded = Threaded && NumOutputs > 1;
+
+    if(!(Reader = Pipelined ? CSFReader_OpenPipelined(Context, CSFFile_Path) : CSFReader_Open(Context, CSFFile_Path, NumThreads > 1 || Threaded)))
+    {
+        return Context->Error;
+    }
+
+    // Get LanguageString from CSF header
+    LanguageString = CSFFile_GetLanguageString(Reader->Header.Language);
+
+    if(!LanguageString)
+    {
+        csf_log(Context, CSF_LOG_WARNING, "The language of this CSF file was not recognized");
+    }
+    else
+    {
+        csf_log(Context, CSF_LOG_INFO, "The language of this CSF file is '%s'", LanguageString);
+    }
+
+    // Open every output, everything is written through a buffer of its own and flushed in large blocks
+    if((Exporter = calloc_c(Context, NumOutputs, sizeof(CSFExporter))))
+    {
+        for(NumOpen = 0; NumOpen < NumOutputs && !CSFExporter_Open(Context, &Exporter[NumOpen], Output_Path[NumOpen], &Reader->Header, Pipelined); NumOpen++);
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_OPEN, Start);
+
+    if(NumOpen == NumOutputs && (Reader->InPlace || Threaded))
+    {
+        // Decode all Labels on several threads first, then write them in order
+        // Values of a mapped file are decoded in place, so the arena only needs to hold the Label and String structs
+        Start = csf_stats_start(Context);
+
+        if((Arena = arena_create(Context, Reader->Header.NumLabels * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString))))
+            && (CSFFile_Header = CSFFileHeader_ParseParallel(Reader, Arena, NumThreads)))
+        {
+            csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+            Start = csf_stats_start(Context);
+
+            if(Threaded)
+            {
+                // Writing on several threads counts as the time until all of them are done
+                for(j = 0; j < NumOutputs; j++)
+                {
+                    Exporter[j].CSFFile_Header = CSFFile_Header;
+                }
+
+                threads_run(NumOutputs, CSFExporter_Thread, Exporter, sizeof(CSFExporter));
+            }
+            else
+            {
+                for(i = 0; i < CSFFile_Header->NumLabels && !Context->Error; i++)
+                {
+                    for(j = 0; j < NumOutputs; j++)
+                    {
+                        CSFExporter_WriteLabel(&Exporter[j], CSFFile_Header->Label[i]);
+                    }
+                }
+            }
+
+            csf_stats_stop(Context, CSF_STAT_TIME_WRITE, Start);
+        }
+    }
+    else if(NumOpen == NumOutputs)
+    {
+        // Each Label is written as soon as it's read, so memory use doesn't depend on the number of Labels
+        // With stats, reading and writing are timed separately for every Label
+        while(!Context->Error)
+        {
+            Start = csf_stats_start(Context);
+
+            if(!(Label = CSFReader_Next(Reader)))
+            {
+                break;
+            }
+
+            csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+            Start = csf_stats_start(Context);
+
+            for(j = 0; j < NumOutputs; j++)
+            {
+                CSFExporter_WriteLabel(&Exporter[j], Label);
+            }
+
+            csf_stats_stop(Context, CSF_STAT_TIME_WRITE, Start);
+        }
+    }
+
+    // Flush what's left, close every output, the first error of any of them is kept
+    Start = csf_stats_start(Context);
+
+    for(j = 0; j < NumOpen; j++)
+    {
+        CSFExporter_Close(&Exporter[j], Context);
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_WRITE, Start);
+
+    // Release all Labels and Strings at once, close CSF file, done
+    free(Exporter);
+    arena_free(Arena);
+    CSFReader_Close(Reader);
+
+    csf_stats_stop(Context, CSF_STAT_TIME_TOTAL, TotalStart);
+
+    return Context->Error;
+}
+
+int
+CSFFile_ConvertToSTRFile(CSFContext *Context, char *CSFFile_Path, char *STRFile_Path, int NumThreads, int Pipelined)
+{
+    // One output, as STR unless its extension says otherwise
+    return CSFFile_Export(Context, CSFFile_Path, &STRFile_Path, 1, NumThreads, Pipelined, 0);
+}
+
+int
+STRFile_ConvertToCSFFile(CSFContext *Context, char *STRFile_Path, char *CSFFile_Path, char *LanguageString, int NumThreads, int Pipelined)
+{
+    FILE *CSFFile_Handle = NULL;
+    char *TempFile_Path = NULL;
+    STRReader *Reader = NULL;
+    CSFImporter *Importer = NULL;
+    CSFHeader CSFFile_Header;
+    CSFHeader *CSFFile_FullHeader = NULL;
+    CSFLabel *Label = NULL;
+    CSFArena *Arena = NULL;
+    CSFIntern *Intern = NULL;
+    CSFWriteBuffer *CSFFile_Buffer = NULL;
+    uint32_t LanguageId;
+    uint64_t TotalStart, Start;
+
+    // Get LanguageId from argument
+    LanguageId = CSFFile_GetLanguageId(LanguageString);
+
+    if((int32_t)LanguageId == CSF_LANGUAGE_UNKNOWN)
+    {
+        return csf_error(Context, CSF_ERROR_LANGUAGE, "Unsupported language string, please refer to the readme for the available languages", "", 0);
+    }
+
+    csf_log(Context, CSF_LOG_INFO, "Creating CSF file with language '%s'", LanguageString);
+
+    // Open STR file
+    // Parsing on several threads needs the whole file at once, so Labels point into it then
+    // Pipelined, the STR file is read and the CSF file written on threads of their own while Labels are encoded one at a time, NumThreads doesn't matter then
+    // JSON, CSV and PO files are always read as a whole, see CSFImporter_Open
+    TotalStart = Start = csf_stats_start(Context);
+
+    if(CSFFile_GetFormat(STRFile_Path) >= CSF_FORMAT_JSON)
+    {
+        if(!(Importer = CSFImporter_Open(Context, STRFile_Path)))
+        {
+            return Context->Error;
+        }
+    }
+    else if(!(Reader = Pipelined ? STRReader_OpenPipelined(Context, STRFile_Path) : STRReader_Open(Context, STRFile_Path, NumThreads > 1)))
+    {
+        return Context->Error;
+    }
+
+    // Open output CSF file, everything is written through a buffer and flushed in large blocks
+    // It's written to a temporary file first, a STR file with an error halfway through leaves the previous CSF file as it was
+    if((CSFFile_Handle = fopen_replace(Context, CSFFile_Path, &TempFile_Path)))
+    {
+        CSFFile_Buffer = Pipelined ? writebuffer_create_pipelined(Context, CSFFile_Handle) : writebuffer_create(Context, CSFFile_Handle);
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_OPEN, Start);
+    Start = csf_stats_start(Context);
+
+    CSFFileHeader_Init(&CSFFile_Header, LanguageId);
+
+    if(CSFFile_Buffer && Importer)
+    {
+        // Imported Labels go the same way as those of a STR file parsed on several threads, values many Labels have are only encoded once
+        if((Arena = arena_create(Context, Importer->Size / 32 * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString))))
+            && (Intern = CSFIntern_Create(Context, Arena, Importer->Size)))
+        {
+            CSFFile_FullHeader = CSFFileHeader_Import(Importer, LanguageId, Arena, Intern);
+        }
+
+        csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+    }
+    else if(CSFFile_Buffer && Reader->Mapped && NumThreads > 1)
+    {
+        // Parse the STR file on several threads first, LabelNames and values stay in the STR file so the arena only needs to hold the Label and String structs
+        // Labels with the same value share one String, which is then only encoded once
+        if((Arena = arena_create(Context, Reader->Size / 32 * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString))))
+            && (Intern = CSFIntern_Create(Context, Arena, 0)))
+        {
+            CSFFile_FullHeader = CSFFileHeader_CreateParallel(Reader, LanguageId, Arena, Intern, NumThreads);
+        }
+
+        csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+    }
+    else if(CSFFile_Buffer && !fseek(CSFFile_Handle, 0, SEEK_CUR))
+    {
+        // Write a placeholder CSFHeader, then write each Label as soon as it's read, so memory use doesn't depend on the number of Labels
+        // NumLabels and NumStrings are only known at the end, so seek back and write the real CSFHeader then, unless reading failed
+        writebuffer_write(CSFFile_Buffer, &CSFFile_Header, sizeof(CSFHeader));
+
+        // With stats, reading and writing are timed separately for every Label
+        while(!Context->Error)
+        {
+            Start = csf_stats_start(Context);
+
+            if(!(Label = STRReader_Next(Reader)))
+            {
+                break;
+            }
+
+            csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+            Start = csf_stats_start(Context);
+
+            CSFFile_WriteLabel(CSFFile_Buffer, Label);
+
+            CSFFile_Header.NumLabels++;
+            CSFFile_Header.NumStrings++;
+
+            csf_stats_stop(Context, CSF_STAT_TIME_WRITE, Start);
+        }
+
+        Start = csf_stats_start(Context);
+
+        if(!Context->Error && !writebuffer_flush(CSFFile_Buffer) && (fseek(CSFFile_Handle, 0, SEEK_SET) || fwrite(&CSFFile_Header, sizeof(CSFHeader), 1, CSFFile_Handle) != 1))
+        {
+            csf_error(Context, CSF_ERROR_WRITE, "Couldn't write CSF header to ", CSFFile_Path, strlen(CSFFile_Path));
+        }
+
+        csf_stats_add(Context, CSF_STAT_BYTES_WRITTEN, sizeof(CSFHeader));
+        csf_stats_stop(Context, CSF_STAT_TIME_WRITE, Start);
+    }
+    else if(CSFFile_Buffer)
+    {
+        // The output can't seek (i.e. a pipe), so all Labels need to be read before the CSFHeader can be written
+        // LabelNames and values are copied into the arena, a label usually takes more than 32 bytes in a STR file
+        // Values many Labels have are only copied once
+        if((Arena = arena_create(Context, STRREADER_WINDOW_SIZE / 32 * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString))))
+            && (Intern = CSFIntern_Create(Context, Arena, Reader->Mapped ? Reader->Size : 0)))
+        {
+            CSFFile_FullHeader = CSFFileHeader_Create(Reader, LanguageId, Arena, Intern);
+        }
+
+        csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+    }
+
+    Start = csf_stats_start(Context);
+
+    if(CSFFile_FullHeader)
+    {
+        // All Labels are known already, so the real CSFHeader can be written right away
+        CSFIntern_WriteHeader(Intern, CSFFile_Buffer, CSFFile_FullHeader);
+    }
+
+    // Release all Labels and Strings at once
+    CSFIntern_Free(Intern);
+    arena_free(Arena);
+
+    // Flush what's left, close output CSF file
+    if(CSFFile_Buffer)
+    {
+        writebuffer_close(CSFFile_Buffer);
+    }
+
+    if(CSFFile_Handle)
+    {
+        fclose_replace(Context, CSFFile_Handle, CSFFile_Path, TempFile_Path);
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_WRITE, Start);
+
+    // Close STR file, done
+    STRReader_Close(Reader);
+    CSFImporter_Close(Importer);
+
+    csf_stats_stop(Context, CSF_STAT_TIME_TOTAL, TotalStart);
+
+    return Context->Error;
+}
+
+int
+STRFile_ConvertToCSFFileIncremental(CSFContext *Context, char *STRFile_Path, char *CSFFile_Path, char *LanguageString, char *PreviousCSFFile_Path, int NumThreads, int Pipelined)
+{
+    FILE *CSFFile_Handle = NULL;
+    STRReader *Reader = NULL;
+    CSFImporter *Importer = NULL;
+    CSFHeader CSFFile_Header;
+    CSFHeader *CSFFile_FullHeader = NULL;
+    CSFArena *Arena = NULL;
+    CSFIntern *Intern = NULL;
+    CSFCache *Cache = NULL;
+    CSFCacheEntry **Entry = NULL;
+    CSFWriteBuffer *CSFFile_Buffer = NULL;
+    char *TempFile_Path = NULL;
+    uint8_t *CSFFile_Data;
+    size_t CSFFile_Size;
+    uint32_t LanguageId, NumCopied = 0;
+    int Unchanged;
+    uint64_t TotalStart, Start;
+    uint32_t i;
+
+    // Same as STRFile_ConvertToCSFFile, but Labels whose LabelName and value are the same as in PreviousCSFFile_Path are copied from it instead of being encoded
+    // If the result would be the same as what's already in CSFFile_Path, it isn't written at all, so its modification time stays the same
+    LanguageId = CSFFile_GetLanguageId(LanguageString);
+
+    if((int32_t)LanguageId == CSF_LANGUAGE_UNKNOWN)
+    {
+        return csf_error(Context, CSF_ERROR_LANGUAGE, "Unsupported language string, please refer to the readme for the available languages", "", 0);
+    }
+
+    csf_log(Context, CSF_LOG_INFO, "Creating CSF file with language '%s'", LanguageString);
+
+    // All Labels need to be known before anything is written, so the STR file is parsed in full
+    // Pipelined, that's one Label at a time while a thread reads ahead, and the CSF file is written on a thread of its own
+    TotalStart = Start = csf_stats_start(Context);
+
+    if(CSFFile_GetFormat(STRFile_Path) >= CSF_FORMAT_JSON)
+    {
+        if(!(Importer = CSFImporter_Open(Context, STRFile_Path)))
+        {
+            return Context->Error;
+        }
+    }
+    else if(!(Reader = Pipelined ? STRReader_OpenPipelined(Context, STRFile_Path) : STRReader_Open(Context, STRFile_Path, 1)))
+    {
+        return Context->Error;
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_OPEN, Start);
+    Start = csf_stats_start(Context);
+
+    if(Importer)
+    {
+        if((Arena = arena_create(Context, Importer->Size / 32 * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString))))
+            && (Intern = CSFIntern_Create(Context, Arena, Importer->Size)))
+        {
+            CSFFile_FullHeader = CSFFileHeader_Import(Importer, LanguageId, Arena, Intern);
+        }
+    }
+    else if((Arena = arena_create(Context, (Reader->Mapped ? Reader->Size : STRREADER_WINDOW_SIZE) / 32 * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString))))
+        && (Intern = CSFIntern_Create(Context, Arena, Reader->Mapped && NumThreads < 2 ? Reader->Size : 0)))
+    {
+        if(Reader->Mapped && NumThreads > 1)
+        {
+            CSFFile_FullHeader = CSFFileHeader_CreateParallel(Reader, LanguageId, Arena, Intern, NumThreads);
+        }
+        else
+        {
+            CSFFile_FullHeader = CSFFileHeader_Create(Reader, LanguageId, Arena, Intern);
+        }
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+    Start = csf_stats_start(Context);
+
+    if(CSFFile_FullHeader && (Cache = CSFCache_Open(Context, PreviousCSFFile_Path)))
+    {
+        Entry = malloc_c(Context, CSFFile_FullHeader->NumLabels * sizeof(CSFCacheEntry *) + 1);
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_OPEN, Start);
+
+    if(!Entry)
+    {
+        goto done;
+    }
+
+    // Nothing changed if every Label is copied from the same place in a previous CSF file with the same header
+    CSFFileHeader_Init(&CSFFile_Header, LanguageId);
+    CSFFile_Header.NumLabels = CSFFile_Header.NumStrings = CSFFile_FullHeader->NumLabels;
+
+    Unchanged = Cache->Complete && Cache->NumEntries == CSFFile_FullHeader->NumLabels && !memcmp(&Cache->Reader->Header, &CSFFile_Header, sizeof(CSFHeader));
+
+    for(i = 0; i < CSFFile_FullHeader->NumLabels; i++)
+    {
+        if((Entry[i] = CSFCache_Find(Cache, CSFFile_FullHeader->Label[i])))
+        {
+            NumCopied++;
+        }
+
+        Unchanged = Unchanged && Entry[i] == &Cache->Entry[i];
+    }
+
+    csf_log(Context, CSF_LOG_INFO, "%u of %u Labels are unchanged", NumCopied, CSFFile_FullHeader->NumLabels);
+
+    // The previous CSF file doesn't have to be the output file, so compare what's there
+    if(Unchanged && strcmp(CSFFile_Path, "-") && (CSFFile_Data = fmap(CSFFile_Path, &CSFFile_Size)))
+    {
+        Unchanged = CSFFile_Size == Cache->Reader->Size && !memcmp(CSFFile_Data, Cache->Reader->Data, CSFFile_Size);
+        funmap(CSFFile_Data, CSFFile_Size);
+
+        if(Unchanged)
+        {
+            csf_log(Context, CSF_LOG_INFO, "%s is up to date, not writing it", CSFFile_Path);
+            goto done;
+        }
+    }
+
+    // The previous CSF file may be the output file and is still mapped, so write to a temporary file and replace the output with it at the end
+    if(strcmp(CSFFile_Path, "-"))
+    {
+        if(!(TempFile_Path = malloc_c(Context, strlen(CSFFile_Path) + sizeof(".tmp"))))
+        {
+            goto done;
+        }
+
+        sprintf(TempFile_Path, "%s.tmp", CSFFile_Path);
+    }
+
+    Start = csf_stats_start(Context);
+
+    if((CSFFile_Handle = fopen_c(Context, TempFile_Path ? TempFile_Path : CSFFile_Path, "wb")))
+    {
+        CSFFile_Buffer = Pipelined ? writebuffer_create_pipelined(Context, CSFFile_Handle) : writebuffer_create(Context, CSFFile_Handle);
+    }
+
+    if(CSFFile_Buffer)
+    {
+        writebuffer_write(CSFFile_Buffer, &CSFFile_Header, sizeof(CSFHeader));
+
+        for(i = 0; i < CSFFile_FullHeader->NumLabels && !Context->Error; i++)
+        {
+            if(Entry[i])
+            {
+                writebuffer_write(CSFFile_Buffer, Cache->Reader->Data + Entry[i]->Offset, Entry[i]->Size);
+            }
+            else
+            {
+                CSFIntern_WriteLabel(Intern, CSFFile_Buffer, CSFFile_FullHeader->Label[i]);
+            }
+        }
+
+        CSFIntern_Report(Intern);
+
+        writebuffer_close(CSFFile_Buffer);
+    }
+
+    if(CSFFile_Handle && fclose_c(CSFFile_Handle))
+    {
+        csf_error(Context, CSF_ERROR_WRITE, "Couldn't write to ", CSFFile_Path, strlen(CSFFile_Path));
+    }
+
+    // The previous CSF file can't be replaced while it's mapped
+    CSFCache_Close(Cache);
+    Cache = NULL;
+
+    if(CSFFile_Handle && TempFile_Path)
+    {
+        // Windows can't rename over an existing file
+#ifdef _WIN32
+        if(!Context->Error)
+        {
+            remove(CSFFile_Path);
+        }
+#endif
+
+        if(Context->Error || rename(TempFile_Path, CSFFile_Path))
+        {
+            remove(TempFile_Path);
+            csf_error(Context, CSF_ERROR_WRITE, "Couldn't replace ", CSFFile_Path, strlen(CSFFile_Path));
+        }
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_WRITE, Start);
+
+done:
+    // Release everything, done
+    free(TempFile_Path);
+    free(Entry);
+    CSFCache_Close(Cache);
+    CSFIntern_Free(Intern);
+    arena_free(Arena);
+    STRReader_Close(Reader);
+    CSFImporter_Close(Importer);
+
+    csf_stats_stop(Context, CSF_STAT_TIME_TOTAL, TotalStart);
+
+    return Context->Error;
+}
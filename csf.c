@@ -0,0 +1,715 @@
+#include "csftools.h"
+
+static uint32_t
+CSFFile_ReadUInt32(uint8_t *CSFFile_Data)
+{
+    uint32_t Value;
+
+    // memcpy since the fields in a CSF file aren't aligned
+    memcpy(&Value, CSFFile_Data, sizeof(Value));
+
+    return Value;
+}
+
+static uint8_t *
+CSFReader_Read(CSFReader *Reader, size_t Size, int Keep)
+{
+    uint8_t *Data;
+
+    // Returns the next Size bytes of the CSF file, or NULL if the file is too short
+    // For a mapped file that's a pointer into the mapping, otherwise it's read into a reader buffer that stays valid until the next CSFReader_Next
+    // Keep selects one of the buffers, so the LabelName stays valid while its value is read, and both while the ExtraValue is read
+    if(Reader->Mapped)
+    {
+        if(Reader->Size - Reader->Offset < Size)
+        {
+            return NULL;
+        }
+
+        Data = Reader->Data + Reader->Offset;
+    }
+    else
+    {
+        // + 1 for a null-terminator
+        if(Reader->BufferSize[Keep] < Size + 1)
+        {
+            if(!(Data = realloc_c(Reader->Context, Reader->Buffer[Keep], Size + 1)))
+            {
+                return NULL;
+            }
+
+            Reader->BufferSize[Keep] = Size + 1;
+            Reader->Buffer[Keep] = Data;
+        }
+
+        Data = Reader->Buffer[Keep];
+
+        if((Reader->Pipe ? pipereader_read(Reader->Pipe, Data, Size) : fread(Data, 1, Size, Reader->Handle)) != Size)
+        {
+            if(Reader->Pipe ? pipereader_error(Reader->Pipe) : ferror(Reader->Handle))
+            {
+                csf_error(Reader->Context, CSF_ERROR_READ, "Couldn't read from CSF file", "", 0);
+            }
+
+            return NULL;
+        }
+    }
+
+    Reader->Offset += Size;
+
+    return Data;
+}
+
+static CSFLabel *
+CSFReader_Error(CSFReader *Reader, int Error, const char *Message, const char *Detail, size_t DetailLength)
+{
+    // Keep the first error, and make sure nothing else is read after it
+    csf_error(Reader->Context, Error, Message, Detail, DetailLength);
+
+    Reader->Index = Reader->Header.NumLabels;
+
+    return NULL;
+}
+
+static CSFReader *
+CSFReader_OpenFile(CSFContext *Context, char *CSFFile_Path, int InPlace, int Pipelined)
+{
+    CSFReader *Reader;
+    uint8_t *Data;
+
+    if(!(Reader = calloc_c(Context, 1, sizeof(CSFReader))))
+    {
+        return NULL;
+    }
+
+    Reader->Context = Context;
+
+    if(strcmp(CSFFile_Path, "-") && !Pipelined)
+    {
+        Reader->Data = fmap(CSFFile_Path, &Reader->Size);
+    }
+
+    Reader->Mapped = Reader->Data != NULL;
+    Reader->InPlace = InPlace && Reader->Mapped;
+
+    // Not a regular file (i.e. a pipe), so read it the slow way, or ahead of the reader on a thread of its own
+    if(Pipelined)
+    {
+        if(!(Reader->Pipe = pipereader_open(Context, CSFFile_Path)))
+        {
+            free(Reader);
+            return NULL;
+        }
+    }
+    else if(!Reader->Mapped && !(Reader->Handle = fopen_c(Context, CSFFile_Path, "rb")))
+    {
+        free(Reader);
+        return NULL;
+    }
+
+    // Read header from CSF file
+    if(!(Data = CSFReader_Read(Reader, sizeof(CSFHeader), 0)))
+    {
+        csf_error(Context, CSF_ERROR_FORMAT, "Couldn't read CSF header, file is too short", "", 0);
+    }
+    else
+    {
+        memcpy(&Reader->Header, Data, sizeof(CSFHeader));
+
+        // Some sanity checks for header values
+        // Every Label is at least 12 bytes, so a NumLabels that can't possibly fit into the file is garbage
+        if(Reader->Header.MagicHeader != CSF_MAGIC)
+        {
+            csf_error(Context, CSF_ERROR_FORMAT, "Wrong header in CSF file, expected CSF", "", 0);
+        }
+        else if(Reader->Header.CSFVersion != CSF_VERSION_2 && Reader->Header.CSFVersion != CSF_VERSION_3)
+        {
+            csf_error(Context, CSF_ERROR_FORMAT, "CSF version is not 2 or 3", "", 0);
+        }
+        else if(Reader->Mapped && Reader->Header.NumLabels > (Reader->Size - sizeof(CSFHeader)) / 12)
+        {
+            csf_error(Context, CSF_ERROR_FORMAT, "Labelcount in CSF header is larger than the file", "", 0);
+        }
+    }
+
+    if(Context->Error)
+    {
+        CSFReader_Close(Reader);
+        return NULL;
+    }
+
+    if(Reader->Header.NumLabels != Reader->Header.NumStrings)
+    {
+        csf_log(Context, CSF_LOG_WARNING, "Mismatch between Labelcount and Stringcount, %u vs. %u", Reader->Header.NumLabels, Reader->Header.NumStrings);
+    }
+
+    return Reader;
+}
+
+CSFReader *
+CSFReader_Open(CSFContext *Context, char *CSFFile_Path, int InPlace)
+{
+    // Reads a CSF file one Label at a time
+    // Regular files are mapped, pipes (and - for stdin) are read through stdio
+    // With InPlace, values of a mapped file are decoded in place so they stay valid until CSFReader_Close, which CSFFileHeader_Parse needs
+    // Only values that are longer in UTF-8 than in UTF-16 (i.e. Japanese ones) end up in the reader buffer anyway, CSFFileHeader_Parse copies those
+    // Otherwise they're decoded into a reader buffer and the mapping is released as it's read, so memory use stays flat
+    // Returns NULL if the file can't be opened or its header is broken
+    return CSFReader_OpenFile(Context, CSFFile_Path, InPlace, 0);
+}
+
+CSFReader *
+CSFReader_OpenPipelined(CSFContext *Context, char *CSFFile_Path)
+{
+    // Same as CSFReader_Open, but the file is never mapped, a thread reads it a few blocks ahead instead
+    // Reading a mapped file stops at every page that isn't there yet, which takes long on a network drive, this way the disk is waited for while Labels are decoded
+    return CSFReader_OpenFile(Context, CSFFile_Path, 0, 1);
+}
+
+CSFLabel *
+CSFReader_Next(CSFReader *Reader)
+{
+    CSFLabel *Label = &Reader->Label;
+    CSFString *String = &Reader->String;
+    char offsetbuffer[17];
+    uint8_t *Data;
+    uint64_t DecodeStart;
+    size_t Length, Decoded;
+
+    // Returns the next Label, or NULL after the last one or on an error, which is kept in the reader's context
+    // The Label and its String are overwritten by the next call, copy them if they need to be kept
+    if(Reader->Index == Reader->Header.NumLabels)
+    {
+        return NULL;
+    }
+
+    Reader->Index++;
+
+    // Give back the pages that have already been read, they won't be needed again
+    if(Reader->Mapped && !Reader->InPlace && Reader->Offset - Reader->Discarded >= CSFREADER_DISCARD_SIZE)
+    {
+        fmap_discard(Reader->Data + Reader->Discarded, Reader->Offset - Reader->Discarded);
+        Reader->Discarded = Reader->Offset;
+    }
+
+    // Remember where this Label starts, i.e. for an index file
+    Reader->LabelOffset = Reader->Offset;
+
+    // Read Label struct members one by one from file due to alignment issues when compiling for x86_64
+    if(!(Data = CSFReader_Read(Reader, 12, 0)))
+    {
+        return CSFReader_Error(Reader, CSF_ERROR_FORMAT, "Unexpected end of CSF file while reading Labels", "", 0);
+    }
+
+    Label->MagicHeader = CSFFile_ReadUInt32(Data);
+    Label->NumStringPairs = CSFFile_ReadUInt32(Data + 4);
+    Label->LabelNameLength = CSFFile_ReadUInt32(Data + 8);
+
+    // Sanity check for LBL magic value
+    if(Label->MagicHeader != LBL_MAGIC)
+    {
+        sprintf(offsetbuffer, "%lX", (unsigned long)(Reader->Offset - 12));
+        return CSFReader_Error(Reader, CSF_ERROR_FORMAT, "Wrong header in Label, expected LBL at 0x", offsetbuffer, strlen(offsetbuffer));
+    }
+
+    // LabelName is not null-terminated in the file
+    if(!(Data = CSFReader_Read(Reader, Label->LabelNameLength, 0)))
+    {
+        return CSFReader_Error(Reader, CSF_ERROR_FORMAT, "Unexpected end of CSF file while reading Labels", "", 0);
+    }
+
+    Label->LabelName = (char *)Data;
+    Label->String = String;
+
+    // Sometimes a Label can contain no string pair at all (see generals.csf from Zero Hour, for example)
+    // So we fill it with some dummy data and just pretend it's an empty string, which is not unusual for STR files
+    if(!Label->NumStringPairs)
+    {
+        csf_log(Reader->Context, CSF_LOG_WARNING, "No String associated with Label %.*s", (int)Label->LabelNameLength, Label->LabelName);
+
+        String->MagicHeader = STR_MAGIC;
+        String->ValueLength = 0;
+        String->Value = "";
+        String->ExtraValueLength = 0;
+        String->ExtraValue = NULL;
+
+        return Label;
+    }
+
+    // Read String header from file
+    if(!(Data = CSFReader_Read(Reader, 8, 1)))
+    {
+        return CSFReader_Error(Reader, CSF_ERROR_FORMAT, "Unexpected end of CSF file in Label ", Label->LabelName, Label->LabelNameLength);
+    }
+
+    String->MagicHeader = CSFFile_ReadUInt32(Data);
+    String->ValueLength = CSFFile_ReadUInt32(Data + 4);
+    String->ExtraValueLength = 0;
+    String->ExtraValue = NULL;
+
+    // Sanity check for STR or STRW magic value
+    if(String->MagicHeader != STR_MAGIC && String->MagicHeader != STRW_MAGIC)
+    {
+        return CSFReader_Error(Reader, CSF_ERROR_FORMAT, "Wrong header in String, expected STR or STRW in Label ", Label->LabelName, Label->LabelNameLength);
+    }
+
+    // Read Encoded (notted) non-null-terminated value from file
+    // Since the value is UTF-16 the Value length needs to be multiplied by 2, decoded to UTF-8 it can be up to 3 times as long
+    if(String->ValueLength > UINT32_MAX / 3 || !(Data = CSFReader_Read(Reader, String->ValueLength * (size_t)2, 1)))
+    {
+        return CSFReader_Error(Reader, CSF_ERROR_FORMAT, "Unexpected end of CSF file in Label ", Label->LabelName, Label->LabelNameLength);
+    }
+
+    if(!String->ValueLength)
+    {
+        String->Value = "";
+    }
+    else if(Reader->Prescan)
+    {
+        // Leave the value encoded, CSFFileHeader_ParseParallel decodes it later
+        String->Value = (char *)Data;
+    }
+    else
+    {
+        // Decode (not) the value from UTF-16 to UTF-8 and null-terminate it
+        // In place it fits as long as no char needs more bytes than its 2 byte units, which covers everything but Japanese, Korean and Chinese
+        // Whatever doesn't fit is decoded into the value buffer after the part that did, same as for a mapped file that isn't InPlace
+        DecodeStart = csf_stats_start(Reader->Context);
+
+        Length = 0;
+        Decoded = 0;
+
+        if(!Reader->Mapped || Reader->InPlace)
+        {
+            Length = CSFString_Decode((char *)Data, Data, String->ValueLength, &Decoded);
+        }
+
+        if(Decoded == String->ValueLength && Length < String->ValueLength * (size_t)2)
+        {
+            String->Value = (char *)Data;
+        }
+        else
+        {
+            if(Reader->ValueBufferSize < Length + (String->ValueLength - Decoded) * 3 + 1)
+            {
+                if(!(String->Value = realloc_c(Reader->Context, Reader->ValueBuffer, Length + (String->ValueLength - Decoded) * 3 + 1)))
+                {
+                    return CSFReader_Error(Reader, CSF_ERROR_MEMORY, "Couldn't allocate memory", "", 0);
+                }
+
+                Reader->ValueBufferSize = Length + (String->ValueLength - Decoded) * 3 + 1;
+                Reader->ValueBuffer = String->Value;
+            }
+
+            String->Value = Reader->ValueBuffer;
+
+            memcpy(String->Value, Data, Length);
+            Length += CSFString_Decode(String->Value + Length, Data + Decoded * 2, String->ValueLength - Decoded, &Decoded);
+        }
+
+        csf_stats_stop(Reader->Context, CSF_STAT_TIME_DECODE, DecodeStart);
+
+        String->ValueLength = (uint32_t)Length;
+        String->Value[String->ValueLength] = '\0';
+    }
+
+    // Sometimes a String can have some extra data following it (i.e. generals.csf from Zero Hour), denoted by a STRW header instead of STR
+    // It's kept as it is, for a mapped file ExtraValue points into the mapping, otherwise into its own reader buffer
+    if(String->MagicHeader == STRW_MAGIC)
+    {
+        // Read ExtraValueLength (immediately follows after StringValue) and the bytes it contains
+        if(!(Data = CSFReader_Read(Reader, 4, 2)))
+        {
+            return CSFReader_Error(Reader, CSF_ERROR_FORMAT, "Unexpected end of CSF file in Label ", Label->LabelName, Label->LabelNameLength);
+        }
+
+        String->ExtraValueLength = CSFFile_ReadUInt32(Data);
+
+        if(!(String->ExtraValue = CSFReader_Read(Reader, String->ExtraValueLength, 2)))
+        {
+            return CSFReader_Error(Reader, CSF_ERROR_FORMAT, "Unexpected end of CSF file in Label ", Label->LabelName, Label->LabelNameLength);
+        }
+    }
+
+    return Label;
+}
+
+void
+CSFReader_Close(CSFReader *Reader)
+{
+    if(Reader == NULL)
+    {
+        return;
+    }
+
+    // Offset counts every byte that was read, mapped or not
+    csf_stats_add(Reader->Context, CSF_STAT_BYTES_READ, Reader->Offset);
+
+    if(Reader->Mapped)
+    {
+        funmap(Reader->Data, Reader->Size);
+    }
+    else if(Reader->Pipe)
+    {
+        pipereader_close(Reader->Pipe);
+    }
+    else
+    {
+        fclose_c(Reader->Handle);
+    }
+
+    free(Reader->Buffer[0]);
+    free(Reader->Buffer[1]);
+    free(Reader->Buffer[2]);
+    free(Reader->ValueBuffer);
+    free(Reader);
+}
+
+CSFHeader *
+CSFFileHeader_Parse(CSFReader *Reader, CSFArena *Arena)
+{
+    CSFHeader *CSFFile_Header = NULL;
+    CSFLabel *Label = NULL;
+    CSFString *String = NULL;
+    CSFLabel *ReaderLabel = NULL;
+    int i;
+
+    // Read all Labels of a CSF file into memory, everything is allocated from Arena
+    // Labels of a mapped file opened with InPlace point into the mapping, so the reader has to stay open as long as they're used
+    // Returns NULL on an error, whatever was allocated until then is released with the arena
+    if(!(CSFFile_Header = arena_alloc(Arena, sizeof(CSFHeader) + (Reader->Header.NumLabels * sizeof(CSFLabel *)))))
+    {
+        return NULL;
+    }
+
+    memcpy(CSFFile_Header, &Reader->Header, sizeof(CSFHeader));
+
+    // Iterate through all labels
+    for(i = 0; (ReaderLabel = CSFReader_Next(Reader)); i++)
+    {
+        if(!(Label = arena_alloc(Arena, sizeof(CSFLabel))) || !(String = arena_alloc(Arena, sizeof(CSFString))))
+        {
+            return NULL;
+        }
+
+        *Label = *ReaderLabel;
+        *String = *ReaderLabel->String;
+
+        // Everything that's in a reader buffer needs to be copied, InPlace that's only values that didn't fit into the mapping
+        if(!Reader->InPlace)
+        {
+            if(!(Label->LabelName = arena_alloc(Arena, Label->LabelNameLength + 1)))
+            {
+                return NULL;
+            }
+
+            memcpy(Label->LabelName, ReaderLabel->LabelName, Label->LabelNameLength);
+            Label->LabelName[Label->LabelNameLength] = '\0';
+        }
+
+        if(!Reader->InPlace || (String->Value == Reader->ValueBuffer && String->ValueLength))
+        {
+            if(!(String->Value = arena_alloc(Arena, String->ValueLength + 1)))
+            {
+                return NULL;
+            }
+
+            memcpy(String->Value, ReaderLabel->String->Value, String->ValueLength + 1);
+        }
+
+        // An ExtraValue is only in a reader buffer if the file isn't mapped
+        if(!Reader->Mapped && String->ExtraValue)
+        {
+            if(!(String->ExtraValue = arena_alloc(Arena, String->ExtraValueLength + 1)))
+            {
+                return NULL;
+            }
+
+            memcpy(String->ExtraValue, ReaderLabel->String->ExtraValue, String->ExtraValueLength);
+        }
+
+        // Add String to Label, add Label to CSFHeader
+        Label->String = String;
+        CSFFile_Header->Label[i] = Label;
+    }
+
+    if(Reader->Context->Error)
+    {
+        return NULL;
+    }
+
+    return CSFFile_Header;
+}
+
+int
+CSFString_DecodePrescanned(CSFString *String, CSFArena *Arena)
+{
+    char *Value;
+    size_t Length, Decoded;
+
+    // Decodes a value that CSFReader_Next left encoded because of Prescan, exactly like it would have, in place
+    // Values that don't fit in place go to Arena, returns its context's error if there's no memory for that
+    if(!String->ValueLength)
+    {
+        return CSF_OK;
+    }
+
+    Length = CSFString_Decode(String->Value, (uint8_t *)String->Value, String->ValueLength, &Decoded);
+
+    if(Decoded < String->ValueLength || Length == String->ValueLength * (size_t)2)
+    {
+        if(!(Value = arena_alloc(Arena, Length + (String->ValueLength - Decoded) * 3 + 1)))
+        {
+            return Arena->Context->Error;
+        }
+
+        memcpy(Value, String->Value, Length);
+        Length += CSFString_Decode(Value + Length, (uint8_t *)String->Value + Decoded * 2, String->ValueLength - Decoded, &Decoded);
+        String->Value = Value;
+    }
+
+    String->ValueLength = (uint32_t)Length;
+    String->Value[String->ValueLength] = '\0';
+
+    return CSF_OK;
+}
+
+static void *
+CSFFileHeader_DecodeThread(void *Args)
+{
+    CSFDecodeJob *Job = Args;
+    uint32_t i;
+
+    // Decode the values of a range of Labels in place, values that don't fit go to the job's own arena, which is handed over to the caller's afterwards
+    for(i = Job->LabelStart; i < Job->LabelEnd && !CSFString_DecodePrescanned(Job->CSFFile_Header->Label[i]->String, Job->Arena); i++);
+
+    return NULL;
+}
+
+CSFHeader *
+CSFFileHeader_ParseParallel(CSFReader *Reader, CSFArena *Arena, int NumThreads)
+{
+    CSFHeader *CSFFile_Header = NULL;
+    CSFDecodeJob *Jobs = NULL;
+    uint64_t ValueLengthTotal = 0;
+    uint64_t ValueLengthSum = 0;
+    uint64_t DecodeStart;
+    uint32_t i;
+    int j;
+
+    // Same as CSFFileHeader_Parse, but the values are decoded on NumThreads threads
+    // A first pass only walks the Labels, since each of them carries its own lengths, and leaves the values encoded
+    // Then every thread decodes the values of its own range of Labels in place, ranges are split by the total value length so every thread gets about the same work
+    // Only works for mapped files opened with InPlace, everything else is parsed like CSFFileHeader_Parse does
+    if(!Reader->InPlace || NumThreads < 2)
+    {
+        return CSFFileHeader_Parse(Reader, Arena);
+    }
+
+    Reader->Prescan = 1;
+    CSFFile_Header = CSFFileHeader_Parse(Reader, Arena);
+    Reader->Prescan = 0;
+
+    if(!CSFFile_Header)
+    {
+        return NULL;
+    }
+
+    if(!(Jobs = calloc_c(Reader->Context, NumThreads, sizeof(CSFDecodeJob))))
+    {
+        return NULL;
+    }
+
+    for(i = 0; i < CSFFile_Header->NumLabels; i++)
+    {
+        ValueLengthTotal += CSFFile_Header->Label[i]->String->ValueLength;
+    }
+
+    for(i = 0, j = 0; j < NumThreads; j++)
+    {
+        // Every job gets a context of its own, so errors of one thread don't mix with another's
+        Jobs[j].Context.Log = Reader->Context->Log;
+        Jobs[j].Context.UserData = Reader->Context->UserData;
+        Jobs[j].Context.Stats = Reader->Context->Stats;
+        Jobs[j].Arena = arena_create(&Jobs[j].Context, 0);
+        Jobs[j].CSFFile_Header = CSFFile_Header;
+        Jobs[j].LabelStart = i;
+
+        // The last thread takes whatever is left
+        while(i < CSFFile_Header->NumLabels && (j == NumThreads - 1 || ValueLengthSum < ValueLengthTotal * (j + 1) / NumThreads))
+        {
+            ValueLengthSum += CSFFile_Header->Label[i]->String->ValueLength;
+            i++;
+        }
+
+        Jobs[j].LabelEnd = Jobs[j].Arena ? i : Jobs[j].LabelStart;
+    }
+
+    // Decoding on several threads counts as the time until all of them are done
+    DecodeStart = csf_stats_start(Reader->Context);
+    threads_run(NumThreads, CSFFileHeader_DecodeThread, Jobs, sizeof(CSFDecodeJob));
+    csf_stats_stop(Reader->Context, CSF_STAT_TIME_DECODE, DecodeStart);
+
+    // Hand the first error over to the caller's context, and the values that didn't fit in place over to the caller's arena
+    for(j = 0; j < NumThreads; j++)
+    {
+        if(Jobs[j].Context.Error && !Reader->Context->Error)
+        {
+            *Reader->Context = Jobs[j].Context;
+        }
+
+        if(Jobs[j].Arena)
+        {
+            arena_merge(Arena, Jobs[j].Arena);
+        }
+    }
+
+    free(Jobs);
+
+    return Reader->Context->Error ? NULL : CSFFile_Header;
+}
+
+void
+CSFFileHeader_Init(CSFHeader *CSFFile_Header, uint32_t LanguageId)
+{
+    // Set some default values, NumLabels and NumStrings will be updated while reading STR file
+    CSFFile_Header->MagicHeader = CSF_MAGIC;
+    CSFFile_Header->CSFVersion = CSF_VERSION_3;
+    CSFFile_Header->NumLabels = 0;
+    CSFFile_Header->NumStrings = 0;
+    CSFFile_Header->Unknown = 0;
+    CSFFile_Header->Language = LanguageId;
+}
+
+void
+CSFFile_WriteLabel(CSFWriteBuffer *CSFFile_Buffer, CSFLabel *Label)
+{
+    CSFFile_WriteEncodedLabel(CSFFile_Buffer, Label, NULL, 0);
+}
+
+void
+CSFFile_WriteEncodedLabel(CSFWriteBuffer *CSFFile_Buffer, CSFLabel *Label, const uint8_t *EncodedValue, uint32_t ValueLength)
+{
+    uint8_t *Reserved;
+    uint64_t EncodeStart;
+
+    // Same as CSFFile_WriteLabel, but the value was encoded already, i.e. by CSFIntern_WriteLabel for a value that many Labels share
+    // ValueLength is its number of UTF-16 units, with EncodedValue NULL the value of the Label is encoded here
+
+    // Write Label struct members one by one to file due to alignment issues when compiling for x86_64
+    writebuffer_write(CSFFile_Buffer, &Label->MagicHeader, sizeof(Label->MagicHeader));
+    writebuffer_write(CSFFile_Buffer, &Label->NumStringPairs, sizeof(Label->NumStringPairs));
+    writebuffer_write(CSFFile_Buffer, &Label->LabelNameLength, sizeof(Label->LabelNameLength));
+
+    // Write non-null-terminated LabelName to file
+    writebuffer_write(CSFFile_Buffer, Label->LabelName, Label->LabelNameLength);
+
+    // A Label without a String pair ends here, the empty value it was read with isn't part of the file
+    if(!Label->NumStringPairs)
+    {
+        return;
+    }
+
+    // Write String header to file
+    writebuffer_write(CSFFile_Buffer, &Label->String->MagicHeader, sizeof(Label->String->MagicHeader));
+
+    if(EncodedValue)
+    {
+        writebuffer_write(CSFFile_Buffer, &ValueLength, sizeof(ValueLength));
+        writebuffer_write(CSFFile_Buffer, EncodedValue, ValueLength * (size_t)2);
+    }
+    // Write non-null-terminated String value to file, in the file it is a notted UTF-16 string
+    // So encode the whole value straight into the write buffer after its length, which is only known afterwards, and give back what it didn't need
+    else if((Reserved = writebuffer_reserve(CSFFile_Buffer, sizeof(ValueLength) + Label->String->ValueLength * (size_t)2)))
+    {
+        EncodeStart = csf_stats_start(CSFFile_Buffer->Context);
+        ValueLength = (uint32_t)CSFString_Encode(Reserved + sizeof(ValueLength), Label->String->Value, Label->String->ValueLength);
+        csf_stats_stop(CSFFile_Buffer->Context, CSF_STAT_TIME_ENCODE, EncodeStart);
+
+        memcpy(Reserved, &ValueLength, sizeof(ValueLength));
+        writebuffer_unreserve(CSFFile_Buffer, (Label->String->ValueLength - (size_t)ValueLength) * 2);
+    }
+
+    // The ExtraValue of a STRW String follows as it is, straight from wherever it was read
+    if(Label->String->MagicHeader == STRW_MAGIC)
+    {
+        writebuffer_write(CSFFile_Buffer, &Label->String->ExtraValueLength, sizeof(Label->String->ExtraValueLength));
+        writebuffer_write(CSFFile_Buffer, Label->String->ExtraValue, Label->String->ExtraValueLength);
+    }
+}
+
+char *
+CSFFile_GetLanguageString(uint32_t LanguageId)
+{
+    char *CSFLanguages[] =
+    {
+        CSF_LANGUAGE_STRING_ENUS,
+        CSF_LANGUAGE_STRING_ENUK,
+        CSF_LANGUAGE_STRING_DE,
+        CSF_LANGUAGE_STRING_FRFR,
+        CSF_LANGUAGE_STRING_ES,
+        CSF_LANGUAGE_STRING_IT,
+        CSF_LANGUAGE_STRING_JA,
+        CSF_LANGUAGE_STRING_JW,
+        CSF_LANGUAGE_STRING_KO,
+        CSF_LANGUAGE_STRING_CN
+    };
+
+    if(LanguageId < CSF_LANGUAGE_NUM)
+    {
+        return CSFLanguages[LanguageId];
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+uint32_t
+CSFFile_GetLanguageId(char *LanguageString)
+{
+    if(!strcmp(CSF_LANGUAGE_STRING_ENUS, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_ENUS;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_ENUK, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_ENUK;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_DE, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_DE;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_FRFR, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_FRFR;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_ES, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_ES;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_IT, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_IT;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_JA, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_JA;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_JW, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_JW;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_KO, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_KO;
+    }
+    else if(!strcmp(CSF_LANGUAGE_STRING_CN, LanguageString))
+    {
+        return CSF_LANGUAGE_ID_CN;
+    }
+    else
+    {
+        return CSF_LANGUAGE_UNKNOWN;
+    }
+}
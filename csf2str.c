@@ -1,244 +1,269 @@
 #include "csftools.h"
 
-int
-main(int argc, char *argv[])
-{
-    // Not enough args
-    if(argc < 3)
-    {
-        printf_help_exit();
-    }
-
-    printf("\n");
-
-    // Exits on failure
-    CSFFile_ConvertToSTRFile(argv[1], argv[2]);
+#define TOOLNAME "csf2str"
 
-    printf("\nSuccessfully converted %s to %s\n", argv[1], argv[2]);
+static void
+printf_help_exit()
+{
+    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    printf("%s supports the following arguments:\n\n", TOOLNAME);
+    printf("%s [-j threads] [-i] <csf input> <str output> [more outputs] to convert a csf file to a str file\n", TOOLNAME);
+    printf("%s [-j threads] [-i] -b <list> to convert every pair of csf input and str output in list\n", TOOLNAME);
+    printf("%s [-j threads] [-i] -d <directory> [-g pattern] to convert every csf file in directory\n", TOOLNAME);
+    printf("outputs ending in .json, .csv or .po are written in that format instead, every label is decoded once for all outputs\n");
+    printf("-j decodes the csf file on the given number of threads, or converts that many files at once\n");
+    printf("-i also writes a .csfidx index file next to the csf file\n");
+    printf("--parallel-writers writes every output on a thread of its own, the csf file is decoded as a whole first\n");
+    printf("--pipeline reads, decodes and writes on separate threads instead of mapping the input, for network drives\n");
+    printf("--stats prints how long each part took, how much was read and written and how much memory was allocated\n");
+    printf("--stats-json <file> writes the same as json, - for stdout\n");
+    printf("-g only converts the files matching pattern, *.csf by default\n");
+    printf("use - as input or output to read from stdin or write to stdout\n\n");
+    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
+    exit(1);
 }
 
-void
-CSFFile_ConvertToSTRFile(char *CSFFile_Path, char *STRFile_Path)
+static void
+printf_log(CSFContext *Context, int Level, const char *Message)
 {
-    FILE *CSFFile_Handle, *STRFile_Handle;
-    CSFHeader *CSFFile_Header = NULL;
-    CSFLabel *Label = NULL;
-    char *LanguageString = NULL;
-    char *StringValue = NULL;
-    int i;
-
-    // Open CSF file
-    CSFFile_Handle = fopen_d(CSFFile_Path, "rb");
+    fprintf(Context->UserData, "%s%s\n", Level == CSF_LOG_WARNING ? "Warning: " : "", Message);
+}
 
-    // Create CSFFile header from CSF file
-    CSFFile_Header = CSFFileHeader_Parse(CSFFile_Handle);
+static void
+printf_log_batch(CSFContext *Context, int Level, const char *Message)
+{
+    CSFBatchJob *Job = Context->UserData;
 
-    // Close CSF file
-    fclose(CSFFile_Handle);
+    // Jobs run at the same time, so only warnings are printed, with the file they're about
+    if(Level == CSF_LOG_WARNING)
+    {
+        fprintf(Job->Batch->UserData, "Warning: %s: %s\n", Job->InputPath, Message);
+    }
+}
 
-    // Get LanguageString from CSF header
-    LanguageString = CSFFile_GetLanguageString(CSFFile_Header->Language);
+static void
+printf_error(FILE *Stream, const char *Path, CSFContext *Context)
+{
+    fprintf(Stream, "Error: ");
 
-    if(!LanguageString)
+    if(Path)
     {
-        printf("Warning: The language of this CSF file was not recognized\n");
+        fprintf(Stream, "%s: ", Path);
     }
-    else
+
+    fprintf(Stream, "%s%s", Context->ErrorMessage, Context->ErrorDetail);
+
+    if(Context->ErrorLine)
     {
-        printf("The language of this CSF file is '%s'\n", LanguageString);
+        fprintf(Stream, " in line %u", Context->ErrorLine);
     }
 
-    // Open output STR file
-    STRFile_Handle = fopen_d(STRFile_Path, "wb");
+    fprintf(Stream, "\n");
+}
+
+static int
+convert_batch(char *ListFile_Path, char *Directory, char *Pattern, int NumThreads, int WriteIndex, int Pipelined, CSFStats *Stats, FILE *Stream)
+{
+    CSFContext Context;
+    CSFBatch *Batch;
+    uint32_t NumFailed, i;
+
+    CSFContext_Init(&Context);
+    Context.Stats = Stats;
 
-    // A label in a STR file is a triplet of lines:
-    // The first one naming the Label
-    // The second one starting and ending with apostrophes containing the String value
-    // The third one containing the marker END
+    fprintf(Stream, "\n");
 
-    // Iterate through CSFFile header and write each Label to STR file
-    for(i = 0; i < CSFFile_Header->NumLabels; i++)
+    if(!(Batch = CSFBatch_Create(&Context, 0))
+        || (ListFile_Path && CSFBatch_AddList(Batch, ListFile_Path))
+        || (Directory && CSFBatch_AddDirectory(Batch, Directory, Pattern ? Pattern : "*.csf", NULL)))
     {
-        Label = CSFFile_Header->Label[i];
+        printf_error(Stream, NULL, &Context);
+        CSFBatch_Free(Batch);
 
-        // Write LabelName to file
-        fprintf(STRFile_Handle, "%s\r\n", Label->LabelName);
+        return 1;
+    }
 
-        // StringValues in STR files are contained by apostrophes
-        // STR files do not contain newline chars in String values, a newline is denoted by the string "\n", so we:
-        // Iterate through string char by char, write a "\n" string instead of newline char, but write all other chars normally
-        StringValue = Label->String->Value;
+    Batch->WriteIndex = WriteIndex;
+    Batch->Pipelined = Pipelined;
+    Batch->Log = printf_log_batch;
+    Batch->UserData = Stream;
 
-        fprintf(STRFile_Handle, "\"");
+    NumFailed = CSFBatch_Run(Batch, NumThreads);
 
-        while(*StringValue)
+    // Results are printed in the order of the list, no matter which file was done first
+    for(i = 0; i < Batch->NumJobs; i++)
+    {
+        if(Batch->Job[i].Context.Error)
         {
-            if(*StringValue == '\n')
-            {
-                fprintf(STRFile_Handle, "\\n");
-            }
-            else
-            {
-                fprintf(STRFile_Handle, "%c", *StringValue);
-            }
-
-            StringValue++;
+            printf_error(Stream, Batch->Job[i].InputPath, &Batch->Job[i].Context);
         }
+        else
+        {
+            fprintf(Stream, "Converted %s to %s\n", Batch->Job[i].InputPath, Batch->Job[i].OutputPath);
+        }
+    }
 
-        fprintf(STRFile_Handle, "\"\r\n");
-
-        // Write END to file to denote the end of this label with an empty line afterwards
-        fprintf(STRFile_Handle, "END\r\n\r\n");
+    if(NumFailed)
+    {
+        fprintf(Stream, "\n%u of %u files failed to convert\n", NumFailed, Batch->NumJobs);
+    }
+    else
+    {
+        fprintf(Stream, "\nSuccessfully converted %u files\n", Batch->NumJobs);
     }
 
-    // Close output STR file, done
-    fclose(STRFile_Handle);
+    CSFBatch_Free(Batch);
+
+    return NumFailed != 0;
 }
 
-CSFHeader *
-CSFFileHeader_Parse(FILE *CSFFile_Handle)
+int
+main(int argc, char *argv[])
 {
-    CSFHeader *CSFFile_Header = NULL;
-    CSFLabel *Label = NULL;
-    CSFString *String = NULL;
-    char itoabuffer[9];
-    char EncodedChar;
-    uint32_t ExtraValueLength;
-    int i, j, k;
-
-    // Initial header malloc
-    CSFFile_Header = malloc_d(sizeof(CSFHeader));
-
-    // Read header from CSF file
-    fread(CSFFile_Header, sizeof(CSFHeader), 1, CSFFile_Handle);
-
-    // Some sanity checks for header values
-    if(CSFFile_Header->MagicHeader != CSF_MAGIC)
+    CSFContext Context;
+    char *ListFile_Path = NULL;
+    char *Directory = NULL;
+    char *Pattern = NULL;
+    int NumThreads = 1;
+    int WriteIndex = 0;
+    int Pipelined = 0;
+    int ParallelWriters = 0;
+    int Error;
+    CSFStats StatsBuffer;
+    CSFStats *Stats = NULL;
+    char *StatsFile_Path = NULL;
+    int PrintStats = 0;
+    FILE *Stream;
+    int i, k;
+
+    // Options come first, a lone - is a file name
+    for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
     {
-        printf_error_exit("Wrong header in CSF file, expected CSF", "");
-    }
+        if(!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            NumThreads = atoi(argv[++i]);
 
-    if(CSFFile_Header->CSFVersion != CSF_VERSION_2 && CSFFile_Header->CSFVersion != CSF_VERSION_3)
-    {
-        printf_error_exit("CSF version is not 2 or 3, exiting", "");
+            if(NumThreads < 1)
+            {
+                printf_help_exit();
+            }
+        }
+        else if(!strcmp(argv[i], "-i"))
+        {
+            WriteIndex = 1;
+        }
+        else if(!strcmp(argv[i], "--pipeline"))
+        {
+            Pipelined = 1;
+        }
+        else if(!strcmp(argv[i], "--parallel-writers"))
+        {
+            ParallelWriters = 1;
+        }
+        else if(!strcmp(argv[i], "-b") && i + 1 < argc)
+        {
+            ListFile_Path = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-d") && i + 1 < argc)
+        {
+            Directory = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-g") && i + 1 < argc)
+        {
+            Pattern = argv[++i];
+        }
+        else if(!strcmp(argv[i], "--stats"))
+        {
+            PrintStats = 1;
+        }
+        else if(!strcmp(argv[i], "--stats-json") && i + 1 < argc)
+        {
+            StatsFile_Path = argv[++i];
+        }
+        else
+        {
+            printf_help_exit();
+        }
     }
 
-    if(CSFFile_Header->NumLabels != CSFFile_Header->NumStrings)
+    if(PrintStats || StatsFile_Path)
     {
-        printf("Warning: Mismatch between Labelcount and Stringcount, %u vs. %u\n", CSFFile_Header->NumLabels, CSFFile_Header->NumStrings);
+        memset(&StatsBuffer, 0, sizeof(CSFStats));
+        Stats = &StatsBuffer;
     }
 
-    // Now realloc memory for all Labels
-    CSFFile_Header = realloc_d(CSFFile_Header, sizeof(CSFHeader) + (CSFFile_Header->NumLabels * sizeof(CSFLabel *)));
+    // Messages go to stdout, unless the stats json or one of the outputs goes there
+    Stream = StatsFile_Path && !strcmp(StatsFile_Path, "-") ? stderr : stdout;
 
-    // Iterate through all labels
-    for(i = 0; i < CSFFile_Header->NumLabels; i++)
+    // Batches take all of their files from the list or the directory
+    if(ListFile_Path || Directory)
     {
-        // Label malloc
-        Label = malloc_d(sizeof(CSFLabel));
-
-        // Read Label struct members one by one from file due to alignment issues when compiling for x86_64
-        fread(&Label->MagicHeader, sizeof(Label->MagicHeader), 1, CSFFile_Handle);
-        fread(&Label->NumStringPairs, sizeof(Label->NumStringPairs), 1, CSFFile_Handle);
-        fread(&Label->LabelNameLength, sizeof(Label->LabelNameLength), 1, CSFFile_Handle);
-
-        // Sanity check for LBL magic value
-        if(Label->MagicHeader != LBL_MAGIC)
+        if(argc - i != 0)
         {
-            printf_error_exit("Wrong header in Label, expected LBL at 0x", itoa(ftell(CSFFile_Handle), itoabuffer, 16));
+            printf_help_exit();
         }
 
-        // Calloc memory for non-null-terminated LabelName, + 1 length makes sure it *is* null-terminated
-        // Read from file
-        Label->LabelName = calloc_d(1, Label->LabelNameLength + 1);
-        fread(Label->LabelName, Label->LabelNameLength, 1, CSFFile_Handle);
-
-        // String malloc
-        String = malloc_d(sizeof(CSFString));
-
-        // Sometimes a Label can contain no string pair at all (see generals.csf from Zero Hour, for example)
-        // So we fill it with some dummy data and just pretend it's an empty string, which is not unusual for STR files
-        if(!Label->NumStringPairs)
+        Error = convert_batch(ListFile_Path, Directory, Pattern, NumThreads, WriteIndex, Pipelined, Stats, Stream);
+    }
+    else
+    {
+        // Not enough args
+        if(argc - i < 2 || Pattern)
         {
-            printf("Warning: No String associated with Label %s\n", Label->LabelName);
-
-            String->MagicHeader = STR_MAGIC;
-            String->ValueLength = 0;
-            String->Value = calloc_d(1, String->ValueLength + 1);
+            printf_help_exit();
         }
-        else
+
+        // An index points into the CSF file, so there needs to be one
+        if(WriteIndex && !strcmp(argv[i], "-"))
         {
-            // Read String header from file
-            fread(String, sizeof(CSFString) - sizeof(String->Value), 1, CSFFile_Handle);
+            printf_help_exit();
+        }
 
-            // Sanity check for STR or STRW magic value
-            if(String->MagicHeader != STR_MAGIC && String->MagicHeader != STRW_MAGIC)
+        for(k = i + 1; k < argc; k++)
+        {
+            if(!strcmp(argv[k], "-"))
             {
-                printf_error_exit("Wrong header in String, expected STR or STRW in Label ", Label->LabelName);
+                Stream = stderr;
             }
+        }
 
-            // Calloc memory for decoded String value, + 1 ensures it's null-terminated
-            String->Value = calloc_d(1, String->ValueLength + 1);
-
-            k = 0;
+        CSFContext_Init(&Context);
+        Context.Log = printf_log;
+        Context.UserData = Stream;
+        Context.Stats = Stats;
 
-            // Read Encoded (notted) non-null-terminated value from file
-            // Since the value is unicode the Value length needs to be multiplied by 2
-            // Decode (not) string and skip empty Unicode bytes
-            for(j = 0; j < String->ValueLength * 2; j++)
-            {
-                EncodedChar = fgetc(CSFFile_Handle);
+        fprintf(Stream, "\n");
 
-                if(!(j % 2))
-                {
-                    String->Value[k] = ~EncodedChar;
-                    k++;
-                }
-            }
+        if((Error = CSFFile_Export(&Context, argv[i], &argv[i + 1], argc - i - 1, NumThreads, Pipelined, ParallelWriters) || (WriteIndex && CSFIndexFile_Write(&Context, argv[i], NULL))))
+        {
+            printf_error(Stream, NULL, &Context);
+        }
+        else
+        {
+            fprintf(Stream, "\n");
 
-            // Sometimes a String can have some extra data following it (i.e. generals.csf from Zero Hour), denoted by a STRW header instead of STR
-            // Since there is no way to show this data properly in a STR file we'll just discard it
-            if(String->MagicHeader == STRW_MAGIC)
+            for(k = i + 1; k < argc; k++)
             {
-                printf("Warning: ExtraValue found in Label %s, discarding\n", Label->LabelName);
-
-                // Read ExtraValueLength (immediately follows after StringValue) and fseek the number it contains forward
-                fread(&ExtraValueLength, sizeof(ExtraValueLength), 1, CSFFile_Handle);
-                fseek(CSFFile_Handle, (long int)ExtraValueLength, SEEK_CUR);
+                fprintf(Stream, "Successfully converted %s to %s\n", argv[i], argv[k]);
             }
         }
-
-        // Add String to Label, add Label to CSFHeader
-        Label->String = String;
-        CSFFile_Header->Label[i] = Label;
     }
 
-    return CSFFile_Header;
-}
-
-char *
-CSFFile_GetLanguageString(uint32_t LanguageId)
-{
-    char *CSFLanguages[] =
-    {
-        CSF_LANGUAGE_STRING_ENUS,
-        CSF_LANGUAGE_STRING_ENUK,
-        CSF_LANGUAGE_STRING_DE,
-        CSF_LANGUAGE_STRING_FRFR,
-        CSF_LANGUAGE_STRING_ES,
-        CSF_LANGUAGE_STRING_IT,
-        CSF_LANGUAGE_STRING_JA,
-        CSF_LANGUAGE_STRING_JW,
-        CSF_LANGUAGE_STRING_KO,
-        CSF_LANGUAGE_STRING_CN
-    };
-
-    if(LanguageId < CSF_LANGUAGE_NUM)
+    if(PrintStats)
     {
-        return CSFLanguages[LanguageId];
+        csf_stats_print(Stream, Stats);
     }
-    else
+
+    if(StatsFile_Path)
     {
-        return NULL;
+        CSFContext_Init(&Context);
+
+        if(csf_stats_write_json(&Context, StatsFile_Path, TOOLNAME, Stats))
+        {
+            printf_error(stderr, NULL, &Context);
+            Error = 1;
+        }
     }
+
+    return Error != 0;
 }
@@ -0,0 +1,161 @@
+#include "csftools.h"
+
+#define TOOLNAME "csfdiff"
+
+static void
+printf_help_exit()
+{
+    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    printf("%s supports the following arguments:\n\n", TOOLNAME);
+    printf("%s [-j threads] [-l lang] <old csf or str> <new csf or str> to list the labels that were added, removed or changed\n", TOOLNAME);
+    printf("-j reads each file on the given number of threads\n");
+    printf("-l is the language of str files, en-us by default\n");
+    printf("files ending in .csf are read as csf files, everything else as str files\n");
+    printf("exits with 0 if the files have the same labels, 1 if they differ and 2 on an error\n\n");
+    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
+    exit(2);
+}
+
+static void
+printf_log(CSFContext *Context, int Level, const char *Message)
+{
+    (void)Context;
+
+    if(Level == CSF_LOG_WARNING)
+    {
+        fprintf(stderr, "Warning: %s\n", Message);
+    }
+}
+
+static void
+write_value(CSFWriteBuffer *Buffer, CSFLabel *Label)
+{
+    writebuffer_puts(Buffer, "\"");
+    STRFile_WriteValue(Buffer, Label->String->Value, Label->String->ValueLength);
+    writebuffer_puts(Buffer, "\"");
+
+    // The ExtraValue of a STRW String follows the value the same way it does in a STR file
+    if(Label->String->MagicHeader == STRW_MAGIC)
+    {
+        writebuffer_puts(Buffer, " ");
+        STRFile_WriteExtraValue(Buffer, Label->String->ExtraValue, Label->String->ExtraValueLength);
+    }
+}
+
+static void
+write_label(CSFWriteBuffer *Buffer, const char *Prefix, CSFLabel *Label)
+{
+    writebuffer_puts(Buffer, Prefix);
+    writebuffer_write(Buffer, Label->LabelName, Label->LabelNameLength);
+    writebuffer_puts(Buffer, " ");
+    write_value(Buffer, Label);
+}
+
+int
+main(int argc, char *argv[])
+{
+    CSFContext Context;
+    CSFFile *Old = NULL;
+    CSFFile *New = NULL;
+    CSFArena *Arena = NULL;
+    CSFDiffEntry *Entry = NULL;
+    CSFWriteBuffer *Buffer = NULL;
+    char *LanguageString = CSF_LANGUAGE_STRING_ENUS;
+    uint32_t LanguageId, NumEntries = 0;
+    uint32_t NumKind[3] = { 0, 0, 0 };
+    int NumThreads = 1;
+    uint32_t j;
+    int i;
+
+    // Options come first, a lone - is a file name
+    for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if(!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            NumThreads = atoi(argv[++i]);
+
+            if(NumThreads < 1)
+            {
+                printf_help_exit();
+            }
+        }
+        else if(!strcmp(argv[i], "-l") && i + 1 < argc)
+        {
+            LanguageString = argv[++i];
+        }
+        else
+        {
+            printf_help_exit();
+        }
+    }
+
+    if(argc - i != 2)
+    {
+        printf_help_exit();
+    }
+
+    CSFContext_Init(&Context);
+    Context.Log = printf_log;
+
+    LanguageId = CSFFile_GetLanguageId(LanguageString);
+
+    if((int32_t)LanguageId == CSF_LANGUAGE_UNKNOWN)
+    {
+        csf_error(&Context, CSF_ERROR_LANGUAGE, "Unsupported language string, please refer to the readme for the available languages", "", 0);
+    }
+
+    // Every change is one line, + for an added Label, - for a removed one and ~ for a changed one with its old and new value
+    if(!Context.Error
+        && (Old = CSFFile_Load(&Context, argv[i], LanguageId, NumThreads))
+        && (New = CSFFile_Load(&Context, argv[i + 1], LanguageId, NumThreads))
+        && (Arena = arena_create(&Context, ARENA_BLOCK_MIN))
+        && (Entry = CSFFile_Diff(&Context, Old->CSFFile_Header, New->CSFFile_Header, Arena, &NumEntries))
+        && (Buffer = writebuffer_create(&Context, stdout)))
+    {
+        for(j = 0; j < NumEntries && !Context.Error; j++)
+        {
+            NumKind[Entry[j].Kind]++;
+
+            if(Entry[j].Kind == CSF_DIFF_ADDED)
+            {
+                write_label(Buffer, "+ ", Entry[j].NewLabel);
+            }
+            else if(Entry[j].Kind == CSF_DIFF_REMOVED)
+            {
+                write_label(Buffer, "- ", Entry[j].OldLabel);
+            }
+            else
+            {
+                write_label(Buffer, "~ ", Entry[j].OldLabel);
+                writebuffer_puts(Buffer, " -> ");
+                write_value(Buffer, Entry[j].NewLabel);
+            }
+
+            writebuffer_puts(Buffer, "\n");
+        }
+
+        writebuffer_close(Buffer);
+    }
+
+    arena_free(Arena);
+    CSFFile_Free(Old);
+    CSFFile_Free(New);
+
+    if(Context.Error)
+    {
+        fprintf(stderr, "Error: %s%s", Context.ErrorMessage, Context.ErrorDetail);
+
+        if(Context.ErrorLine)
+        {
+            fprintf(stderr, " in line %u", Context.ErrorLine);
+        }
+
+        fprintf(stderr, "\n");
+
+        return 2;
+    }
+
+    fprintf(stderr, "%u added, %u removed, %u changed\n", NumKind[CSF_DIFF_ADDED], NumKind[CSF_DIFF_REMOVED], NumKind[CSF_DIFF_CHANGED]);
+
+    return NumEntries != 0;
+}
@@ -0,0 +1,155 @@
+#include "csftools.h"
+
+#define TOOLNAME "csfgrep"
+
+static void
+printf_help_exit()
+{
+    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    printf("%s supports the following arguments:\n\n", TOOLNAME);
+    printf("%s [-j threads] [-i] [-E] [--names | --values] <pattern> <input csf> [more csf files] to list the labels that contain pattern\n", TOOLNAME);
+    printf("-j searches each file on the given number of threads\n");
+    printf("-i ignores the case of ascii letters\n");
+    printf("-E makes pattern a posix extended regular expression instead of a plain string\n");
+    printf("--names only searches label names, --values only values, by default both are searched\n");
+    printf("every matching label is one line, with the name of its file in front if there's more than one file\n");
+    printf("exits with 0 if any label matched, 1 if none did and 2 on an error\n\n");
+    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
+    exit(2);
+}
+
+static void
+printf_log(CSFContext *Context, int Level, const char *Message)
+{
+    (void)Context;
+
+    if(Level == CSF_LOG_WARNING)
+    {
+        fprintf(stderr, "Warning: %s\n", Message);
+    }
+}
+
+static void
+write_label(CSFWriteBuffer *Buffer, const char *Path, CSFLabel *Label)
+{
+    // Same as a line of csfdiff
+    if(Path)
+    {
+        writebuffer_puts(Buffer, Path);
+        writebuffer_puts(Buffer, ":");
+    }
+
+    writebuffer_write(Buffer, Label->LabelName, Label->LabelNameLength);
+    writebuffer_puts(Buffer, " \"");
+    STRFile_WriteValue(Buffer, Label->String->Value, Label->String->ValueLength);
+    writebuffer_puts(Buffer, "\"");
+
+    if(Label->String->MagicHeader == STRW_MAGIC)
+    {
+        writebuffer_puts(Buffer, " ");
+        STRFile_WriteExtraValue(Buffer, Label->String->ExtraValue, Label->String->ExtraValueLength);
+    }
+
+    writebuffer_puts(Buffer, "\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    CSFContext Context;
+    CSFSearch Search;
+    CSFReader *Reader = NULL;
+    CSFArena *Arena = NULL;
+    CSFHeader *Found = NULL;
+    CSFWriteBuffer *Buffer = NULL;
+    uint32_t NumFound = 0;
+    int Flags = 0;
+    int NumThreads = 1;
+    uint32_t j;
+    int i, k;
+
+    // Options come first, a lone - is a file name
+    for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if(!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            NumThreads = atoi(argv[++i]);
+
+            if(NumThreads < 1)
+            {
+                printf_help_exit();
+            }
+        }
+        else if(!strcmp(argv[i], "-i"))
+        {
+            Flags |= CSF_SEARCH_IGNORE_CASE;
+        }
+        else if(!strcmp(argv[i], "-E"))
+        {
+            Flags |= CSF_SEARCH_REGEX;
+        }
+        else if(!strcmp(argv[i], "--names"))
+        {
+            Flags |= CSF_SEARCH_NAMES;
+        }
+        else if(!strcmp(argv[i], "--values"))
+        {
+            Flags |= CSF_SEARCH_VALUES;
+        }
+        else
+        {
+            printf_help_exit();
+        }
+    }
+
+    if(argc - i < 2)
+    {
+        printf_help_exit();
+    }
+
+    CSFContext_Init(&Context);
+    Context.Log = printf_log;
+
+    if(CSFSearch_Init(&Context, &Search, argv[i], Flags) == CSF_OK)
+    {
+        Buffer = writebuffer_create(&Context, stdout);
+    }
+
+    // Every file is searched on its own, its Labels are released before the next one is opened
+    for(k = i + 1; Buffer && k < argc && !Context.Error; k++)
+    {
+        if((Reader = CSFReader_Open(&Context, argv[k], 1))
+            && (Arena = arena_create(&Context, ARENA_BLOCK_MIN))
+            && (Found = CSFFileHeader_Search(Reader, Arena, &Search, NumThreads)))
+        {
+            for(j = 0; j < Found->NumLabels && !Context.Error; j++)
+            {
+                write_label(Buffer, argc - i > 2 ? argv[k] : NULL, Found->Label[j]);
+            }
+
+            NumFound += Found->NumLabels;
+        }
+
+        arena_free(Arena);
+        CSFReader_Close(Reader);
+
+        Arena = NULL;
+        Reader = NULL;
+    }
+
+    if(Buffer)
+    {
+        writebuffer_close(Buffer);
+    }
+
+    CSFSearch_Free(&Search);
+
+    if(Context.Error)
+    {
+        fprintf(stderr, "Error: %s%s\n", Context.ErrorMessage, Context.ErrorDetail);
+
+        return 2;
+    }
+
+    return NumFound == 0;
+}
@@ -0,0 +1,155 @@
+#include "csftools.h"
+
+#define TOOLNAME "csfmerge"
+
+static void
+printf_help_exit()
+{
+    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    printf("%s supports the following arguments:\n\n", TOOLNAME);
+    printf("%s [-j threads] [-l lang] <base> <ours> <theirs> <output> to merge the changes of ours and theirs since base\n", TOOLNAME);
+    printf("-j reads each file on the given number of threads\n");
+    printf("-l is the language of str files, en-us by default\n");
+    printf("files ending in .csf are read and written as csf files, everything else as str files\n");
+    printf("labels that were changed on both sides are listed as conflicts and get the value of ours\n");
+    printf("exits with 0 if there were no conflicts, 1 if there were and 2 on an error\n");
+    printf("use - as output to write to stdout\n\n");
+    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
+    exit(2);
+}
+
+static void
+printf_log(CSFContext *Context, int Level, const char *Message)
+{
+    fprintf(Context->UserData, "%s%s\n", Level == CSF_LOG_WARNING ? "Warning: " : "", Message);
+}
+
+static void
+printf_conflict(FILE *Stream, CSFMergeConflict *Conflict)
+{
+    CSFLabel *Label = Conflict->OurLabel ? Conflict->OurLabel : Conflict->TheirLabel;
+    const char *Reason;
+
+    if(!Conflict->BaseLabel)
+    {
+        Reason = "added on both sides with different values";
+    }
+    else if(!Conflict->TheirLabel)
+    {
+        Reason = "changed in ours, removed in theirs";
+    }
+    else if(!Conflict->OurLabel)
+    {
+        Reason = "removed in ours, changed in theirs";
+    }
+    else
+    {
+        Reason = "changed on both sides";
+    }
+
+    fprintf(Stream, "Conflict: %.*s %s\n", (int)Label->LabelNameLength, Label->LabelName, Reason);
+}
+
+int
+main(int argc, char *argv[])
+{
+    CSFContext Context;
+    CSFFile *File[3] = { NULL, NULL, NULL };
+    CSFArena *Arena = NULL;
+    CSFHeader *CSFFile_Header = NULL;
+    CSFMergeConflict *Conflict = NULL;
+    char *LanguageString = CSF_LANGUAGE_STRING_ENUS;
+    uint32_t LanguageId, NumConflicts = 0;
+    int NumThreads = 1;
+    uint32_t j;
+    int i;
+
+    // Options come first, a lone - is a file name
+    for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if(!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            NumThreads = atoi(argv[++i]);
+
+            if(NumThreads < 1)
+            {
+                printf_help_exit();
+            }
+        }
+        else if(!strcmp(argv[i], "-l") && i + 1 < argc)
+        {
+            LanguageString = argv[++i];
+        }
+        else
+        {
+            printf_help_exit();
+        }
+    }
+
+    if(argc - i != 4)
+    {
+        printf_help_exit();
+    }
+
+    // Messages go to stdout, unless that's where the merged file goes
+    CSFContext_Init(&Context);
+    Context.Log = printf_log;
+    Context.UserData = strcmp(argv[i + 3], "-") ? stdout : stderr;
+
+    fprintf(Context.UserData, "\n");
+
+    LanguageId = CSFFile_GetLanguageId(LanguageString);
+
+    if((int32_t)LanguageId == CSF_LANGUAGE_UNKNOWN)
+    {
+        csf_error(&Context, CSF_ERROR_LANGUAGE, "Unsupported language string, please refer to the readme for the available languages", "", 0);
+    }
+
+    for(j = 0; j < 3 && !Context.Error; j++)
+    {
+        File[j] = CSFFile_Load(&Context, argv[i + j], LanguageId, NumThreads);
+    }
+
+    if(!Context.Error
+        && (Arena = arena_create(&Context, ARENA_BLOCK_MIN))
+        && (CSFFile_Header = CSFFile_Merge(&Context, File[0]->CSFFile_Header, File[1]->CSFFile_Header, File[2]->CSFFile_Header, Arena, &Conflict, &NumConflicts)))
+    {
+        for(j = 0; j < NumConflicts; j++)
+        {
+            printf_conflict(Context.UserData, &Conflict[j]);
+        }
+
+        CSFFile_Save(&Context, CSFFile_Header, argv[i + 3]);
+    }
+
+    arena_free(Arena);
+
+    for(j = 0; j < 3; j++)
+    {
+        CSFFile_Free(File[j]);
+    }
+
+    if(Context.Error)
+    {
+        fprintf(Context.UserData, "Error: %s%s", Context.ErrorMessage, Context.ErrorDetail);
+
+        if(Context.ErrorLine)
+        {
+            fprintf(Context.UserData, " in line %u", Context.ErrorLine);
+        }
+
+        fprintf(Context.UserData, "\n");
+
+        return 2;
+    }
+
+    if(NumConflicts)
+    {
+        fprintf(Context.UserData, "\nMerged into %s with %u conflicts\n", argv[i + 3], NumConflicts);
+        return 1;
+    }
+
+    fprintf(Context.UserData, "\nSuccessfully merged into %s\n", argv[i + 3]);
+
+    return 0;
+}
@@ -1,16 +1,26 @@
+#ifndef CSFTOOLS_H
+#define CSFTOOLS_H
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 
-#ifdef CSF2STR
-#define TOOLNAME "csf2str"
-#elif STR2CSF
-#define TOOLNAME "str2csf"
-#endif
+#define ARENA_BLOCK_MIN 65536
+#define ARENA_ALIGN 16
+
+#define WRITEBUFFER_SIZE 262144
+#define WRITEBUFFER_COPY_MIN 65536
+
+#define CSFREADER_DISCARD_SIZE 4194304
+#define STRREADER_WINDOW_SIZE 1048576
+
+#define PIPELINE_BLOCK_SIZE 1048576
+#define PIPELINE_NUM_BLOCKS 4
 
-#define LINE_MAX 2048
+#define CSF_ERROR_DETAIL_MAX 256
+#define CSF_LOG_MAX 512
 
 #define CSFTOOLS_VERSION_MAJOR 0
 #define CSFTOOLS_VERSION_MINOR 1
@@ -19,6 +29,9 @@
 #define LBL_MAGIC 0x4C424C20
 #define STR_MAGIC 0x53545220
 #define STRW_MAGIC 0x53545257
+#define CSFIDX_MAGIC 0x43534649
+
+#define CSFIDX_VERSION 1
 
 #define CSF_VERSION_2 2
 #define CSF_VERSION_3 3
@@ -57,9 +70,133 @@ enum STRStates
     STR_STATE_END
 };
 
+enum CSFErrors
+{
+    CSF_OK,
+    CSF_ERROR_OPEN,
+    CSF_ERROR_READ,
+    CSF_ERROR_WRITE,
+    CSF_ERROR_MEMORY,
+    CSF_ERROR_FORMAT,
+    CSF_ERROR_LANGUAGE,
+    CSF_ERROR_PATTERN
+};
+
+enum CSFLogLevels
+{
+    CSF_LOG_INFO,
+    CSF_LOG_WARNING
+};
+
+// Counters of CSFStats, times are in nanoseconds
+// Decode and encode are part of parse and write, only the bytes written through a CSFWriteBuffer are counted
+enum CSFStatCounters
+{
+    CSF_STAT_TIME_TOTAL,
+    CSF_STAT_TIME_OPEN,
+    CSF_STAT_TIME_PARSE,
+    CSF_STAT_TIME_DECODE,
+    CSF_STAT_TIME_WRITE,
+    CSF_STAT_TIME_ENCODE,
+    CSF_STAT_BYTES_READ,
+    CSF_STAT_BYTES_WRITTEN,
+    CSF_STAT_ALLOCATIONS,
+    CSF_STAT_ALLOCATED_BYTES,
+    CSF_STAT_REALLOCATIONS,
+    CSF_STAT_LABEL_GROWTHS,
+    CSF_STAT_INTERNED_BYTES,
+    CSF_STAT_NUM
+};
+
+enum CSFTableFlags
+{
+    CSF_TABLE_NO_STRING = 1,
+    CSF_TABLE_STRW = 2
+};
+
+enum CSFSearchFlags
+{
+    CSF_SEARCH_NAMES = 1,
+    CSF_SEARCH_VALUES = 2,
+    CSF_SEARCH_IGNORE_CASE = 4,
+    CSF_SEARCH_REGEX = 8
+};
+
+enum CSFFormats
+{
+    CSF_FORMAT_CSF,
+    CSF_FORMAT_STR,
+    CSF_FORMAT_JSON,
+    CSF_FORMAT_CSV,
+    CSF_FORMAT_PO
+};
+
+enum CSFDiffKinds
+{
+    CSF_DIFF_ADDED,
+    CSF_DIFF_REMOVED,
+    CSF_DIFF_CHANGED
+};
+
+typedef struct CSFContext CSFContext;
+typedef struct CSFStats CSFStats;
 typedef struct CSFHeader CSFHeader;
 typedef struct CSFLabel CSFLabel;
 typedef struct CSFString CSFString;
+typedef struct CSFArena CSFArena;
+typedef struct CSFArenaBlock CSFArenaBlock;
+typedef struct CSFWriteBuffer CSFWriteBuffer;
+typedef struct CSFRing CSFRing;
+typedef struct CSFBlock CSFBlock;
+typedef struct CSFPipeReader CSFPipeReader;
+typedef struct CSFPipeWriter CSFPipeWriter;
+typedef struct STRReader STRReader;
+typedef struct CSFReader CSFReader;
+typedef struct CSFDecodeJob CSFDecodeJob;
+typedef struct CSFParseJob CSFParseJob;
+typedef struct CSFIndex CSFIndex;
+typedef struct CSFIndexFileHeader CSFIndexFileHeader;
+typedef struct CSFIndexFileEntry CSFIndexFileEntry;
+typedef struct CSFIndexFile CSFIndexFile;
+typedef struct CSFPool CSFPool;
+typedef struct CSFBatch CSFBatch;
+typedef struct CSFBatchJob CSFBatchJob;
+typedef struct CSFCache CSFCache;
+typedef struct CSFCacheEntry CSFCacheEntry;
+typedef struct CSFFile CSFFile;
+typedef struct CSFDiffEntry CSFDiffEntry;
+typedef struct CSFMergeConflict CSFMergeConflict;
+typedef struct CSFTable CSFTable;
+typedef struct CSFIntern CSFIntern;
+typedef struct CSFInternSlot CSFInternSlot;
+typedef struct CSFInternEntry CSFInternEntry;
+typedef struct CSFTransform CSFTransform;
+typedef struct CSFTransformRecord CSFTransformRecord;
+typedef struct CSFSearch CSFSearch;
+typedef struct CSFSearchJob CSFSearchJob;
+typedef struct CSFExporter CSFExporter;
+typedef struct CSFImporter CSFImporter;
+
+// Everything in libcsf that can fail takes a caller-owned context, on failure it returns NULL or an error code and leaves the details in the context
+// Nothing in libcsf prints anything or exits, messages and warnings are handed to Log if it's set
+// A context must not be shared between threads that run at the same time
+struct CSFContext
+{
+    int Error;
+    const char *ErrorMessage;
+    char ErrorDetail[CSF_ERROR_DETAIL_MAX];
+    uint32_t ErrorLine;
+    void (*Log)(CSFContext *Context, int Level, const char *Message);
+    void *UserData;
+    CSFStats *Stats;
+};
+
+// If a context has Stats, everything done with it is counted there, otherwise nothing is measured at all
+// Contexts of several threads can share the same Stats, the counters are only ever added to atomically
+struct CSFStats
+{
+    uint64_t Counter[CSF_STAT_NUM];
+};
 
 // From https://www.modenc.renegadeprojects.com/CSF_File_Format
 
@@ -74,6 +211,8 @@ struct CSFHeader
     CSFLabel *Label[];
 };
 
+// LabelName and Value are not necessarily null-terminated (they may point into a mapped CSF or STR file), always use LabelNameLength and ValueLength
+// Values are UTF-8 and ValueLength is in bytes, only in a CSF file it's the number of UTF-16 units
 struct CSFLabel
 {
     uint32_t MagicHeader;
@@ -83,31 +222,589 @@ struct CSFLabel
     CSFString *String;
 };
 
+// A STRW String has an ExtraValue after its value, opaque bytes that are passed through as they are (Zero Hour keeps the names of speech files there)
 struct CSFString
 {
     uint32_t MagicHeader;
     uint32_t ValueLength;
     char *Value;
+    uint32_t ExtraValueLength;
+    uint8_t *ExtraValue;
+};
+
+// All Labels, Strings and values of a CSFHeader are allocated from an arena and released together with arena_free
+struct CSFArena
+{
+    CSFContext *Context;
+    CSFArenaBlock *Block;
+    size_t BlockSize;
+};
+
+struct CSFArenaBlock
+{
+    CSFArenaBlock *Next;
+    size_t Size;
+    size_t Used;
+    uint8_t Data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+// Once a write fails, everything after it is dropped and writebuffer_close returns the error
+// With Pipe, full buffers are written by the thread of Pipe while the next one is filled
+struct CSFWriteBuffer
+{
+    CSFContext *Context;
+    FILE *Handle;
+    size_t Used;
+    size_t Size;
+    uint8_t *Data;
+    CSFPipeWriter *Pipe;
+};
+
+// A bounded ring of pointers between exactly two threads, one pushes and the other one pops, so it needs no lock
+// Head and Tail only ever grow, what's in the ring is Head - Tail
+struct CSFRing
+{
+    void *Slot[PIPELINE_NUM_BLOCKS];
+    uint32_t Head;
+    uint32_t Tail;
+};
+
+struct CSFBlock
+{
+    uint8_t *Data;
+    size_t Size;
+    size_t Used;
+};
+
+// Blocks go around from Free to the reading thread to Full to pipereader_read and back to Free, one with Used 0 is the end of the file
+// Offset, Error and the blocks it's filling belong to the thread, Current and Eof to the caller
+struct CSFPipeReader
+{
+    CSFContext *Context;
+    FILE *Handle;
+    int Regular;
+    uint64_t Offset;
+    int Error;
+    int Stop;
+    CSFBlock Block[PIPELINE_NUM_BLOCKS];
+    CSFRing Free;
+    CSFRing Full;
+    CSFBlock *Current;
+    size_t CurrentOffset;
+    int Eof;
+    void *Thread;
+};
+
+// Blocks go around from Free to pipewriter_submit to Full to the writing thread and back to Free
+struct CSFPipeWriter
+{
+    CSFContext *Context;
+    FILE *Handle;
+    int Error;
+    int Done;
+    CSFBlock Block[PIPELINE_NUM_BLOCKS];
+    CSFRing Free;
+    CSFRing Full;
+    void *Thread;
+};
+
+struct CSFReader
+{
+    CSFContext *Context;
+    FILE *Handle;
+    CSFPipeReader *Pipe;
+    uint8_t *Data;
+    size_t Size;
+    size_t Offset;
+    size_t LabelOffset;
+    size_t Discarded;
+    int Mapped;
+    int InPlace;
+    int Prescan;
+    CSFHeader Header;
+    uint32_t Index;
+    CSFLabel Label;
+    CSFString String;
+    uint8_t *Buffer[3];
+    size_t BufferSize[3];
+    char *ValueBuffer;
+    size_t ValueBufferSize;
+};
+
+struct CSFDecodeJob
+{
+    CSFContext Context;
+    CSFArena *Arena;
+    CSFHeader *CSFFile_Header;
+    uint32_t LabelStart;
+    uint32_t LabelEnd;
+};
+
+struct STRReader
+{
+    CSFContext *Context;
+    FILE *Handle;
+    CSFPipeReader *Pipe;
+    char *Data;
+    size_t Size;
+    size_t Capacity;
+    size_t Offset;
+    size_t Keep;
+    size_t Discarded;
+    uint32_t Line;
+    int Mapped;
+    int InPlace;
+    int Eof;
+    CSFLabel Label;
+    CSFString String;
+};
+
+struct CSFParseJob
+{
+    CSFContext Context;
+    STRReader Reader;
+    uint32_t LanguageId;
+    CSFArena *Arena;
+    CSFIntern *Intern;
+    CSFHeader *CSFFile_Header;
+};
+
+// Looks up Labels of a CSFHeader by name, case-insensitively like the game does
+// Slot holds Label index + 1 of every slot, 0 is empty, with Seed it's a minimal perfect hash with one Seed per bucket, otherwise an open addressing hash table
+// Built over a CSFTable instead, CSFFile_Header is NULL and Labels are found with CSFIndex_FindIndex
+struct CSFIndex
+{
+    CSFHeader *CSFFile_Header;
+    CSFTable *Table;
+    uint32_t *Slot;
+    uint32_t NumSlots;
+    uint32_t *Seed;
+    uint32_t NumBuckets;
+};
+
+// A .csfidx file is a CSFIndexFileHeader followed by one CSFIndexFileEntry per Label, sorted by Hash
+// Hash is CSFIndex_Hash of the LabelName, Offset is where the Label starts in the CSF file
+struct CSFIndexFileHeader
+{
+    uint32_t MagicHeader;
+    uint32_t Version;
+    uint32_t NumEntries;
+    uint32_t Unknown;
+    uint64_t CSFSize;
+    uint64_t CSFChecksum;
+};
+
+struct CSFIndexFileEntry
+{
+    uint64_t Hash;
+    uint64_t Offset;
+};
+
+// Either CSFData and IndexData are mapped, or the CSF file has been parsed by Reader and is looked up through Index
+struct CSFIndexFile
+{
+    CSFContext *Context;
+    uint8_t *CSFData;
+    size_t CSFSize;
+    uint8_t *IndexData;
+    size_t IndexSize;
+    CSFIndexFileEntry *Entry;
+    uint32_t NumEntries;
+    CSFReader *Reader;
+    CSFArena *Arena;
+    CSFHeader *CSFFile_Header;
+    CSFIndex *Index;
+    CSFLabel Label;
+    CSFString String;
+    char *ValueBuffer;
+    size_t ValueBufferSize;
+};
+
+// Every worker of threads_run_pool takes the next job from Next until there are none left
+struct CSFPool
+{
+    void *(*Function)(void *);
+    uint8_t *Args;
+    size_t ArgSize;
+    size_t NumArgs;
+    size_t Next;
+};
+
+// A batch converts a list of files in one direction, each job has a context of its own so one broken file doesn't stop the others
+// Log of a job's context is the Log of the batch, UserData is the job itself, and all jobs count into the Stats of the batch's context
+struct CSFBatch
+{
+    CSFContext *Context;
+    CSFArena *Arena;
+    CSFBatchJob *Job;
+    uint32_t NumJobs;
+    uint32_t JobCapacity;
+    int ToCSF;
+    int WriteIndex;
+    int Pipelined;
+    void (*Log)(CSFContext *Context, int Level, const char *Message);
+    void *UserData;
+};
+
+struct CSFBatchJob
+{
+    CSFBatch *Batch;
+    char *InputPath;
+    char *OutputPath;
+    char *LanguageString;
+    CSFContext Context;
+};
+
+// The Labels of a previously written CSF file, by exact LabelName, so unchanged ones can be copied from it byte for byte
+// Entries point into the mapping of Reader, Offset and Size are where the whole Label is in the file
+struct CSFCache
+{
+    CSFContext *Context;
+    CSFReader *Reader;
+    CSFCacheEntry *Entry;
+    uint32_t NumEntries;
+    uint32_t *Slot;
+    uint32_t NumSlots;
+    int Complete;
+};
+
+struct CSFCacheEntry
+{
+    uint64_t Hash;
+    size_t Offset;
+    size_t Size;
+    char *LabelName;
+    uint32_t LabelNameLength;
+    uint32_t MagicHeader;
+    uint8_t *EncodedValue;
+    uint32_t ValueLength;
+    uint8_t *ExtraValue;
+    uint32_t ExtraValueLength;
+};
+
+// All Labels of a CSF or a STR file, with whichever reader they still point into
+struct CSFFile
+{
+    CSFContext *Context;
+    CSFReader *CSFReader;
+    STRReader *STRReader;
+    CSFArena *Arena;
+    CSFHeader *CSFFile_Header;
+};
+
+// All Labels of a CSF or STR file as parallel arrays instead of a CSFLabel and a CSFString per Label, so walking them doesn't chase pointers
+// LabelNames, values and ExtraValues are copied into one Blob and the offsets point into it, so the file isn't needed anymore
+// The ExtraValue of a STRW String comes right after its LabelName, Header counts the Labels and Strings like the one of a CSF file
+struct CSFTable
+{
+    CSFContext *Context;
+    CSFHeader Header;
+    uint32_t Capacity;
+    uint32_t *NameOffset;
+    uint32_t *NameLength;
+    uint32_t *ValueOffset;
+    uint32_t *ValueLength;
+    uint32_t *ExtraValueLength;
+    uint8_t *Flags;
+    uint8_t *Blob;
+    size_t BlobSize;
+    size_t BlobCapacity;
+};
+
+// Strings of a STR file that are the same for many Labels (i.e. "OK" or the names of units), each one is stored once and shared by all Labels that have it
+// ValueSlot finds an entry by its value, StringSlot by its String, which only has the entries shared by more than one Label, NULL is empty in both
+// SavedBytes is what the shared Strings and values would have taken otherwise
+struct CSFIntern
+{
+    CSFContext *Context;
+    CSFArena *Arena;
+    CSFInternSlot *ValueSlot;
+    uint32_t NumValueSlots;
+    uint32_t NumEntries;
+    CSFInternEntry **StringSlot;
+    uint32_t NumStringSlots;
+    uint32_t NumShared;
+    uint32_t NumInterned;
+    uint32_t NumEncodesSaved;
+    uint64_t SavedBytes;
+};
+
+// The hash is kept next to the entry, so a lookup only reads entries whose hash matches
+struct CSFInternSlot
+{
+    uint64_t Hash;
+    CSFInternEntry *Entry;
+};
+
+// The encoded value is kept once it was written, EncodedValueLength is its number of UTF-16 units
+struct CSFInternEntry
+{
+    CSFString String;
+    uint32_t NumLabels;
+    uint32_t EncodedValueLength;
+    uint8_t *EncodedValue;
+};
+
+// OldLabel is NULL for an added Label, NewLabel for a removed one
+struct CSFDiffEntry
+{
+    int Kind;
+    CSFLabel *OldLabel;
+    CSFLabel *NewLabel;
+};
+
+// Each Label is NULL if its file doesn't have it
+struct CSFMergeConflict
+{
+    CSFLabel *BaseLabel;
+    CSFLabel *OurLabel;
+    CSFLabel *TheirLabel;
+};
+
+// What CSFFile_Transform changes, a LanguageId or CSFVersion of -1 keeps the one of the input
+// With NumPrefixes, only Labels whose LabelName starts with one of Prefix (without case) are kept
+struct CSFTransform
+{
+    int32_t LanguageId;
+    int32_t CSFVersion;
+    int DropEmpty;
+    int Sort;
+    char **Prefix;
+    uint32_t NumPrefixes;
+};
+
+// Where a Label is in the input file, Index is its position there so sorting keeps the order of equal LabelNames
+struct CSFTransformRecord
+{
+    size_t Offset;
+    size_t Size;
+    char *LabelName;
+    uint32_t LabelNameLength;
+    uint32_t Index;
+};
+
+// What CSFFileHeader_Search looks for, in LabelNames and/or values depending on Flags
+// Pattern is a substring, or with CSF_SEARCH_REGEX a POSIX extended regular expression that CSFSearch_Init compiles into Regex
+// Ignoring case only works for ASCII letters, for a substring Pattern is a lowercase copy then
+struct CSFSearch
+{
+    CSFContext *Context;
+    char *Pattern;
+    size_t PatternLength;
+    int Flags;
+    void *Regex;
+};
+
+// Every job matches its own range of Labels and sets Match of each one that matches, values of a prescanned file are decoded on the way
+// A regular expression needs a null-terminated LabelName, which is copied to NameBuffer for that
+struct CSFSearchJob
+{
+    CSFContext Context;
+    CSFArena *Arena;
+    CSFSearch *Search;
+    CSFHeader *CSFFile_Header;
+    uint8_t *Match;
+    int Prescanned;
+    char *NameBuffer;
+    size_t NameBufferSize;
+    uint32_t LabelStart;
+    uint32_t LabelEnd;
+};
+
+// One output of CSFFile_Export, in the format its extension says, with a context of its own so every output can be written on a thread of its own
+// CSFFile_Header is what that thread writes, NumLabels counts what was written so far
+struct CSFExporter
+{
+    CSFContext Context;
+    int Format;
+    char *Path;
+    char *TempPath;
+    FILE *Handle;
+    CSFWriteBuffer *Buffer;
+    CSFHeader *CSFFile_Header;
+    uint32_t NumLabels;
+};
+
+// A JSON, CSV or PO file that's read as a whole, mapped if it's a regular file and read into memory otherwise
+// Values are unescaped in place, so the Labels of CSFFileHeader_Import point into Data until CSFImporter_Close
+struct CSFImporter
+{
+    CSFContext *Context;
+    int Format;
+    char *Data;
+    size_t Size;
+    int Mapped;
 };
 
 // util.c
-void printf_help_exit();
-void printf_error_exit(char *message, char *labelname);
-FILE *fopen_d(const char *path, const char *mode);
-void *malloc_d(size_t size);
-void *calloc_d(size_t nitems, size_t size);
-void *realloc_d(void *ptr, size_t size);
-void *recalloc_d(void *ptr, size_t ptrsize,  size_t nitems, size_t size);
-char *fgets_t(char *str, int n, FILE *stream);
-char *strtrim(char *str);
-char *strupr(char *str);
-
-// csf2str.c
-void CSFFile_ConvertToSTRFile(char *CSFFile_Path, char *STRFile_Path);
-CSFHeader *CSFFileHeader_Parse(FILE *CSFFile_Handle);
-char *CSFFile_GetLanguageString(uint32_t LanguageId);
+void CSFContext_Init(CSFContext *Context);
+int csf_error(CSFContext *Context, int Error, const char *Message, const char *Detail, size_t DetailLength);
+void csf_log(CSFContext *Context, int Level, const char *Format, ...);
+uint64_t csf_time();
+uint64_t csf_stats_start(CSFContext *Context);
+void csf_stats_stop(CSFContext *Context, int Counter, uint64_t Start);
+void csf_stats_add(CSFContext *Context, int Counter, uint64_t Value);
+const char *csf_stats_name(int Counter);
+void csf_stats_print(FILE *Stream, CSFStats *Stats);
+int csf_stats_write_json(CSFContext *Context, const char *Path, const char *Tool, CSFStats *Stats);
+void threads_run(int NumThreads, void *(*Function)(void *), void *Args, size_t ArgSize);
+void threads_run_pool(int NumThreads, void *(*Function)(void *), void *Args, size_t ArgSize, size_t NumArgs);
+void *thread_start(void *(*Function)(void *), void *Args);
+void thread_join(void *Thread);
+void thread_backoff(uint32_t *Spins);
+int wildcard_match(const char *Pattern, const char *Name);
+char **dir_list(CSFArena *Arena, const char *Path, uint32_t *Count);
+FILE *fopen_c(CSFContext *Context, const char *path, const char *mode);
+int fclose_c(FILE *stream);
+FILE *fopen_replace(CSFContext *Context, const char *path, char **temp_path);
+int fclose_replace(CSFContext *Context, FILE *stream, const char *path, char *temp_path);
+void *fmap(const char *path, size_t *size);
+void fmap_discard(void *ptr, size_t size);
+void funmap(void *ptr, size_t size);
+void *malloc_c(CSFContext *Context, size_t size);
+void *calloc_c(CSFContext *Context, size_t nitems, size_t size);
+void *realloc_c(CSFContext *Context, void *ptr, size_t size);
+CSFArena *arena_create(CSFContext *Context, size_t size);
+void *arena_alloc(CSFArena *arena, size_t size);
+void *arena_calloc(CSFArena *arena, size_t nitems, size_t size);
+void arena_merge(CSFArena *arena, CSFArena *other);
+void arena_free(CSFArena *arena);
+CSFWriteBuffer *writebuffer_create(CSFContext *Context, FILE *stream);
+CSFWriteBuffer *writebuffer_create_pipelined(CSFContext *Context, FILE *stream);
+int writebuffer_flush(CSFWriteBuffer *buffer);
+void writebuffer_write(CSFWriteBuffer *buffer, const void *data, size_t size);
+void *writebuffer_reserve(CSFWriteBuffer *buffer, size_t size);
+void writebuffer_unreserve(CSFWriteBuffer *buffer, size_t size);
+void writebuffer_puts(CSFWriteBuffer *buffer, const char *str);
+void writebuffer_copy(CSFWriteBuffer *buffer, FILE *stream, const uint8_t *data, size_t offset, size_t size);
+int writebuffer_close(CSFWriteBuffer *buffer);
+size_t CSFString_Decode(char *Value, const uint8_t *EncodedValue, size_t ValueLength, size_t *Decoded);
+size_t CSFString_Encode(uint8_t *EncodedValue, const char *Value, size_t ValueLength);
+int CSFString_EqualEncoded(const char *Value, size_t ValueLength, const uint8_t *EncodedValue, size_t EncodedLength);
+size_t csf_escape_length(const char *Value, size_t ValueLength);
+const char *csf_memmem(const char *Haystack, size_t HaystackLength, const char *Needle, size_t NeedleLength, int IgnoreCase);
 
-// str2csf.c
-void STRFile_ConvertToCSFFile(char *STRFile_Path, char *CSFFile_Path, char *LanguageString);
-CSFHeader *CSFFileHeader_Create(FILE *STRFile_Handle, uint32_t LanguageId);
+// pipe.c
+int ring_push(CSFRing *Ring, void *Item);
+void *ring_pop(CSFRing *Ring);
+uint32_t ring_count(CSFRing *Ring);
+CSFPipeReader *pipereader_open(CSFContext *Context, const char *path);
+size_t pipereader_read(CSFPipeReader *Pipe, void *data, size_t size);
+int pipereader_error(CSFPipeReader *Pipe);
+void pipereader_close(CSFPipeReader *Pipe);
+CSFPipeWriter *pipewriter_create(CSFContext *Context, FILE *stream);
+int pipewriter_submit(CSFPipeWriter *Pipe, uint8_t **data, size_t *size, size_t used);
+int pipewriter_drain(CSFPipeWriter *Pipe);
+int pipewriter_close(CSFPipeWriter *Pipe);
+
+// csf.c
+CSFReader *CSFReader_Open(CSFContext *Context, char *CSFFile_Path, int InPlace);
+CSFReader *CSFReader_OpenPipelined(CSFContext *Context, char *CSFFile_Path);
+CSFLabel *CSFReader_Next(CSFReader *Reader);
+void CSFReader_Close(CSFReader *Reader);
+CSFHeader *CSFFileHeader_Parse(CSFReader *Reader, CSFArena *Arena);
+int CSFString_DecodePrescanned(CSFString *String, CSFArena *Arena);
+CSFHeader *CSFFileHeader_ParseParallel(CSFReader *Reader, CSFArena *Arena, int NumThreads);
+void CSFFileHeader_Init(CSFHeader *CSFFile_Header, uint32_t LanguageId);
+void CSFFile_WriteLabel(CSFWriteBuffer *CSFFile_Buffer, CSFLabel *Label);
+void CSFFile_WriteEncodedLabel(CSFWriteBuffer *CSFFile_Buffer, CSFLabel *Label, const uint8_t *EncodedValue, uint32_t ValueLength);
+char *CSFFile_GetLanguageString(uint32_t LanguageId);
 uint32_t CSFFile_GetLanguageId(char *LanguageString);
+
+// str.c
+STRReader *STRReader_Open(CSFContext *Context, char *STRFile_Path, int InPlace);
+STRReader *STRReader_OpenPipelined(CSFContext *Context, char *STRFile_Path);
+void STRReader_Close(STRReader *Reader);
+char *STRReader_NextLine(STRReader *Reader, size_t *STRFile_Line_Len);
+CSFLabel *STRReader_Next(STRReader *Reader);
+size_t STRFile_UnescapeValue(char *StringValue, size_t StringValueLength);
+size_t STRFile_UnescapeExtraValue(char *ExtraValue, size_t ExtraValueLength);
+CSFHeader *CSFFileHeader_Create(STRReader *Reader, uint32_t LanguageId, CSFArena *Arena, CSFIntern *Intern);
+CSFHeader *CSFFileHeader_CreateParallel(STRReader *Reader, uint32_t LanguageId, CSFArena *Arena, CSFIntern *Intern, int NumThreads);
+void STRFile_WriteLabel(CSFWriteBuffer *STRFile_Buffer, CSFLabel *Label);
+void STRFile_WriteValue(CSFWriteBuffer *STRFile_Buffer, const char *StringValue, size_t StringValueLength);
+void STRFile_WriteExtraValue(CSFWriteBuffer *STRFile_Buffer, const uint8_t *ExtraValue, size_t ExtraValueLength);
+
+// index.c
+uint64_t CSFIndex_Mix(uint64_t Hash);
+uint64_t CSFIndex_Hash(const char *LabelName, size_t LabelNameLength);
+int CSFIndex_Equal(CSFLabel *Label, const char *LabelName, size_t LabelNameLength);
+CSFIndex *CSFIndex_Create(CSFContext *Context, CSFHeader *CSFFile_Header, int Perfect);
+CSFIndex *CSFIndex_CreateFromTable(CSFContext *Context, CSFTable *Table, int Perfect);
+uint32_t CSFIndex_FindIndex(CSFIndex *Index, const char *LabelName, size_t LabelNameLength);
+CSFLabel *CSFIndex_Find(CSFIndex *Index, const char *LabelName, size_t LabelNameLength);
+void CSFIndex_Free(CSFIndex *Index);
+
+// indexfile.c
+char *CSFIndexFile_GetPath(CSFContext *Context, const char *CSFFile_Path);
+int CSFIndexFile_Write(CSFContext *Context, char *CSFFile_Path, char *IndexFile_Path);
+CSFIndexFile *CSFIndexFile_Open(CSFContext *Context, char *CSFFile_Path, char *IndexFile_Path);
+CSFLabel *CSFIndexFile_Find(CSFIndexFile *IndexFile, const char *LabelName, size_t LabelNameLength);
+void CSFIndexFile_Close(CSFIndexFile *IndexFile);
+
+// batch.c
+CSFBatch *CSFBatch_Create(CSFContext *Context, int ToCSF);
+int CSFBatch_Add(CSFBatch *Batch, const char *InputPath, const char *OutputPath, const char *LanguageString);
+int CSFBatch_AddList(CSFBatch *Batch, char *ListFile_Path);
+int CSFBatch_AddDirectory(CSFBatch *Batch, const char *Directory, const char *Pattern, const char *LanguageString);
+uint32_t CSFBatch_Run(CSFBatch *Batch, int NumThreads);
+void CSFBatch_Free(CSFBatch *Batch);
+
+// cache.c
+CSFCache *CSFCache_Open(CSFContext *Context, char *CSFFile_Path);
+CSFCacheEntry *CSFCache_Find(CSFCache *Cache, CSFLabel *Label);
+void CSFCache_Close(CSFCache *Cache);
+
+// intern.c
+CSFIntern *CSFIntern_Create(CSFContext *Context, CSFArena *Arena, size_t Size);
+CSFString *CSFIntern_Add(CSFIntern *Intern, CSFString *String, int Copy);
+int CSFIntern_Merge(CSFIntern *Intern, CSFIntern *Other);
+void CSFIntern_WriteLabel(CSFIntern *Intern, CSFWriteBuffer *CSFFile_Buffer, CSFLabel *Label);
+void CSFIntern_WriteHeader(CSFIntern *Intern, CSFWriteBuffer *CSFFile_Buffer, CSFHeader *CSFFile_Header);
+void CSFIntern_Report(CSFIntern *Intern);
+void CSFIntern_Free(CSFIntern *Intern);
+
+// table.c
+CSFTable *CSFTable_Create(CSFContext *Context, uint32_t LanguageId);
+int CSFTable_Add(CSFTable *Table, CSFLabel *Label);
+void CSFTable_GetLabel(CSFTable *Table, uint32_t i, CSFLabel *Label, CSFString *String);
+CSFTable *CSFTable_Load(CSFContext *Context, char *Path, uint32_t LanguageId);
+int CSFTable_Save(CSFContext *Context, CSFTable *Table, char *Path);
+void CSFTable_Free(CSFTable *Table);
+
+// diff.c
+int CSFFile_IsCSFPath(const char *Path);
+CSFFile *CSFFile_Load(CSFContext *Context, char *Path, uint32_t LanguageId, int NumThreads);
+int CSFFile_Save(CSFContext *Context, CSFHeader *CSFFile_Header, char *Path);
+void CSFFile_Free(CSFFile *File);
+CSFDiffEntry *CSFFile_Diff(CSFContext *Context, CSFHeader *Old, CSFHeader *New, CSFArena *Arena, uint32_t *NumEntries);
+CSFHeader *CSFFile_Merge(CSFContext *Context, CSFHeader *Base, CSFHeader *Ours, CSFHeader *Theirs, CSFArena *Arena, CSFMergeConflict **Conflict, uint32_t *NumConflicts);
+
+// export.c
+int CSFFile_GetFormat(const char *Path);
+int CSFExporter_Open(CSFContext *Context, CSFExporter *Exporter, char *Path, CSFHeader *CSFFile_Header, int Pipelined);
+void CSFExporter_WriteLabel(CSFExporter *Exporter, CSFLabel *Label);
+int CSFExporter_Close(CSFExporter *Exporter, CSFContext *Context);
+
+// import.c
+CSFImporter *CSFImporter_Open(CSFContext *Context, char *Path);
+CSFHeader *CSFFileHeader_Import(CSFImporter *Importer, uint32_t LanguageId, CSFArena *Arena, CSFIntern *Intern);
+void CSFImporter_Close(CSFImporter *Importer);
+
+// convert.c
+int CSFFile_Export(CSFContext *Context, char *CSFFile_Path, char **Output_Path, int NumOutputs, int NumThreads, int Pipelined, int Threaded);
+int CSFFile_ConvertToSTRFile(CSFContext *Context, char *CSFFile_Path, char *STRFile_Path, int NumThreads, int Pipelined);
+int STRFile_ConvertToCSFFile(CSFContext *Context, char *STRFile_Path, char *CSFFile_Path, char *LanguageString, int NumThreads, int Pipelined);
+int STRFile_ConvertToCSFFileIncremental(CSFContext *Context, char *STRFile_Path, char *CSFFile_Path, char *LanguageString, char *PreviousCSFFile_Path, int NumThreads, int Pipelined);
+
+// xform.c
+void CSFTransform_Init(CSFTransform *Transform);
+int CSFFile_Transform(CSFContext *Context, char *InputFile_Path, char *OutputFile_Path, CSFTransform *Transform);
+
+// search.c
+int CSFSearch_Init(CSFContext *Context, CSFSearch *Search, const char *Pattern, int Flags);
+int CSFSearch_Label(CSFSearch *Search, CSFLabel *Label);
+CSFHeader *CSFFileHeader_Search(CSFReader *Reader, CSFArena *Arena, CSFSearch *Search, int NumThreads);
+void CSFSearch_Free(CSFSearch *Search);
+
+#endif
@@ -0,0 +1,115 @@
+#include "csftools.h"
+
+#define TOOLNAME "csfxform"
+
+static void
+printf_help_exit()
+{
+    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    printf("%s supports the following arguments:\n\n", TOOLNAME);
+    printf("%s [options] <input.csf> <output.csf> to change a csf file without converting it to str and back\n", TOOLNAME);
+    printf("-l lang sets the language in the csf header\n");
+    printf("-v version sets the csf version in the csf header, 2 or 3\n");
+    printf("-e drops labels with an empty value\n");
+    printf("-s sorts labels by name\n");
+    printf("-p prefix only keeps labels whose name starts with prefix (i.e. GUI:), can be given more than once\n");
+    printf("labels are copied byte for byte, input and output can be the same file\n");
+    printf("use - as output to write to stdout, input has to be a regular file\n\n");
+    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
+    exit(1);
+}
+
+static void
+printf_log(CSFContext *Context, int Level, const char *Message)
+{
+    fprintf(Context->UserData, "%s%s\n", Level == CSF_LOG_WARNING ? "Warning: " : "", Message);
+}
+
+int
+main(int argc, char *argv[])
+{
+    CSFContext Context;
+    CSFTransform Transform;
+    char *LanguageString = NULL;
+    char **Prefix;
+    int i;
+
+    CSFTransform_Init(&Transform);
+
+    // At most every other argument is a prefix
+    if(!(Prefix = malloc(argc * sizeof(char *))))
+    {
+        printf("Error: Couldn't allocate memory\n");
+        return 1;
+    }
+
+    Transform.Prefix = Prefix;
+
+    // Options come first, a lone - is a file name
+    for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if(!strcmp(argv[i], "-l") && i + 1 < argc)
+        {
+            LanguageString = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-v") && i + 1 < argc)
+        {
+            Transform.CSFVersion = atoi(argv[++i]);
+
+            if(Transform.CSFVersion != CSF_VERSION_2 && Transform.CSFVersion != CSF_VERSION_3)
+            {
+                printf_help_exit();
+            }
+        }
+        else if(!strcmp(argv[i], "-e"))
+        {
+            Transform.DropEmpty = 1;
+        }
+        else if(!strcmp(argv[i], "-s"))
+        {
+            Transform.Sort = 1;
+        }
+        else if(!strcmp(argv[i], "-p") && i + 1 < argc)
+        {
+            Prefix[Transform.NumPrefixes++] = argv[++i];
+        }
+        else
+        {
+            printf_help_exit();
+        }
+    }
+
+    if(argc - i != 2)
+    {
+        printf_help_exit();
+    }
+
+    // Messages go to stdout, unless that's where the output file goes
+    CSFContext_Init(&Context);
+    Context.Log = printf_log;
+    Context.UserData = strcmp(argv[i + 1], "-") ? stdout : stderr;
+
+    fprintf(Context.UserData, "\n");
+
+    if(LanguageString && (Transform.LanguageId = CSFFile_GetLanguageId(LanguageString)) == CSF_LANGUAGE_UNKNOWN)
+    {
+        csf_error(&Context, CSF_ERROR_LANGUAGE, "Unsupported language string, please refer to the readme for the available languages", "", 0);
+    }
+
+    if(!Context.Error)
+    {
+        CSFFile_Transform(&Context, argv[i], argv[i + 1], &Transform);
+    }
+
+    free(Prefix);
+
+    if(Context.Error)
+    {
+        fprintf(Context.UserData, "Error: %s%s\n", Context.ErrorMessage, Context.ErrorDetail);
+        return 1;
+    }
+
+    fprintf(Context.UserData, "\nSuccessfully transformed %s into %s\n", argv[i], argv[i + 1]);
+
+    return 0;
+}
@@ -0,0 +1,337 @@
+#include "csftools.h"
+
+int
+CSFFile_IsCSFPath(const char *Path)
+{
+    size_t Path_Len = strlen(Path);
+
+    // Files ending in .csf are CSF files, everything else (including - for stdin) is a STR file
+    return Path_Len >= 4 && Path[Path_Len - 4] == '.' && tolower((unsigned char)Path[Path_Len - 3]) == 'c'
+        && tolower((unsigned char)Path[Path_Len - 2]) == 's' && tolower((unsigned char)Path[Path_Len - 1]) == 'f';
+}
+
+static int
+CSFDiff_ValueEqual(CSFLabel *Label, CSFLabel *OtherLabel)
+{
+    // The ExtraValue of a STRW String counts as part of the value
+    return Label->String->ValueLength == OtherLabel->String->ValueLength && !memcmp(Label->String->Value, OtherLabel->String->Value, Label->String->ValueLength)
+        && Label->String->MagicHeader == OtherLabel->String->MagicHeader && Label->String->ExtraValueLength == OtherLabel->String->ExtraValueLength
+        && (!Label->String->ExtraValueLength || !memcmp(Label->String->ExtraValue, OtherLabel->String->ExtraValue, Label->String->ExtraValueLength));
+}
+
+CSFFile *
+CSFFile_Load(CSFContext *Context, char *Path, uint32_t LanguageId, int NumThreads)
+{
+    CSFFile *File;
+
+    // Reads all Labels of a CSF or a STR file, depending on the extension of Path
+    // LanguageId is only used for STR files, a CSF file has its own
+    // The Labels point into the file where possible, so it stays open until CSFFile_Free
+    if(!(File = calloc_c(Context, 1, sizeof(CSFFile))))
+    {
+        return NULL;
+    }
+
+    File->Context = Context;
+
+    if(CSFFile_IsCSFPath(Path))
+    {
+        if((File->CSFReader = CSFReader_Open(Context, Path, 1))
+            && (File->Arena = arena_create(Context, File->CSFReader->Header.NumLabels * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString)))))
+        {
+            File->CSFFile_Header = CSFFileHeader_ParseParallel(File->CSFReader, File->Arena, NumThreads);
+        }
+    }
+    else
+    {
+        if((File->STRReader = STRReader_Open(Context, Path, 1))
+            && (File->Arena = arena_create(Context, (File->STRReader->Mapped ? File->STRReader->Size : STRREADER_WINDOW_SIZE) / 32 * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString)))))
+        {
+            if(File->STRReader->Mapped && NumThreads > 1)
+            {
+                File->CSFFile_Header = CSFFileHeader_CreateParallel(File->STRReader, LanguageId, File->Arena, NULL, NumThreads);
+            }
+            else
+            {
+                File->CSFFile_Header = CSFFileHeader_Create(File->STRReader, LanguageId, File->Arena, NULL);
+            }
+        }
+    }
+
+    if(!File->CSFFile_Header)
+    {
+        CSFFile_Free(File);
+        return NULL;
+    }
+
+    return File;
+}
+
+int
+CSFFile_Save(CSFContext *Context, CSFHeader *CSFFile_Header, char *Path)
+{
+    FILE *Handle;
+    CSFWriteBuffer *Buffer = NULL;
+    uint32_t i;
+
+    // Writes all Labels of CSFFile_Header to a CSF or a STR file, depending on the extension of Path
+    if((Handle = fopen_c(Context, Path, "wb")))
+    {
+        Buffer = writebuffer_create(Context, Handle);
+    }
+
+    if(Buffer)
+    {
+        if(CSFFile_IsCSFPath(Path))
+        {
+            writebuffer_write(Buffer, CSFFile_Header, sizeof(CSFHeader));
+        }
+
+        for(i = 0; i < CSFFile_Header->NumLabels && !Context->Error; i++)
+        {
+            if(CSFFile_IsCSFPath(Path))
+            {
+                CSFFile_WriteLabel(Buffer, CSFFile_Header->Label[i]);
+            }
+            else
+            {
+                STRFile_WriteLabel(Buffer, CSFFile_Header->Label[i]);
+            }
+        }
+
+        writebuffer_close(Buffer);
+    }
+
+    if(Handle && fclose_c(Handle))
+    {
+        csf_error(Context, CSF_ERROR_WRITE, "Couldn't write to ", Path, strlen(Path));
+    }
+
+    return Context->Error;
+}
+
+void
+CSFFile_Free(CSFFile *File)
+{
+    if(File == NULL)
+    {
+        return;
+    }
+
+    arena_free(File->Arena);
+    CSFReader_Close(File->CSFReader);
+    STRReader_Close(File->STRReader);
+    free(File);
+}
+
+static int
+CSFFile_IsFirst(CSFContext *Context, CSFIndex **Index, CSFHeader *CSFFile_Header, uint32_t i)
+{
+    // Whether Label i is the first one with its name, only few Labels need this so the index is built the first time it's asked for
+    if(!*Index && !(*Index = CSFIndex_Create(Context, CSFFile_Header, 0)))
+    {
+        return 0;
+    }
+
+    return CSFIndex_FindIndex(*Index, CSFFile_Header->Label[i]->LabelName, CSFFile_Header->Label[i]->LabelNameLength) == i + 1;
+}
+
+CSFDiffEntry *
+CSFFile_Diff(CSFContext *Context, CSFHeader *Old, CSFHeader *New, CSFArena *Arena, uint32_t *NumEntries)
+{
+    CSFDiffEntry *Entry;
+    CSFIndex *OldIndex = NULL;
+    CSFIndex *NewIndex = NULL;
+    uint8_t *Matched;
+    uint32_t i, j;
+
+    // Joins the Labels of both files by name through a CSFIndex of Old, so this takes linear time
+    // Added and changed Labels come first in the order of New, then the removed ones in the order of Old
+    // LabelNames are compared without case like the game does, and only the first of several Labels with the same name counts, same as in the game
+    // Matched marks the Labels of Old that New has, the ones that aren't are removed, so New only needs an index to find its own duplicates
+    *NumEntries = 0;
+
+    if(!(Entry = arena_alloc(Arena, ((size_t)Old->NumLabels + New->NumLabels) * sizeof(CSFDiffEntry) + 1))
+        || !(Matched = arena_calloc(Arena, Old->NumLabels + (size_t)1, 1))
+        || !(OldIndex = CSFIndex_Create(Context, Old, 0)))
+    {
+        return NULL;
+    }
+
+    for(i = 0; i < New->NumLabels && !Context->Error; i++)
+    {
+        if((j = CSFIndex_FindIndex(OldIndex, New->Label[i]->LabelName, New->Label[i]->LabelNameLength)))
+        {
+            // An earlier Label of New with the same name already got this one
+            if(Matched[j - 1])
+            {
+                continue;
+            }
+
+            Matched[j - 1] = 1;
+
+            if(CSFDiff_ValueEqual(Old->Label[j - 1], New->Label[i]))
+            {
+                continue;
+            }
+
+            Entry[*NumEntries].Kind = CSF_DIFF_CHANGED;
+            Entry[*NumEntries].OldLabel = Old->Label[j - 1];
+        }
+        else
+        {
+            if(!CSFFile_IsFirst(Context, &NewIndex, New, i))
+            {
+                continue;
+            }
+
+            Entry[*NumEntries].Kind = CSF_DIFF_ADDED;
+            Entry[*NumEntries].OldLabel = NULL;
+        }
+
+        Entry[*NumEntries].NewLabel = New->Label[i];
+        (*NumEntries)++;
+    }
+
+    for(i = 0; i < Old->NumLabels && !Context->Error; i++)
+    {
+        if(!Matched[i] && CSFFile_IsFirst(Context, &OldIndex, Old, i))
+        {
+            Entry[*NumEntries].Kind = CSF_DIFF_REMOVED;
+            Entry[*NumEntries].OldLabel = Old->Label[i];
+            Entry[*NumEntries].NewLabel = NULL;
+            (*NumEntries)++;
+        }
+    }
+
+    CSFIndex_Free(OldIndex);
+    CSFIndex_Free(NewIndex);
+
+    return Context->Error ? NULL : Entry;
+}
+
+static CSFLabel *
+CSFFile_MergeLabel(CSFLabel *Base, CSFLabel *Ours, CSFLabel *Theirs, int *Conflict)
+{
+    // Returns what's left of a Label after merging, NULL if it's been removed
+    // A Label only one side changed (or added, or removed) gets that change, one both sides changed the same way too
+    // Anything else is a conflict, ours wins then, and a Label one side removed and the other changed is kept
+    *Conflict = 0;
+
+    if(Ours && Theirs && CSFDiff_ValueEqual(Ours, Theirs))
+    {
+        return Ours;
+    }
+
+    if(!Base)
+    {
+        *Conflict = Ours && Theirs;
+        return Ours ? Ours : Theirs;
+    }
+
+    if(Ours && CSFDiff_ValueEqual(Base, Ours))
+    {
+        return Theirs;
+    }
+
+    if(Theirs && CSFDiff_ValueEqual(Base, Theirs))
+    {
+        return Ours;
+    }
+
+    *Conflict = Ours || Theirs;
+
+    return Ours ? Ours : Theirs;
+}
+
+CSFHeader *
+CSFFile_Merge(CSFContext *Context, CSFHeader *Base, CSFHeader *Ours, CSFHeader *Theirs, CSFArena *Arena, CSFMergeConflict **Conflict, uint32_t *NumConflicts)
+{
+    CSFHeader *CSFFile_Header;
+    CSFIndex *BaseIndex = NULL;
+    CSFIndex *OurIndex = NULL;
+    CSFIndex *TheirIndex = NULL;
+    CSFLabel *BaseLabel, *OurLabel, *TheirLabel, *Label;
+    uint8_t *Matched;
+    int IsConflict;
+    uint32_t i, j;
+
+    // Three-way merge of the Labels of Ours and Theirs, which both started out as Base
+    // The merged Labels come in the order of Ours, followed by the ones only Theirs added in their order, the CSF header is the one of Ours
+    // Every conflict is added to Conflict, the Labels point into the three files so they need to stay around as long as the result is used
+    // Labels are joined by name the same way CSFFile_Diff does, Matched marks the Labels of Theirs that Ours has
+    *NumConflicts = 0;
+
+    if(!(CSFFile_Header = arena_alloc(Arena, sizeof(CSFHeader) + ((size_t)Ours->NumLabels + Theirs->NumLabels) * sizeof(CSFLabel *)))
+        || !(*Conflict = arena_alloc(Arena, ((size_t)Ours->NumLabels + Theirs->NumLabels) * sizeof(CSFMergeConflict) + 1))
+        || !(Matched = arena_calloc(Arena, Theirs->NumLabels + (size_t)1, 1))
+        || !(BaseIndex = CSFIndex_Create(Context, Base, 0))
+        || !(TheirIndex = CSFIndex_Create(Context, Theirs, 0)))
+    {
+        CSFIndex_Free(BaseIndex);
+        return NULL;
+    }
+
+    memcpy(CSFFile_Header, Ours, sizeof(CSFHeader));
+    CSFFile_Header->NumLabels = 0;
+
+    for(i = 0; i < (size_t)Ours->NumLabels + Theirs->NumLabels && !Context->Error; i++)
+    {
+        if(i < Ours->NumLabels)
+        {
+            OurLabel = Ours->Label[i];
+            TheirLabel = NULL;
+
+            if((j = CSFIndex_FindIndex(TheirIndex, OurLabel->LabelName, OurLabel->LabelNameLength)))
+            {
+                // An earlier Label of Ours with the same name already got this one
+                if(Matched[j - 1])
+                {
+                    continue;
+                }
+
+                Matched[j - 1] = 1;
+                TheirLabel = Theirs->Label[j - 1];
+            }
+            else if(!CSFFile_IsFirst(Context, &OurIndex, Ours, i))
+            {
+                continue;
+            }
+        }
+        else
+        {
+            // Only Theirs has the Labels that are left
+            if(Matched[i - Ours->NumLabels] || !CSFFile_IsFirst(Context, &TheirIndex, Theirs, i - Ours->NumLabels))
+            {
+                continue;
+            }
+
+            OurLabel = NULL;
+            TheirLabel = Theirs->Label[i - Ours->NumLabels];
+        }
+
+        Label = OurLabel ? OurLabel : TheirLabel;
+        BaseLabel = CSFIndex_Find(BaseIndex, Label->LabelName, Label->LabelNameLength);
+
+        if((Label = CSFFile_MergeLabel(BaseLabel, OurLabel, TheirLabel, &IsConflict)))
+        {
+            CSFFile_Header->Label[CSFFile_Header->NumLabels++] = Label;
+        }
+
+        if(IsConflict)
+        {
+            (*Conflict)[*NumConflicts].BaseLabel = BaseLabel;
+            (*Conflict)[*NumConflicts].OurLabel = OurLabel;
+            (*Conflict)[*NumConflicts].TheirLabel = TheirLabel;
+            (*NumConflicts)++;
+        }
+    }
+
+    CSFFile_Header->NumStrings = CSFFile_Header->NumLabels;
+
+    CSFIndex_Free(BaseIndex);
+    CSFIndex_Free(OurIndex);
+    CSFIndex_Free(TheirIndex);
+
+    return Context->Error ? NULL : CSFFile_Header;
+}
@@ -0,0 +1,405 @@
+#include "csftools.h"
+
+static int
+CSFFile_HasExtension(const char *Path, const char *Extension)
+{
+    size_t Path_Len = strlen(Path);
+    size_t Extension_Len = strlen(Extension);
+    size_t i;
+
+    if(Path_Len < Extension_Len)
+    {
+        return 0;
+    }
+
+    for(i = 0; i < Extension_Len && tolower((unsigned char)Path[Path_Len - Extension_Len + i]) == Extension[i]; i++);
+
+    return i == Extension_Len;
+}
+
+int
+CSFFile_GetFormat(const char *Path)
+{
+    // Same as CSFFile_IsCSFPath, the extension decides, everything that isn't known (including - for stdin or stdout) is a STR file
+    if(CSFFile_IsCSFPath(Path))
+    {
+        return CSF_FORMAT_CSF;
+    }
+    else if(CSFFile_HasExtension(Path, ".json"))
+    {
+        return CSF_FORMAT_JSON;
+    }
+    else if(CSFFile_HasExtension(Path, ".csv"))
+    {
+        return CSF_FORMAT_CSV;
+    }
+    else if(CSFFile_HasExtension(Path, ".po"))
+    {
+        return CSF_FORMAT_PO;
+    }
+
+    return CSF_FORMAT_STR;
+}
+
+static void
+CSFExporter_WriteExtraValue(CSFWriteBuffer *Buffer, const uint8_t *ExtraValue, size_t ExtraValueLength, int Format)
+{
+    char Escape[6];
+    size_t Start, i;
+
+    // Written so that STRFile_UnescapeExtraValue reads it back, printable chars as they are, a backslash as \\ and everything else as \xHH
+    // Quotes, commas and spaces are escaped as well, so it never has to be quoted in a CSV file, in JSON every backslash is escaped once more
+    for(Start = 0, i = 0; i < ExtraValueLength; i++)
+    {
+        if(ExtraValue[i] > ' ' && ExtraValue[i] < 0x7F && ExtraValue[i] != '\\' && ExtraValue[i] != '"' && ExtraValue[i] != ',')
+        {
+            continue;
+        }
+
+        writebuffer_write(Buffer, ExtraValue + Start, i - Start);
+
+        if(ExtraValue[i] == '\\')
+        {
+            writebuffer_puts(Buffer, Format == CSF_FORMAT_JSON ? "\\\\\\\\" : "\\\\");
+        }
+        else
+        {
+            sprintf(Escape, Format == CSF_FORMAT_JSON ? "\\\\x%02X" : "\\x%02X", ExtraValue[i]);
+            writebuffer_puts(Buffer, Escape);
+        }
+
+        Start = i + 1;
+    }
+
+    writebuffer_write(Buffer, ExtraValue + Start, ExtraValueLength - Start);
+}
+
+static void
+JSONFile_WriteRun(CSFWriteBuffer *JSONFile_Buffer, const char *Value, size_t ValueLength)
+{
+    char Escape[7];
+    const char *Surrogate;
+
+    // A lone surrogate of a CSF file is decoded to a 3 byte char of its own (0xED 0xA0 to 0xBF), which isn't valid UTF-8, so it's written as a \u escape
+    // Only those need to be looked for, other chars starting with 0xED (most of Hangul) are written as they are
+    while((Surrogate = memchr(Value, 0xED, ValueLength)) && (size_t)(Surrogate - Value) + 3 <= ValueLength)
+    {
+        if((uint8_t)Surrogate[1] < 0xA0)
+        {
+            writebuffer_write(JSONFile_Buffer, Value, Surrogate - Value + 1);
+        }
+        else
+        {
+            writebuffer_write(JSONFile_Buffer, Value, Surrogate - Value);
+            sprintf(Escape, "\\u%04X", 0xD000 | ((uint8_t)Surrogate[1] & 0x3F) << 6 | ((uint8_t)Surrogate[2] & 0x3F));
+            writebuffer_puts(JSONFile_Buffer, Escape);
+            Surrogate += 2;
+        }
+
+        ValueLength -= Surrogate - Value + 1;
+        Value = Surrogate + 1;
+    }
+
+    writebuffer_write(JSONFile_Buffer, Value, ValueLength);
+}
+
+static void
+JSONFile_WriteValue(CSFWriteBuffer *JSONFile_Buffer, const char *Value, size_t ValueLength)
+{
+    char Escape[7];
+    size_t Length;
+
+    // Quotes, backslashes and control chars are escaped, everything else is UTF-8 already
+    // A value ends at its first null char, same as in a STR file
+    for(;;)
+    {
+        Length = csf_escape_length(Value, ValueLength);
+        JSONFile_WriteRun(JSONFile_Buffer, Value, Length);
+
+        if(Length == ValueLength || Value[Length] == '\0')
+        {
+            break;
+        }
+
+        switch(Value[Length])
+        {
+        case '"':
+            writebuffer_puts(JSONFile_Buffer, "\\\"");
+            break;
+        case '\\':
+            writebuffer_puts(JSONFile_Buffer, "\\\\");
+            break;
+        case '\n':
+            writebuffer_puts(JSONFile_Buffer, "\\n");
+            break;
+        case '\r':
+            writebuffer_puts(JSONFile_Buffer, "\\r");
+            break;
+        case '\t':
+            writebuffer_puts(JSONFile_Buffer, "\\t");
+            break;
+        default:
+            sprintf(Escape, "\\u%04X", (uint8_t)Value[Length]);
+            writebuffer_puts(JSONFile_Buffer, Escape);
+            break;
+        }
+
+        Value += Length + 1;
+        ValueLength -= Length + 1;
+    }
+}
+
+static void
+JSONFile_WriteLabel(CSFWriteBuffer *JSONFile_Buffer, CSFLabel *Label, int First)
+{
+    // A JSON file is an array of one object per Label, with its LabelName, its value and the ExtraValue of a STRW String
+    writebuffer_puts(JSONFile_Buffer, First ? "\n    {\"label\": \"" : ",\n    {\"label\": \"");
+    JSONFile_WriteValue(JSONFile_Buffer, Label->LabelName, Label->LabelNameLength);
+    writebuffer_puts(JSONFile_Buffer, "\", \"value\": \"");
+    JSONFile_WriteValue(JSONFile_Buffer, Label->String->Value, Label->String->ValueLength);
+
+    if(Label->String->MagicHeader == STRW_MAGIC)
+    {
+        writebuffer_puts(JSONFile_Buffer, "\", \"extra\": \"");
+        CSFExporter_WriteExtraValue(JSONFile_Buffer, Label->String->ExtraValue, Label->String->ExtraValueLength, CSF_FORMAT_JSON);
+    }
+
+    writebuffer_puts(JSONFile_Buffer, "\"}");
+}
+
+static void
+CSVFile_WriteValue(CSFWriteBuffer *CSVFile_Buffer, const char *Value, size_t ValueLength)
+{
+    size_t Length;
+
+    // Fields are always quoted, so only quotes are doubled, newlines and everything else stay as they are
+    writebuffer_puts(CSVFile_Buffer, "\"");
+
+    for(;;)
+    {
+        Length = csf_escape_length(Value, ValueLength);
+        writebuffer_write(CSVFile_Buffer, Value, Length);
+
+        if(Length == ValueLength || Value[Length] == '\0')
+        {
+            break;
+        }
+
+        if(Value[Length] == '"')
+        {
+            writebuffer_puts(CSVFile_Buffer, "\"\"");
+        }
+        else
+        {
+            writebuffer_write(CSVFile_Buffer, Value + Length, 1);
+        }
+
+        Value += Length + 1;
+        ValueLength -= Length + 1;
+    }
+
+    writebuffer_puts(CSVFile_Buffer, "\"");
+}
+
+static void
+CSVFile_WriteLabel(CSFWriteBuffer *CSVFile_Buffer, CSFLabel *Label)
+{
+    // One record per Label, the third field is the ExtraValue of a STRW String, a single backslash for an empty one
+    CSVFile_WriteValue(CSVFile_Buffer, Label->LabelName, Label->LabelNameLength);
+    writebuffer_puts(CSVFile_Buffer, ",");
+    CSVFile_WriteValue(CSVFile_Buffer, Label->String->Value, Label->String->ValueLength);
+    writebuffer_puts(CSVFile_Buffer, ",");
+
+    if(Label->String->MagicHeader == STRW_MAGIC)
+    {
+        if(!Label->String->ExtraValueLength)
+        {
+            writebuffer_puts(CSVFile_Buffer, "\\");
+        }
+
+        CSFExporter_WriteExtraValue(CSVFile_Buffer, Label->String->ExtraValue, Label->String->ExtraValueLength, CSF_FORMAT_CSV);
+    }
+
+    writebuffer_puts(CSVFile_Buffer, "\r\n");
+}
+
+static void
+POFile_WriteValue(CSFWriteBuffer *POFile_Buffer, const char *Keyword, const char *Value, size_t ValueLength)
+{
+    char Escape[5];
+    size_t Length;
+    int Multiline;
+
+    // Same escapes as in C, a value with newlines in it gets a line of its own for each of them, like gettext writes them
+    Multiline = ValueLength > 1 && memchr(Value, '\n', ValueLength - 1);
+
+    writebuffer_puts(POFile_Buffer, Keyword);
+    writebuffer_puts(POFile_Buffer, Multiline ? " \"\"\n\"" : " \"");
+
+    for(;;)
+    {
+        Length = csf_escape_length(Value, ValueLength);
+        writebuffer_write(POFile_Buffer, Value, Length);
+
+        if(Length == ValueLength || Value[Length] == '\0')
+        {
+            break;
+        }
+
+        switch(Value[Length])
+        {
+        case '"':
+            writebuffer_puts(POFile_Buffer, "\\\"");
+            break;
+        case '\\':
+            writebuffer_puts(POFile_Buffer, "\\\\");
+            break;
+        case '\n':
+            writebuffer_puts(POFile_Buffer, Multiline && Length + 1 < ValueLength ? "\\n\"\n\"" : "\\n");
+            break;
+        case '\r':
+            writebuffer_puts(POFile_Buffer, "\\r");
+            break;
+        case '\t':
+            writebuffer_puts(POFile_Buffer, "\\t");
+            break;
+        default:
+            sprintf(Escape, "\\%03o", (uint8_t)Value[Length]);
+            writebuffer_puts(POFile_Buffer, Escape);
+            break;
+        }
+
+        Value += Length + 1;
+        ValueLength -= Length + 1;
+    }
+
+    writebuffer_puts(POFile_Buffer, "\"\n");
+}
+
+static void
+POFile_WriteLabel(CSFWriteBuffer *POFile_Buffer, CSFLabel *Label)
+{
+    // The LabelName is the context, the value is the source text and the translation is left empty for translators to fill in
+    // The ExtraValue of a STRW String is kept in a comment for translators, which their tools keep as it is
+    writebuffer_puts(POFile_Buffer, "\n");
+
+    if(Label->String->MagicHeader == STRW_MAGIC)
+    {
+        writebuffer_puts(POFile_Buffer, "#. extra: ");
+
+        if(!Label->String->ExtraValueLength)
+        {
+            writebuffer_puts(POFile_Buffer, "\\");
+        }
+
+        CSFExporter_WriteExtraValue(POFile_Buffer, Label->String->ExtraValue, Label->String->ExtraValueLength, CSF_FORMAT_PO);
+        writebuffer_puts(POFile_Buffer, "\n");
+    }
+
+    POFile_WriteValue(POFile_Buffer, "msgctxt", Label->LabelName, Label->LabelNameLength);
+    POFile_WriteValue(POFile_Buffer, "msgid", Label->String->Value, Label->String->ValueLength);
+    writebuffer_puts(POFile_Buffer, "msgstr \"\"\n");
+}
+
+int
+CSFExporter_Open(CSFContext *Context, CSFExporter *Exporter, char *Path, CSFHeader *CSFFile_Header, int Pipelined)
+{
+    char *LanguageString;
+
+    // Opens Path for writing and writes whatever its format has before the first Label, only the language of CSFFile_Header is used
+    // The exporter gets a context of its own with the Log and Stats of Context, errors end up in Context as well
+    memset(Exporter, 0, sizeof(CSFExporter));
+
+    Exporter->Context.Log = Context->Log;
+    Exporter->Context.UserData = Context->UserData;
+    Exporter->Context.Stats = Context->Stats;
+    Exporter->Format = CSFFile_GetFormat(Path);
+    Exporter->Path = Path;
+
+    // Written to a temporary file first, so a CSF file that turns out to be broken halfway through leaves the previous output as it was
+    if((Exporter->Handle = fopen_replace(&Exporter->Context, Path, &Exporter->TempPath)))
+    {
+        Exporter->Buffer = Pipelined ? writebuffer_create_pipelined(&Exporter->Context, Exporter->Handle) : writebuffer_create(&Exporter->Context, Exporter->Handle);
+    }
+
+    if(!Exporter->Buffer)
+    {
+        return CSFExporter_Close(Exporter, Context);
+    }
+
+    if(Exporter->Format == CSF_FORMAT_JSON)
+    {
+        writebuffer_puts(Exporter->Buffer, "[");
+    }
+    else if(Exporter->Format == CSF_FORMAT_CSV)
+    {
+        writebuffer_puts(Exporter->Buffer, "label,value,extra\r\n");
+    }
+    else if(Exporter->Format == CSF_FORMAT_PO)
+    {
+        // The header entry of a PO file is the one without a context and an empty msgid
+        LanguageString = CSFFile_GetLanguageString(CSFFile_Header->Language);
+
+        writebuffer_puts(Exporter->Buffer, "msgid \"\"\nmsgstr \"\"\n\"Content-Type: text/plain; charset=UTF-8\\n\"\n\"Language: ");
+        writebuffer_puts(Exporter->Buffer, LanguageString ? LanguageString : "");
+        writebuffer_puts(Exporter->Buffer, "\\n\"\n");
+    }
+
+    return CSF_OK;
+}
+
+void
+CSFExporter_WriteLabel(CSFExporter *Exporter, CSFLabel *Label)
+{
+    // Anything that isn't JSON, CSV or PO is written as a STR file, so are CSF files, which only ever got STR files written to them
+    switch(Exporter->Format)
+    {
+    case CSF_FORMAT_JSON:
+        JSONFile_WriteLabel(Exporter->Buffer, Label, !Exporter->NumLabels);
+        break;
+    case CSF_FORMAT_CSV:
+        CSVFile_WriteLabel(Exporter->Buffer, Label);
+        break;
+    case CSF_FORMAT_PO:
+        POFile_WriteLabel(Exporter->Buffer, Label);
+        break;
+    default:
+        STRFile_WriteLabel(Exporter->Buffer, Label);
+        break;
+    }
+
+    Exporter->NumLabels++;
+}
+
+int
+CSFExporter_Close(CSFExporter *Exporter, CSFContext *Context)
+{
+    // Writes whatever its format has after the last Label and closes the file
+    // The first error of the exporter is handed over to Context, unless that has one already, returns the error of Context
+    // The output is only replaced if neither the exporter nor Context has an error, i.e. reading the CSF file didn't fail
+    if(Exporter->Buffer)
+    {
+        if(Exporter->Format == CSF_FORMAT_JSON)
+        {
+            writebuffer_puts(Exporter->Buffer, "\n]\n");
+        }
+
+        writebuffer_close(Exporter->Buffer);
+    }
+
+    if(Exporter->Context.Error && !Context->Error)
+    {
+        *Context = Exporter->Context;
+    }
+
+    if(Exporter->Handle)
+    {
+        fclose_replace(Context, Exporter->Handle, Exporter->Path, Exporter->TempPath);
+    }
+
+    Exporter->Buffer = NULL;
+    Exporter->Handle = NULL;
+    Exporter->TempPath = NULL;
+
+    return Context->Error;
+}
@@ -0,0 +1,919 @@
+#include "csftools.h"
+
+CSFImporter *
+CSFImporter_Open(CSFContext *Context, char *Path)
+{
+    CSFImporter *Importer;
+    FILE *Handle;
+    char *Data;
+    size_t Capacity = STRREADER_WINDOW_SIZE;
+
+    // Reads a JSON, CSV or PO file as a whole, regular files are mapped, anything else (i.e. - for stdin) is read into memory
+    // Unlike a STR file, none of them can be parsed one Label at a time, a JSON file is one array and an entry of a PO file only ends where the next one starts
+    if(!(Importer = calloc_c(Context, 1, sizeof(CSFImporter))))
+    {
+        return NULL;
+    }
+
+    Importer->Context = Context;
+    Importer->Format = CSFFile_GetFormat(Path);
+
+    if(strcmp(Path, "-"))
+    {
+        Importer->Data = fmap(Path, &Importer->Size);
+    }
+
+    Importer->Mapped = Importer->Data != NULL;
+
+    if(Importer->Mapped)
+    {
+        return Importer;
+    }
+
+    // The buffer doubles whenever it's full, what's read through stdio is counted as it's read
+    if((Handle = fopen_c(Context, Path, "rb")))
+    {
+        while((Data = realloc_c(Context, Importer->Data, Capacity)))
+        {
+            Importer->Data = Data;
+            Importer->Size += fread(Importer->Data + Importer->Size, 1, Capacity - Importer->Size, Handle);
+
+            if(Importer->Size < Capacity)
+            {
+                break;
+            }
+
+            Capacity *= 2;
+        }
+
+        if(ferror(Handle))
+        {
+            csf_error(Context, CSF_ERROR_READ, "Couldn't read from ", Path, strlen(Path));
+        }
+
+        fclose_c(Handle);
+        csf_stats_add(Context, CSF_STAT_BYTES_READ, Importer->Size);
+    }
+
+    if(Context->Error)
+    {
+        CSFImporter_Close(Importer);
+        return NULL;
+    }
+
+    return Importer;
+}
+
+void
+CSFImporter_Close(CSFImporter *Importer)
+{
+    if(Importer == NULL)
+    {
+        return;
+    }
+
+    if(Importer->Mapped)
+    {
+        csf_stats_add(Importer->Context, CSF_STAT_BYTES_READ, Importer->Size);
+        funmap(Importer->Data, Importer->Size);
+    }
+    else
+    {
+        free(Importer->Data);
+    }
+
+    free(Importer);
+}
+
+static CSFHeader *
+CSFImporter_Error(CSFImporter *Importer, const char *Position, const char *Message, const char *Detail, size_t DetailLength)
+{
+    const char *Line;
+
+    // Keep the first error together with the line it's in, which is only counted now
+    if(Importer->Context->Error == CSF_OK)
+    {
+        csf_error(Importer->Context, CSF_ERROR_FORMAT, Message, Detail, DetailLength);
+
+        for(Importer->Context->ErrorLine = 1, Line = Importer->Data; (Line = memchr(Line, '\n', Position - Line)); Line++)
+        {
+            Importer->Context->ErrorLine++;
+        }
+    }
+
+    return NULL;
+}
+
+static CSFHeader *
+CSFImporter_AddLabel(CSFImporter *Importer, CSFHeader *CSFFile_Header, uint32_t *AllocSize, CSFArena *Arena, CSFIntern *Intern, CSFLabel *ImportLabel)
+{
+    CSFHeader *CSFFile_Header_Old;
+    CSFLabel *Label;
+    CSFString *String;
+
+    // Same as CSFFileHeader_Create, ImportLabel and its String point into the data of the importer and are copied into the arena
+    // Returns the CSFHeader, which moves whenever it has to grow, or NULL if there's no memory
+    if(!(Label = arena_alloc(Arena, sizeof(CSFLabel))))
+    {
+        return NULL;
+    }
+
+    *Label = *ImportLabel;
+
+    if(Intern)
+    {
+        if(!(String = CSFIntern_Add(Intern, ImportLabel->String, 0)))
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        if(!(String = arena_alloc(Arena, sizeof(CSFString))))
+        {
+            return NULL;
+        }
+
+        *String = *ImportLabel->String;
+    }
+
+    Label->String = String;
+
+    if(CSFFile_Header->NumLabels == *AllocSize)
+    {
+        *AllocSize *= 2;
+        csf_stats_add(Importer->Context, CSF_STAT_LABEL_GROWTHS, 1);
+        CSFFile_Header_Old = CSFFile_Header;
+
+        if(!(CSFFile_Header = arena_alloc(Arena, sizeof(CSFHeader) + (*AllocSize * sizeof(CSFLabel *)))))
+        {
+            return NULL;
+        }
+
+        memcpy(CSFFile_Header, CSFFile_Header_Old, sizeof(CSFHeader) + (CSFFile_Header_Old->NumLabels * sizeof(CSFLabel *)));
+    }
+
+    CSFFile_Header->Label[CSFFile_Header->NumLabels] = Label;
+
+    CSFFile_Header->NumLabels++;
+    CSFFile_Header->NumStrings++;
+
+    return CSFFile_Header;
+}
+
+static void
+CSFImporter_SetExtraValue(CSFString *String, char *ExtraValue, size_t ExtraValueLength)
+{
+    // Written by CSFExporter_WriteExtraValue, a single backslash is an empty ExtraValue, same as in a STR file
+    String->MagicHeader = STRW_MAGIC;
+    String->ExtraValue = (uint8_t *)ExtraValue;
+    String->ExtraValueLength = ExtraValueLength == 1 && ExtraValue[0] == '\\' ? 0 : (uint32_t)STRFile_UnescapeExtraValue(ExtraValue, ExtraValueLength);
+}
+
+static char *
+JSONFile_SkipSpace(char *Data, char *End)
+{
+    for(; Data < End && (*Data == ' ' || *Data == '\t' || *Data == '\r' || *Data == '\n'); Data++);
+
+    return Data;
+}
+
+static int
+JSONFile_HexValue(const char *Data, char *End)
+{
+    int Value = 0;
+    int i, c;
+
+    // Four hex digits of a \u escape, or -1
+    for(i = 0; i < 4; i++)
+    {
+        if(Data + i >= End)
+        {
+            return -1;
+        }
+
+        c = tolower((unsigned char)Data[i]);
+
+        if(c >= '0' && c <= '9')
+        {
+            Value = Value << 4 | (c - '0');
+        }
+        else if(c >= 'a' && c <= 'f')
+        {
+            Value = Value << 4 | (c - 'a' + 10);
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return Value;
+}
+
+static char *
+JSONFile_ReadString(char *Data, char *End, char **Value, uint32_t *ValueLength)
+{
+    char *Dst;
+    int Char, Low;
+
+    // Data is at the opening quote, the string is unescaped in place and Data returned right after the closing quote, or NULL if it's malformed
+    // \u escapes become UTF-8, a surrogate pair one 4 byte char and a lone surrogate a 3 byte char of its own, same as when decoding a CSF file
+    *Value = Dst = ++Data;
+
+    while(Data < End && *Data != '"')
+    {
+        if(*Data != '\\')
+        {
+            *Dst++ = *Data++;
+            continue;
+        }
+
+        if(++Data == End)
+        {
+            return NULL;
+        }
+
+        switch(*Data++)
+        {
+        case '"':
+            *Dst++ = '"';
+            break;
+        case '\\':
+            *Dst++ = '\\';
+            break;
+        case '/':
+            *Dst++ = '/';
+            break;
+        case 'b':
+            *Dst++ = '\b';
+            break;
+        case 'f':
+            *Dst++ = '\f';
+            break;
+        case 'n':
+            *Dst++ = '\n';
+            break;
+        case 'r':
+            *Dst++ = '\r';
+            break;
+        case 't':
+            *Dst++ = '\t';
+            break;
+        case 'u':
+            if((Char = JSONFile_HexValue(Data, End)) < 0)
+            {
+                return NULL;
+            }
+
+            Data += 4;
+
+            if(Char >= 0xD800 && Char < 0xDC00 && End - Data >= 6 && Data[0] == '\\' && Data[1] == 'u'
+                && (Low = JSONFile_HexValue(Data + 2, End)) >= 0xDC00 && Low < 0xE000)
+            {
+                Char = 0x10000 + ((Char - 0xD800) << 10) + (Low - 0xDC00);
+                Data += 6;
+            }
+
+            if(Char < 0x80)
+            {
+                *Dst++ = (char)Char;
+            }
+            else if(Char < 0x800)
+            {
+                *Dst++ = (char)(0xC0 | Char >> 6);
+                *Dst++ = (char)(0x80 | (Char & 0x3F));
+            }
+            else if(Char < 0x10000)
+            {
+                *Dst++ = (char)(0xE0 | Char >> 12);
+                *Dst++ = (char)(0x80 | (Char >> 6 & 0x3F));
+                *Dst++ = (char)(0x80 | (Char & 0x3F));
+            }
+            else
+            {
+                *Dst++ = (char)(0xF0 | Char >> 18);
+                *Dst++ = (char)(0x80 | (Char >> 12 & 0x3F));
+                *Dst++ = (char)(0x80 | (Char >> 6 & 0x3F));
+                *Dst++ = (char)(0x80 | (Char & 0x3F));
+            }
+            break;
+        default:
+            return NULL;
+        }
+    }
+
+    if(Data == End)
+    {
+        return NULL;
+    }
+
+    *ValueLength = (uint32_t)(Dst - *Value);
+
+    return Data + 1;
+}
+
+static char *
+JSONFile_SkipValue(char *Data, char *End)
+{
+    char *Value;
+    uint32_t ValueLength;
+    int Depth = 0;
+
+    // Skips any JSON value of a member that isn't known, including nested arrays and objects, returns NULL if it's malformed
+    // Nested values aren't checked any further than that their brackets and strings end
+    do
+    {
+        Data = JSONFile_SkipSpace(Data, End);
+
+        if(Data == End)
+        {
+            return NULL;
+        }
+
+        if(*Data == '"')
+        {
+            if(!(Data = JSONFile_ReadString(Data, End, &Value, &ValueLength)))
+            {
+                return NULL;
+            }
+        }
+        else if(*Data == '[' || *Data == '{')
+        {
+            Depth++;
+            Data++;
+        }
+        else if(*Data == ']' || *Data == '}')
+        {
+            if(!Depth--)
+            {
+                return NULL;
+            }
+
+            Data++;
+        }
+        else if(Depth && (*Data == ',' || *Data == ':'))
+        {
+            Data++;
+        }
+        else
+        {
+            // Numbers, true, false and null
+            for(Value = Data; Data < End && (isalnum((unsigned char)*Data) || *Data == '-' || *Data == '+' || *Data == '.'); Data++);
+
+            if(Data == Value)
+            {
+                return NULL;
+            }
+        }
+    }
+    while(Depth);
+
+    return Data;
+}
+
+static CSFHeader *
+JSONFile_Import(CSFImporter *Importer, CSFHeader *CSFFile_Header, uint32_t *AllocSize, CSFArena *Arena, CSFIntern *Intern)
+{
+    CSFLabel Label;
+    CSFString String;
+    char *Data = Importer->Data;
+    char *End = Importer->Data + Importer->Size;
+    char *Key, *Member;
+    uint32_t KeyLength, MemberLength;
+    int HasName;
+
+    // An array of objects, one per Label, with its LabelName as label, its value as value and the ExtraValue of a STRW String as extra
+    // Other members are skipped, a missing value is an empty one
+    Data = JSONFile_SkipSpace(Data, End);
+
+    if(Data == End || *Data != '[')
+    {
+        return CSFImporter_Error(Importer, Data, "Expected an array of labels in JSON file", "", 0);
+    }
+
+    Data = JSONFile_SkipSpace(Data + 1, End);
+
+    while(Data < End && *Data != ']')
+    {
+        if(*Data != '{')
+        {
+            return CSFImporter_Error(Importer, Data, "Expected an object for a label in JSON file", "", 0);
+        }
+
+        memset(&Label, 0, sizeof(CSFLabel));
+        memset(&String, 0, sizeof(CSFString));
+
+        Label.MagicHeader = LBL_MAGIC;
+        Label.NumStringPairs = 1;
+        Label.String = &String;
+        String.MagicHeader = STR_MAGIC;
+        String.Value = "";
+        HasName = 0;
+
+        Data = JSONFile_SkipSpace(Data + 1, End);
+
+        while(Data < End && *Data != '}')
+        {
+            if(*Data != '"' || !(Data = JSONFile_ReadString(Data, End, &Key, &KeyLength)))
+            {
+                return CSFImporter_Error(Importer, Data ? Data : End, "Expected a member name in JSON file", "", 0);
+            }
+
+            Data = JSONFile_SkipSpace(Data, End);
+
+            if(Data == End || *Data != ':')
+            {
+                return CSFImporter_Error(Importer, Data, "Expected : after a member name in JSON file", "", 0);
+            }
+
+            Data = JSONFile_SkipSpace(Data + 1, End);
+
+            if((KeyLength == 5 && !memcmp(Key, "label", 5)) || (KeyLength == 5 && !memcmp(Key, "value", 5)) || (KeyLength == 5 && !memcmp(Key, "extra", 5)))
+            {
+                if(Data == End || *Data != '"' || !(Data = JSONFile_ReadString(Data, End, &Member, &MemberLength)))
+                {
+                    return CSFImporter_Error(Importer, Data ? Data : End, "Expected a string for member ", Key, KeyLength);
+                }
+
+                if(Key[0] == 'l')
+                {
+                    Label.LabelName = Member;
+                    Label.LabelNameLength = MemberLength;
+                    HasName = 1;
+                }
+                else if(Key[0] == 'v')
+                {
+                    String.Value = Member;
+                    String.ValueLength = MemberLength;
+                }
+                else
+                {
+                    CSFImporter_SetExtraValue(&String, Member, MemberLength);
+                }
+            }
+            else if(!(Data = JSONFile_SkipValue(Data, End)))
+            {
+                return CSFImporter_Error(Importer, End, "Malformed value of member ", Key, KeyLength);
+            }
+
+            Data = JSONFile_SkipSpace(Data, End);
+
+            if(Data < End && *Data == ',')
+            {
+                Data = JSONFile_SkipSpace(Data + 1, End);
+            }
+            else if(Data == End || *Data != '}')
+            {
+                return CSFImporter_Error(Importer, Data, "Expected , or } after a member in JSON file", "", 0);
+            }
+        }
+
+        if(Data == End)
+        {
+            break;
+        }
+
+        if(!HasName)
+        {
+            return CSFImporter_Error(Importer, Data, "Label without a label member in JSON file", "", 0);
+        }
+
+        if(!(CSFFile_Header = CSFImporter_AddLabel(Importer, CSFFile_Header, AllocSize, Arena, Intern, &Label)))
+        {
+            return NULL;
+        }
+
+        Data = JSONFile_SkipSpace(Data + 1, End);
+
+        if(Data < End && *Data == ',')
+        {
+            Data = JSONFile_SkipSpace(Data + 1, End);
+        }
+        else if(Data == End || *Data != ']')
+        {
+            return CSFImporter_Error(Importer, Data, "Expected , or ] after a label in JSON file", "", 0);
+        }
+    }
+
+    if(Data == End || JSONFile_SkipSpace(Data + 1, End) != End)
+    {
+        return CSFImporter_Error(Importer, Data, Data == End ? "Unexpected end of JSON file" : "Unexpected data after the array of labels in JSON file", "", 0);
+    }
+
+    return CSFFile_Header;
+}
+
+static char *
+CSVFile_ReadField(char *Data, char *End, char **Field, uint32_t *FieldLength)
+{
+    char *Dst;
+
+    // A quoted field is unescaped in place, two quotes are one, anything else goes up to the next comma or the end of the line
+    // Returns where the field ends, or NULL if a quoted field isn't closed or something follows its closing quote
+    if(Data < End && *Data == '"')
+    {
+        *Field = Dst = ++Data;
+
+        for(;;)
+        {
+            if(Data == End)
+            {
+                return NULL;
+            }
+
+            if(*Data == '"' && (Data + 1 == End || Data[1] != '"'))
+            {
+                break;
+            }
+
+            Data += *Data == '"' ? 1 : 0;
+            *Dst++ = *Data++;
+        }
+
+        *FieldLength = (uint32_t)(Dst - *Field);
+        Data++;
+
+        return Data == End || *Data == ',' || *Data == '\r' || *Data == '\n' ? Data : NULL;
+    }
+
+    for(*Field = Data; Data < End && *Data != ',' && *Data != '\r' && *Data != '\n'; Data++);
+
+    *FieldLength = (uint32_t)(Data - *Field);
+
+    return Data;
+}
+
+static CSFHeader *
+CSVFile_Import(CSFImporter *Importer, CSFHeader *CSFFile_Header, uint32_t *AllocSize, CSFArena *Arena, CSFIntern *Intern)
+{
+    CSFLabel Label;
+    CSFString String;
+    char *Data = Importer->Data;
+    char *End = Importer->Data + Importer->Size;
+    char *Record, *Field[3];
+    uint32_t FieldLength[3];
+    int NumFields, First = 1;
+
+    // One record per Label, LabelName, value and the ExtraValue of a STRW String, which is empty for a STR String
+    // A first record whose first field is label is the header, empty lines are skipped, and spreadsheets like to start the file with a byte order mark
+    if(Importer->Size >= 3 && !memcmp(Data, "\xEF\xBB\xBF", 3))
+    {
+        Data += 3;
+    }
+
+    while(Data < End)
+    {
+        Record = Data;
+
+        for(NumFields = 0; ; )
+        {
+            if(NumFields == 3)
+            {
+                return CSFImporter_Error(Importer, Record, "Too many fields in CSV record, expected a label, a value and an extra value", "", 0);
+            }
+
+            if(!(Data = CSVFile_ReadField(Data, End, &Field[NumFields], &FieldLength[NumFields])))
+            {
+                return CSFImporter_Error(Importer, Record, "Malformed quoted field in CSV record", "", 0);
+            }
+
+            NumFields++;
+
+            if(Data == End || *Data != ',')
+            {
+                break;
+            }
+
+            Data++;
+        }
+
+        // Records end with CRLF or LF
+        Data += Data < End && *Data == '\r' ? 1 : 0;
+        Data += Data < End && *Data == '\n' ? 1 : 0;
+
+        if(NumFields == 1 && !FieldLength[0] && *Record != '"')
+        {
+            continue;
+        }
+
+        if(First && FieldLength[0] == 5 && !memcmp(Field[0], "label", 5))
+        {
+            First = 0;
+            continue;
+        }
+
+        First = 0;
+
+        if(NumFields < 2)
+        {
+            return CSFImporter_Error(Importer, Record, "Expected a label and a value in CSV record ", Field[0], FieldLength[0]);
+        }
+
+        memset(&String, 0, sizeof(CSFString));
+
+        Label.MagicHeader = LBL_MAGIC;
+        Label.NumStringPairs = 1;
+        Label.LabelName = Field[0];
+        Label.LabelNameLength = FieldLength[0];
+        Label.String = &String;
+        String.MagicHeader = STR_MAGIC;
+        String.Value = Field[1];
+        String.ValueLength = FieldLength[1];
+
+        if(NumFields == 3 && FieldLength[2])
+        {
+            CSFImporter_SetExtraValue(&String, Field[2], FieldLength[2]);
+        }
+
+        if(!(CSFFile_Header = CSFImporter_AddLabel(Importer, CSFFile_Header, AllocSize, Arena, Intern, &Label)))
+        {
+            return NULL;
+        }
+    }
+
+    return CSFFile_Header;
+}
+
+static char *
+POFile_ReadString(char *Data, char *End, char **Dst)
+{
+    int Char, i;
+
+    // Data is at the opening quote of a string, its unescaped contents are appended at *Dst, which is never after Data
+    // That's how the strings of several lines become one value, returns right after the closing quote, or NULL if there's none
+    for(Data++; Data < End && *Data != '"' && *Data != '\n'; )
+    {
+        if(*Data != '\\' || Data + 1 == End)
+        {
+            *(*Dst)++ = *Data++;
+            continue;
+        }
+
+        Data++;
+
+        switch(*Data)
+        {
+        case 'n':
+            *(*Dst)++ = '\n';
+            break;
+        case 't':
+            *(*Dst)++ = '\t';
+            break;
+        case 'r':
+            *(*Dst)++ = '\r';
+            break;
+        case 'a':
+            *(*Dst)++ = '\a';
+            break;
+        case 'b':
+            *(*Dst)++ = '\b';
+            break;
+        case 'f':
+            *(*Dst)++ = '\f';
+            break;
+        case 'v':
+            *(*Dst)++ = '\v';
+            break;
+        case 'x':
+            for(Char = 0, i = 1; Data + i < End && isxdigit((unsigned char)Data[i]) && i < 3; i++)
+            {
+                Char = Char << 4 | (isdigit((unsigned char)Data[i]) ? Data[i] - '0' : tolower((unsigned char)Data[i]) - 'a' + 10);
+            }
+
+            if(i == 1)
+            {
+                *(*Dst)++ = '\\';
+                *(*Dst)++ = 'x';
+                break;
+            }
+
+            *(*Dst)++ = (char)Char;
+            Data += i - 1;
+            break;
+        default:
+            if(*Data >= '0' && *Data <= '7')
+            {
+                for(Char = 0, i = 0; Data + i < End && Data[i] >= '0' && Data[i] <= '7' && i < 3; i++)
+                {
+                    Char = Char << 3 | (Data[i] - '0');
+                }
+
+                *(*Dst)++ = (char)Char;
+                Data += i - 1;
+            }
+            else
+            {
+                // \" and \\ are the char itself, so is anything else that's escaped
+                *(*Dst)++ = *Data;
+            }
+            break;
+        }
+
+        Data++;
+    }
+
+    return Data < End && *Data == '"' ? Data + 1 : NULL;
+}
+
+static CSFHeader *
+POFile_AddEntry(CSFImporter *Importer, CSFHeader *CSFFile_Header, uint32_t *AllocSize, CSFArena *Arena, CSFIntern *Intern, char **Keyword, uint32_t *KeywordLength, int Fuzzy, char *Entry, CSFLabel *Label)
+{
+    // Keyword 0 is msgctxt, 1 msgid and 2 msgstr, the translation is used unless it's empty or fuzzy, then it's the source text
+    // The header entry is the one without a context and with an empty msgid, it's skipped
+    if(!Keyword[0])
+    {
+        if(Keyword[1] && !KeywordLength[1])
+        {
+            return CSFFile_Header;
+        }
+
+        return CSFImporter_Error(Importer, Entry, "Entry without msgctxt in PO file, the label name is missing", "", 0);
+    }
+
+    if(!Keyword[1] || !Keyword[2])
+    {
+        return CSFImporter_Error(Importer, Entry, "Entry without msgid or msgstr in PO file for label ", Keyword[0], KeywordLength[0]);
+    }
+
+    Label->LabelName = Keyword[0];
+    Label->LabelNameLength = KeywordLength[0];
+    Label->String->Value = KeywordLength[2] && !Fuzzy ? Keyword[2] : Keyword[1];
+    Label->String->ValueLength = KeywordLength[2] && !Fuzzy ? KeywordLength[2] : KeywordLength[1];
+
+    return CSFImporter_AddLabel(Importer, CSFFile_Header, AllocSize, Arena, Intern, Label);
+}
+
+static CSFHeader *
+POFile_Import(CSFImporter *Importer, CSFHeader *CSFFile_Header, uint32_t *AllocSize, CSFArena *Arena, CSFIntern *Intern)
+{
+    const char *Keywords[3] = { "msgctxt", "msgid", "msgstr" };
+    CSFLabel Label;
+    CSFString String;
+    char *Data = Importer->Data;
+    char *End = Importer->Data + Importer->Size;
+    char *Line, *LineEnd, *Entry = NULL;
+    char *Keyword[3] = { NULL, NULL, NULL };
+    char *Dst = NULL;
+    uint32_t KeywordLength[3];
+    size_t Length;
+    int Current = -1;
+    int Fuzzy = 0;
+    int i;
+
+    // Entries of msgctxt, msgid and msgstr, each followed by a string, more strings on the lines after it are appended to it
+    // An entry ends where the next one starts, comments in front of an entry belong to that entry, #. extra: is the ExtraValue of a STRW String and #, fuzzy marks a translation that's not done yet
+    // Plural forms aren't supported, a CSF file has none
+    memset(&String, 0, sizeof(CSFString));
+    String.MagicHeader = STR_MAGIC;
+
+    Label.MagicHeader = LBL_MAGIC;
+    Label.NumStringPairs = 1;
+    Label.String = &String;
+
+    while(Data < End)
+    {
+        Line = Data;
+
+        for(LineEnd = Line; LineEnd < End && *LineEnd != '\n'; LineEnd++);
+
+        Data = LineEnd < End ? LineEnd + 1 : End;
+        LineEnd -= LineEnd > Line && LineEnd[-1] == '\r' ? 1 : 0;
+
+        for(; Line < LineEnd && (*Line == ' ' || *Line == '\t'); Line++);
+
+        if(Line == LineEnd)
+        {
+            continue;
+        }
+
+        // A string on a line of its own continues the last one
+        if(*Line == '"')
+        {
+            if(Current < 0)
+            {
+                return CSFImporter_Error(Importer, Line, "String without msgctxt, msgid or msgstr in PO file", "", 0);
+            }
+
+            if(!POFile_ReadString(Line, LineEnd, &Dst))
+            {
+                return CSFImporter_Error(Importer, Line, "Unterminated string in PO file", "", 0);
+            }
+
+            KeywordLength[Current] = (uint32_t)(Dst - Keyword[Current]);
+            continue;
+        }
+
+        // Whatever comes after a msgstr starts the next entry
+        if(Keyword[2] && (*Line == '#' || !strncmp(Line, "msgctxt", 7) || !strncmp(Line, "msgid", 5)))
+        {
+            if(!(CSFFile_Header = POFile_AddEntry(Importer, CSFFile_Header, AllocSize, Arena, Intern, Keyword, KeywordLength, Fuzzy, Entry, &Label)))
+            {
+                return NULL;
+            }
+
+            memset(&String, 0, sizeof(CSFString));
+            String.MagicHeader = STR_MAGIC;
+
+            Keyword[0] = Keyword[1] = Keyword[2] = NULL;
+            Entry = NULL;
+            Current = -1;
+            Fuzzy = 0;
+        }
+
+        Entry = Entry ? Entry : Line;
+
+        if(*Line == '#')
+        {
+            Length = LineEnd - Line;
+
+            if(Length >= 10 && !memcmp(Line, "#. extra: ", 10))
+            {
+                CSFImporter_SetExtraValue(&String, Line + 10, Length - 10);
+            }
+            else if(Length >= 2 && Line[1] == ',' && csf_memmem(Line, Length, "fuzzy", 5, 0))
+            {
+                Fuzzy = 1;
+            }
+
+            continue;
+        }
+
+        for(i = 0; i < 3; i++)
+        {
+            Length = strlen(Keywords[i]);
+
+            if((size_t)(LineEnd - Line) > Length && !memcmp(Line, Keywords[i], Length) && (Line[Length] == ' ' || Line[Length] == '\t'))
+            {
+                break;
+            }
+        }
+
+        if(i == 3)
+        {
+            return CSFImporter_Error(Importer, Line, !strncmp(Line, "msgid_plural", 12) || !strncmp(Line, "msgstr[", 7) ? "Plural forms aren't supported in PO file" : "Expected msgctxt, msgid, msgstr or a comment in PO file", "", 0);
+        }
+
+        if(Keyword[i])
+        {
+            return CSFImporter_Error(Importer, Line, "Entry has more than one ", Keywords[i], strlen(Keywords[i]));
+        }
+
+        for(Line += Length; Line < LineEnd && (*Line == ' ' || *Line == '\t'); Line++);
+
+        Keyword[i] = Dst = Line + 1;
+        Current = i;
+
+        if(Line == LineEnd || *Line != '"' || !POFile_ReadString(Line, LineEnd, &Dst))
+        {
+            return CSFImporter_Error(Importer, Line, "Expected a string after ", Keywords[i], strlen(Keywords[i]));
+        }
+
+        KeywordLength[i] = (uint32_t)(Dst - Keyword[i]);
+    }
+
+    if(Keyword[0] || Keyword[1] || Keyword[2])
+    {
+        CSFFile_Header = POFile_AddEntry(Importer, CSFFile_Header, AllocSize, Arena, Intern, Keyword, KeywordLength, Fuzzy, Entry, &Label);
+    }
+
+    return CSFFile_Header;
+}
+
+CSFHeader *
+CSFFileHeader_Import(CSFImporter *Importer, uint32_t LanguageId, CSFArena *Arena, CSFIntern *Intern)
+{
+    CSFHeader *CSFFile_Header;
+    uint32_t AllocSize;
+
+    // Same as CSFFileHeader_Create, but for the JSON, CSV or PO file of Importer, LanguageId is the one of the CSF file, whatever the file says is ignored
+    // LabelNames and values point into the data of the importer, so it has to stay open as long as they're used
+    // Returns NULL on an error, whatever was allocated until then is released with the arena
+    AllocSize = (uint32_t)(Importer->Size / 32 + 1);
+
+    if(!(CSFFile_Header = arena_alloc(Arena, sizeof(CSFHeader) + (AllocSize * sizeof(CSFLabel *)))))
+    {
+        return NULL;
+    }
+
+    CSFFileHeader_Init(CSFFile_Header, LanguageId);
+
+    if(Importer->Format == CSF_FORMAT_JSON)
+    {
+        CSFFile_Header = JSONFile_Import(Importer, CSFFile_Header, &AllocSize, Arena, Intern);
+    }
+    else if(Importer->Format == CSF_FORMAT_CSV)
+    {
+        CSFFile_Header = CSVFile_Import(Importer, CSFFile_Header, &AllocSize, Arena, Intern);
+    }
+    else if(Importer->Format == CSF_FORMAT_PO)
+    {
+        CSFFile_Header = POFile_Import(Importer, CSFFile_Header, &AllocSize, Arena, Intern);
+    }
+    else
+    {
+        csf_error(Importer->Context, CSF_ERROR_FORMAT, "Only JSON, CSV and PO files can be imported", "", 0);
+    }
+
+    return Importer->Context->Error ? NULL : CSFFile_Header;
+}
@@ -0,0 +1,398 @@
+#include "csftools.h"
+
+uint64_t
+CSFIndex_Mix(uint64_t Hash)
+{
+    // Finalizer from splitmix64, so every bit of the hash depends on every bit of the input
+    Hash ^= Hash >> 30;
+    Hash *= 0xBF58476D1CE4E5B9ULL;
+    Hash ^= Hash >> 27;
+    Hash *= 0x94D049BB133111EBULL;
+    Hash ^= Hash >> 31;
+
+    return Hash;
+}
+
+uint64_t
+CSFIndex_Hash(const char *LabelName, size_t LabelNameLength)
+{
+    uint64_t Hash = 0xCBF29CE484222325ULL;
+    size_t i;
+
+    // FNV-1a over the lowercased LabelName, the game doesn't care about the case of Labels so neither does the index
+    for(i = 0; i < LabelNameLength; i++)
+    {
+        Hash ^= (uint8_t)tolower((unsigned char)LabelName[i]);
+        Hash *= 0x100000001B3ULL;
+    }
+
+    return CSFIndex_Mix(Hash);
+}
+
+static int
+CSFIndex_EqualName(const char *Name, size_t NameLength, const char *LabelName, size_t LabelNameLength)
+{
+    size_t i;
+
+    if(NameLength != LabelNameLength)
+    {
+        return 0;
+    }
+
+    for(i = 0; i < LabelNameLength; i++)
+    {
+        if(tolower((unsigned char)Name[i]) != tolower((unsigned char)LabelName[i]))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int
+CSFIndex_Equal(CSFLabel *Label, const char *LabelName, size_t LabelNameLength)
+{
+    return CSFIndex_EqualName(Label->LabelName, Label->LabelNameLength, LabelName, LabelNameLength);
+}
+
+static int
+CSFIndex_EqualAt(CSFIndex *Index, uint32_t i, const char *LabelName, size_t LabelNameLength)
+{
+    // Label i of whatever the index was built over
+    if(Index->Table)
+    {
+        return CSFIndex_EqualName((char *)Index->Table->Blob + Index->Table->NameOffset[i], Index->Table->NameLength[i], LabelName, LabelNameLength);
+    }
+
+    return CSFIndex_Equal(Index->CSFFile_Header->Label[i], LabelName, LabelNameLength);
+}
+
+static uint32_t
+CSFIndex_PerfectSlot(uint64_t Hash, uint32_t Seed, uint32_t NumSlots)
+{
+    return (uint32_t)(CSFIndex_Mix(Hash + Seed * 0x9E3779B97F4A7C15ULL) % NumSlots);
+}
+
+static void *
+CSFIndex_Alloc(CSFContext *Context, size_t nitems, size_t size)
+{
+    // Same as calloc_c, but running out of memory isn't an error, the perfect hash falls back to the hash table then
+    csf_stats_add(Context, CSF_STAT_ALLOCATIONS, 1);
+    csf_stats_add(Context, CSF_STAT_ALLOCATED_BYTES, nitems * size);
+
+    return calloc(nitems, size);
+}
+
+static int
+CSFIndex_CreatePerfect(CSFContext *Context, CSFIndex *Index, uint32_t *Keys, uint64_t *Hashes, uint32_t NumKeys)
+{
+    uint32_t *BucketStart, *BucketOrder, *SizeStart, *Keys_Sorted;
+    uint8_t *Taken;
+    uint32_t NumBuckets, MaxBucketSize = 0;
+    uint32_t Bucket, BucketSize, Seed, Slot;
+    uint32_t i, j, k;
+
+    // Build a minimal perfect hash in the style of CHD: keys are hashed into buckets of about 4 keys each
+    // Buckets are placed largest first, each one gets the first seed that moves all of its keys into free slots
+    // Afterwards every key has a slot of its own, so a lookup is one hash, one seed and one compare, and the index needs a seed per bucket and a slot per key
+    // Returns 0 if it didn't work out (which is extremely unlikely) or memory ran out, the caller falls back to a normal hash table then
+    // That's why everything here comes from CSFIndex_Alloc, which counts its memory for the stats like calloc_c but doesn't leave an error in Context
+    NumBuckets = NumKeys / 4 + 1;
+
+    BucketStart = CSFIndex_Alloc(Context, NumBuckets + 1, sizeof(uint32_t));
+    BucketOrder = CSFIndex_Alloc(Context, NumBuckets, sizeof(uint32_t));
+    SizeStart = CSFIndex_Alloc(Context, NumKeys + 2, sizeof(uint32_t));
+    Keys_Sorted = CSFIndex_Alloc(Context, NumKeys, sizeof(uint32_t));
+    Taken = CSFIndex_Alloc(Context, NumKeys, 1);
+    Index->Seed = CSFIndex_Alloc(Context, NumBuckets, sizeof(uint32_t));
+    Index->Slot = CSFIndex_Alloc(Context, NumKeys, sizeof(uint32_t));
+
+    if(!BucketStart || !BucketOrder || !SizeStart || !Keys_Sorted || !Taken || !Index->Seed || !Index->Slot)
+    {
+        goto fail;
+    }
+
+    // Sort keys by bucket, counting sort since the bucket is all that matters
+    for(i = 0; i < NumKeys; i++)
+    {
+        BucketStart[(Hashes[i] >> 32) % NumBuckets + 1]++;
+    }
+
+    for(i = 0; i < NumBuckets; i++)
+    {
+        if(BucketStart[i + 1] > MaxBucketSize)
+        {
+            MaxBucketSize = BucketStart[i + 1];
+        }
+
+        BucketStart[i + 1] += BucketStart[i];
+    }
+
+    for(i = 0; i < NumKeys; i++)
+    {
+        Bucket = (Hashes[i] >> 32) % NumBuckets;
+        Keys_Sorted[BucketStart[Bucket]++] = i;
+    }
+
+    // That moved every BucketStart to the end of its bucket, which is the start of the next one
+    memmove(BucketStart + 1, BucketStart, NumBuckets * sizeof(uint32_t));
+    BucketStart[0] = 0;
+
+    // Sort buckets by size, largest first, counting sort again
+    for(i = 0; i < NumBuckets; i++)
+    {
+        SizeStart[MaxBucketSize - (BucketStart[i + 1] - BucketStart[i]) + 1]++;
+    }
+
+    for(i = 0; i < MaxBucketSize; i++)
+    {
+        SizeStart[i + 1] += SizeStart[i];
+    }
+
+    for(i = 0; i < NumBuckets; i++)
+    {
+        BucketOrder[SizeStart[MaxBucketSize - (BucketStart[i + 1] - BucketStart[i])]++] = i;
+    }
+
+    for(i = 0; i < NumBuckets; i++)
+    {
+        Bucket = BucketOrder[i];
+        BucketSize = BucketStart[Bucket + 1] - BucketStart[Bucket];
+
+        // Buckets are sorted, so everything after the first empty one is empty as well
+        if(!BucketSize)
+        {
+            break;
+        }
+
+        for(Seed = 0; Seed < 0x1000000; Seed++)
+        {
+            for(j = 0; j < BucketSize; j++)
+            {
+                Slot = CSFIndex_PerfectSlot(Hashes[Keys_Sorted[BucketStart[Bucket] + j]], Seed, NumKeys);
+
+                if(Taken[Slot])
+                {
+                    break;
+                }
+
+                Taken[Slot] = 1;
+            }
+
+            if(j == BucketSize)
+            {
+                break;
+            }
+
+            // Some keys of this bucket collided, give back the slots they took already
+            for(k = 0; k < j; k++)
+            {
+                Taken[CSFIndex_PerfectSlot(Hashes[Keys_Sorted[BucketStart[Bucket] + k]], Seed, NumKeys)] = 0;
+            }
+        }
+
+        if(Seed == 0x1000000)
+        {
+            goto fail;
+        }
+
+        Index->Seed[Bucket] = Seed;
+
+        for(j = 0; j < BucketSize; j++)
+        {
+            k = Keys_Sorted[BucketStart[Bucket] + j];
+            Index->Slot[CSFIndex_PerfectSlot(Hashes[k], Seed, NumKeys)] = Keys[k] + 1;
+        }
+    }
+
+    free(BucketStart);
+    free(BucketOrder);
+    free(SizeStart);
+    free(Keys_Sorted);
+    free(Taken);
+
+    Index->NumBuckets = NumBuckets;
+    Index->NumSlots = NumKeys;
+
+    return 1;
+
+fail:
+    free(BucketStart);
+    free(BucketOrder);
+    free(SizeStart);
+    free(Keys_Sorted);
+    free(Taken);
+    free(Index->Seed);
+    free(Index->Slot);
+
+    Index->Seed = NULL;
+    Index->Slot = NULL;
+
+    return 0;
+}
+
+static CSFIndex *
+CSFIndex_Build(CSFContext *Context, CSFHeader *CSFFile_Header, CSFTable *Table, int Perfect)
+{
+    CSFIndex *Index;
+    uint32_t *Slots;
+    uint32_t *Keys = NULL;
+    uint64_t *Hashes = NULL;
+    char *LabelName;
+    uint32_t LabelNameLength;
+    uint32_t NumLabels, NumSlots, NumKeys = 0;
+    uint64_t Hash;
+    uint32_t i, Slot;
+
+    // The hash table is always built first, it takes care of the duplicates for the perfect hash
+    // If several Labels only differ in case, the first one wins, same as in the game
+    if(!(Index = calloc_c(Context, 1, sizeof(CSFIndex))))
+    {
+        return NULL;
+    }
+
+    Index->CSFFile_Header = CSFFile_Header;
+    Index->Table = Table;
+
+    NumLabels = Table ? Table->Header.NumLabels : CSFFile_Header->NumLabels;
+
+    for(NumSlots = 2; NumSlots < NumLabels * (uint64_t)2; NumSlots *= 2);
+
+    if(!(Slots = calloc_c(Context, NumSlots, sizeof(uint32_t))))
+    {
+        free(Index);
+        return NULL;
+    }
+
+    // Without memory for the keys and hashes the perfect hash isn't built, the hash table works just as well
+    if(Perfect)
+    {
+        Keys = CSFIndex_Alloc(Context, NumLabels, sizeof(uint32_t));
+        Hashes = CSFIndex_Alloc(Context, NumLabels, sizeof(uint64_t));
+    }
+
+    for(i = 0; i < NumLabels; i++)
+    {
+        // A table has its LabelNames one after another in its Blob, so this reads it from start to end
+        if(Table)
+        {
+            LabelName = (char *)Table->Blob + Table->NameOffset[i];
+            LabelNameLength = Table->NameLength[i];
+        }
+        else
+        {
+            LabelName = CSFFile_Header->Label[i]->LabelName;
+            LabelNameLength = CSFFile_Header->Label[i]->LabelNameLength;
+        }
+
+        Hash = CSFIndex_Hash(LabelName, LabelNameLength);
+
+        for(Slot = Hash & (NumSlots - 1); Slots[Slot]; Slot = (Slot + 1) & (NumSlots - 1))
+        {
+            if(CSFIndex_EqualAt(Index, Slots[Slot] - 1, LabelName, LabelNameLength))
+            {
+                break;
+            }
+        }
+
+        if(!Slots[Slot])
+        {
+            Slots[Slot] = i + 1;
+
+            if(Keys && Hashes)
+            {
+                Keys[NumKeys] = i;
+                Hashes[NumKeys] = Hash;
+                NumKeys++;
+            }
+        }
+    }
+
+    if(Keys && Hashes && NumKeys && CSFIndex_CreatePerfect(Context, Index, Keys, Hashes, NumKeys))
+    {
+        free(Slots);
+    }
+    else
+    {
+        Index->Slot = Slots;
+        Index->NumSlots = NumSlots;
+    }
+
+    free(Keys);
+    free(Hashes);
+
+    return Index;
+}
+
+CSFIndex *
+CSFIndex_Create(CSFContext *Context, CSFHeader *CSFFile_Header, int Perfect)
+{
+    // Build a lookup index over all Labels of CSFFile_Header, which has to stay around as long as the index is used
+    // The default is an open addressing hash table that's at most half full, 8 bytes or less per Label
+    // With Perfect, a minimal perfect hash is built instead, which takes longer to build but only needs about 5 bytes per Label, meant for files that don't change anymore
+    return CSFIndex_Build(Context, CSFFile_Header, NULL, Perfect);
+}
+
+CSFIndex *
+CSFIndex_CreateFromTable(CSFContext *Context, CSFTable *Table, int Perfect)
+{
+    // Same as CSFIndex_Create, but over the Labels of a CSFTable, which must not get any more Labels while the index is used
+    return CSFIndex_Build(Context, NULL, Table, Perfect);
+}
+
+uint32_t
+CSFIndex_FindIndex(CSFIndex *Index, const char *LabelName, size_t LabelNameLength)
+{
+    uint64_t Hash;
+    uint32_t Slot;
+
+    // Returns the index + 1 of the Label called LabelName (in any case) in the CSFHeader or CSFTable, or 0 if there is none
+    Hash = CSFIndex_Hash(LabelName, LabelNameLength);
+
+    if(Index->Seed)
+    {
+        Slot = Index->Slot[CSFIndex_PerfectSlot(Hash, Index->Seed[(Hash >> 32) % Index->NumBuckets], Index->NumSlots)];
+
+        return CSFIndex_EqualAt(Index, Slot - 1, LabelName, LabelNameLength) ? Slot : 0;
+    }
+
+    for(Slot = Hash & (Index->NumSlots - 1); Index->Slot[Slot]; Slot = (Slot + 1) & (Index->NumSlots - 1))
+    {
+        if(CSFIndex_EqualAt(Index, Index->Slot[Slot] - 1, LabelName, LabelNameLength))
+        {
+            return Index->Slot[Slot];
+        }
+    }
+
+    return 0;
+}
+
+CSFLabel *
+CSFIndex_Find(CSFIndex *Index, const char *LabelName, size_t LabelNameLength)
+{
+    uint32_t Label;
+
+    // Returns the Label called LabelName (in any case), or NULL if there is none
+    // Nothing is copied, the Label and its value belong to the CSFHeader
+    // An index over a CSFTable has no CSFLabels, use CSFIndex_FindIndex and CSFTable_GetLabel there
+    if(!Index->CSFFile_Header || !(Label = CSFIndex_FindIndex(Index, LabelName, LabelNameLength)))
+    {
+        return NULL;
+    }
+
+    return Index->CSFFile_Header->Label[Label - 1];
+}
+
+void
+CSFIndex_Free(CSFIndex *Index)
+{
+    if(Index == NULL)
+    {
+        return;
+    }
+
+    free(Index->Slot);
+    free(Index->Seed);
+    free(Index);
+}
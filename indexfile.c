@@ -0,0 +1,410 @@
+#include "csftools.h"
+
+static uint64_t
+CSFIndexFile_Checksum(const uint8_t *Data, size_t Size)
+{
+    uint64_t Lane[4] = { 0x9E3779B97F4A7C15ULL, 0xBF58476D1CE4E5B9ULL, 0x94D049BB133111EBULL, 0xCBF29CE484222325ULL };
+    uint64_t Word, Checksum;
+    size_t i;
+    int j;
+
+    // Not cryptographic, only meant to notice that a CSF file changed since its index was written
+    // Four independent lanes of 8 bytes each, so this runs about as fast as the file can be read
+    for(i = 0; i + 32 <= Size; i += 32)
+    {
+        for(j = 0; j < 4; j++)
+        {
+            memcpy(&Word, Data + i + j * 8, sizeof(Word));
+
+            Lane[j] = (Lane[j] ^ Word) * 0x9E3779B97F4A7C15ULL;
+            Lane[j] ^= Lane[j] >> 29;
+        }
+    }
+
+    Checksum = Size;
+
+    for(j = 0; j < 4; j++)
+    {
+        Checksum = CSFIndex_Mix(Checksum ^ Lane[j]);
+    }
+
+    for(; i < Size; i++)
+    {
+        Checksum = (Checksum ^ Data[i]) * 0x100000001B3ULL;
+    }
+
+    return CSFIndex_Mix(Checksum);
+}
+
+static int
+CSFIndexFile_CompareEntries(const void *a, const void *b)
+{
+    const CSFIndexFileEntry *EntryA = a;
+    const CSFIndexFileEntry *EntryB = b;
+
+    // By Hash, and by Offset for equal ones, so the first of several Labels that only differ in case comes first
+    if(EntryA->Hash != EntryB->Hash)
+    {
+        return EntryA->Hash < EntryB->Hash ? -1 : 1;
+    }
+
+    return EntryA->Offset < EntryB->Offset ? -1 : EntryA->Offset > EntryB->Offset;
+}
+
+char *
+CSFIndexFile_GetPath(CSFContext *Context, const char *CSFFile_Path)
+{
+    size_t CSFFile_Path_Len = strlen(CSFFile_Path);
+    char *IndexFile_Path;
+
+    // The index of foo.csf is foo.csfidx, anything else just gets .csfidx appended
+    if(!(IndexFile_Path = malloc_c(Context, CSFFile_Path_Len + sizeof(".csfidx"))))
+    {
+        return NULL;
+    }
+
+    memcpy(IndexFile_Path, CSFFile_Path, CSFFile_Path_Len + 1);
+
+    if(CSFFile_Path_Len >= 4 && !strcmp(CSFFile_Path + CSFFile_Path_Len - 4, ".csf"))
+    {
+        strcat(IndexFile_Path, "idx");
+    }
+    else
+    {
+        strcat(IndexFile_Path, ".csfidx");
+    }
+
+    return IndexFile_Path;
+}
+
+int
+CSFIndexFile_Write(CSFContext *Context, char *CSFFile_Path, char *IndexFile_Path)
+{
+    CSFContext Quiet;
+    CSFReader *Reader = NULL;
+    CSFLabel *Label = NULL;
+    CSFIndexFileHeader IndexFile_Header;
+    CSFIndexFileEntry *Entries = NULL;
+    CSFWriteBuffer *IndexFile_Buffer = NULL;
+    FILE *IndexFile_Handle = NULL;
+    char *IndexFile_DefaultPath = NULL;
+    uint32_t i;
+
+    // Write an index file for CSFFile_Path, to IndexFile_Path or next to the CSF file if that's NULL
+    // It holds the hash of every LabelName and the offset of its Label, sorted by hash, and the size and checksum of the CSF file
+    // Values aren't decoded for this and warnings about the CSF file aren't logged again, it has been read before anyway
+    CSFContext_Init(&Quiet);
+
+    if(!(Reader = CSFReader_Open(&Quiet, CSFFile_Path, 1)))
+    {
+        return csf_error(Context, Quiet.Error, Quiet.ErrorMessage, Quiet.ErrorDetail, strlen(Quiet.ErrorDetail));
+    }
+
+    if(!Reader->Mapped)
+    {
+        CSFReader_Close(Reader);
+
+        return csf_error(Context, CSF_ERROR_OPEN, "Index files can only be written for regular CSF files, not for ", CSFFile_Path, strlen(CSFFile_Path));
+    }
+
+    if(!(Entries = malloc_c(Context, Reader->Header.NumLabels * sizeof(CSFIndexFileEntry) + 1)))
+    {
+        CSFReader_Close(Reader);
+
+        return Context->Error;
+    }
+
+    Reader->Prescan = 1;
+
+    for(i = 0; (Label = CSFReader_Next(Reader)); i++)
+    {
+        Entries[i].Hash = CSFIndex_Hash(Label->LabelName, Label->LabelNameLength);
+        Entries[i].Offset = Reader->LabelOffset;
+    }
+
+    if(Quiet.Error)
+    {
+        csf_error(Context, Quiet.Error, Quiet.ErrorMessage, Quiet.ErrorDetail, strlen(Quiet.ErrorDetail));
+    }
+    else
+    {
+        qsort(Entries, Reader->Header.NumLabels, sizeof(CSFIndexFileEntry), CSFIndexFile_CompareEntries);
+
+        memset(&IndexFile_Header, 0, sizeof(CSFIndexFileHeader));
+        IndexFile_Header.MagicHeader = CSFIDX_MAGIC;
+        IndexFile_Header.Version = CSFIDX_VERSION;
+        IndexFile_Header.NumEntries = Reader->Header.NumLabels;
+        IndexFile_Header.CSFSize = Reader->Size;
+        IndexFile_Header.CSFChecksum = CSFIndexFile_Checksum(Reader->Data, Reader->Size);
+
+        if(IndexFile_Path || (IndexFile_Path = IndexFile_DefaultPath = CSFIndexFile_GetPath(Context, CSFFile_Path)))
+        {
+            if((IndexFile_Handle = fopen_c(Context, IndexFile_Path, "wb")) && (IndexFile_Buffer = writebuffer_create(Context, IndexFile_Handle)))
+            {
+                writebuffer_write(IndexFile_Buffer, &IndexFile_Header, sizeof(CSFIndexFileHeader));
+                writebuffer_write(IndexFile_Buffer, Entries, Reader->Header.NumLabels * sizeof(CSFIndexFileEntry));
+                writebuffer_close(IndexFile_Buffer);
+            }
+
+            if(IndexFile_Handle && fclose_c(IndexFile_Handle))
+            {
+                csf_error(Context, CSF_ERROR_WRITE, "Couldn't write to ", IndexFile_Path, strlen(IndexFile_Path));
+            }
+        }
+    }
+
+    free(IndexFile_DefaultPath);
+    free(Entries);
+    CSFReader_Close(Reader);
+
+    return Context->Error;
+}
+
+static int
+CSFIndexFile_Check(CSFIndexFile *IndexFile)
+{
+    CSFIndexFileHeader *IndexFile_Header = (CSFIndexFileHeader *)IndexFile->IndexData;
+
+    // An index only counts if it belongs to exactly this CSF file
+    if(!IndexFile->CSFData || !IndexFile->IndexData || IndexFile->IndexSize < sizeof(CSFIndexFileHeader))
+    {
+        return 0;
+    }
+
+    if(IndexFile_Header->MagicHeader != CSFIDX_MAGIC || IndexFile_Header->Version != CSFIDX_VERSION)
+    {
+        return 0;
+    }
+
+    if(IndexFile->IndexSize != sizeof(CSFIndexFileHeader) + IndexFile_Header->NumEntries * (uint64_t)sizeof(CSFIndexFileEntry))
+    {
+        return 0;
+    }
+
+    if(IndexFile_Header->CSFSize != IndexFile->CSFSize || IndexFile_Header->CSFChecksum != CSFIndexFile_Checksum(IndexFile->CSFData, IndexFile->CSFSize))
+    {
+        return 0;
+    }
+
+    IndexFile->Entry = (CSFIndexFileEntry *)(IndexFile->IndexData + sizeof(CSFIndexFileHeader));
+    IndexFile->NumEntries = IndexFile_Header->NumEntries;
+
+    return 1;
+}
+
+CSFIndexFile *
+CSFIndexFile_Open(CSFContext *Context, char *CSFFile_Path, char *IndexFile_Path)
+{
+    CSFIndexFile *IndexFile;
+    char *IndexFile_DefaultPath = NULL;
+
+    // Open a CSF file for looking up single Labels, with its index file at IndexFile_Path or next to it if that's NULL
+    // If the index file is there and matches the CSF file, both are only mapped and a lookup only reads the Labels it needs
+    // Otherwise the whole CSF file is parsed and indexed in memory, which gives the same results, just slower
+    if(!(IndexFile = calloc_c(Context, 1, sizeof(CSFIndexFile))))
+    {
+        return NULL;
+    }
+
+    IndexFile->Context = Context;
+
+    if(strcmp(CSFFile_Path, "-") && (IndexFile_Path || (IndexFile_Path = IndexFile_DefaultPath = CSFIndexFile_GetPath(Context, CSFFile_Path))))
+    {
+        IndexFile->CSFData = fmap(CSFFile_Path, &IndexFile->CSFSize);
+        IndexFile->IndexData = fmap(IndexFile_Path, &IndexFile->IndexSize);
+
+        if(CSFIndexFile_Check(IndexFile))
+        {
+            free(IndexFile_DefaultPath);
+
+            return IndexFile;
+        }
+
+        csf_log(Context, CSF_LOG_INFO, "Index file %s is missing or doesn't match, reading the whole CSF file", IndexFile_Path);
+    }
+
+    free(IndexFile_DefaultPath);
+
+    if(IndexFile->CSFData)
+    {
+        funmap(IndexFile->CSFData, IndexFile->CSFSize);
+        IndexFile->CSFData = NULL;
+    }
+
+    if(IndexFile->IndexData)
+    {
+        funmap(IndexFile->IndexData, IndexFile->IndexSize);
+        IndexFile->IndexData = NULL;
+    }
+
+    if(Context->Error
+        || !(IndexFile->Reader = CSFReader_Open(Context, CSFFile_Path, 1))
+        || !(IndexFile->Arena = arena_create(Context, IndexFile->Reader->Header.NumLabels * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString))))
+        || !(IndexFile->CSFFile_Header = CSFFileHeader_Parse(IndexFile->Reader, IndexFile->Arena))
+        || !(IndexFile->Index = CSFIndex_Create(Context, IndexFile->CSFFile_Header, 0)))
+    {
+        CSFIndexFile_Close(IndexFile);
+
+        return NULL;
+    }
+
+    return IndexFile;
+}
+
+static CSFLabel *
+CSFIndexFile_ReadLabel(CSFIndexFile *IndexFile, uint64_t Offset, const char *LabelName, size_t LabelNameLength)
+{
+    CSFLabel *Label = &IndexFile->Label;
+    CSFString *String = &IndexFile->String;
+    uint8_t *Data;
+    char *ValueBuffer;
+    size_t Decoded;
+
+    // Read the Label at Offset if it's called LabelName, the same way CSFReader_Next does
+    // The checksum matched, so the CSF file is the one that was indexed, but a bad offset still shouldn't read past the end of it
+    if(Offset > IndexFile->CSFSize || IndexFile->CSFSize - Offset < 12)
+    {
+        return NULL;
+    }
+
+    Data = IndexFile->CSFData + Offset;
+
+    memcpy(&Label->MagicHeader, Data, 4);
+    memcpy(&Label->NumStringPairs, Data + 4, 4);
+    memcpy(&Label->LabelNameLength, Data + 8, 4);
+
+    Label->LabelName = (char *)Data + 12;
+    Label->String = String;
+
+    if(Label->MagicHeader != LBL_MAGIC || IndexFile->CSFSize - Offset - 12 < Label->LabelNameLength || !CSFIndex_Equal(Label, LabelName, LabelNameLength))
+    {
+        return NULL;
+    }
+
+    Offset += 12 + Label->LabelNameLength;
+
+    String->MagicHeader = STR_MAGIC;
+    String->ValueLength = 0;
+    String->Value = "";
+    String->ExtraValueLength = 0;
+    String->ExtraValue = NULL;
+
+    if(!Label->NumStringPairs || IndexFile->CSFSize - Offset < 8)
+    {
+        return Label;
+    }
+
+    Data = IndexFile->CSFData + Offset;
+
+    memcpy(&String->MagicHeader, Data, 4);
+    memcpy(&String->ValueLength, Data + 4, 4);
+
+    if((String->MagicHeader != STR_MAGIC && String->MagicHeader != STRW_MAGIC) || (IndexFile->CSFSize - Offset - 8) / 2 < String->ValueLength || String->ValueLength > UINT32_MAX / 3)
+    {
+        return NULL;
+    }
+
+    // The mapping is shared by all lookups, so values are decoded into a buffer of their own instead of in place
+    if(IndexFile->ValueBufferSize < String->ValueLength * (size_t)3 + 1)
+    {
+        if(!(ValueBuffer = realloc_c(IndexFile->Context, IndexFile->ValueBuffer, String->ValueLength * (size_t)3 + 1)))
+        {
+            return NULL;
+        }
+
+        IndexFile->ValueBuffer = ValueBuffer;
+        IndexFile->ValueBufferSize = String->ValueLength * (size_t)3 + 1;
+    }
+
+    String->Value = IndexFile->ValueBuffer;
+    Offset += 8 + String->ValueLength * (uint64_t)2;
+    String->ValueLength = (uint32_t)CSFString_Decode(String->Value, Data + 8, String->ValueLength, &Decoded);
+    String->Value[String->ValueLength] = '\0';
+
+    // The ExtraValue of a STRW String isn't decoded, so it points straight into the mapping
+    if(String->MagicHeader == STRW_MAGIC)
+    {
+        if(IndexFile->CSFSize - Offset < 4)
+        {
+            return NULL;
+        }
+
+        memcpy(&String->ExtraValueLength, IndexFile->CSFData + Offset, 4);
+
+        if(IndexFile->CSFSize - Offset - 4 < String->ExtraValueLength)
+        {
+            return NULL;
+        }
+
+        String->ExtraValue = IndexFile->CSFData + Offset + 4;
+    }
+
+    return Label;
+}
+
+CSFLabel *
+CSFIndexFile_Find(CSFIndexFile *IndexFile, const char *LabelName, size_t LabelNameLength)
+{
+    CSFLabel *Label;
+    uint64_t Hash;
+    uint32_t Low, High, Middle;
+
+    // Returns the Label called LabelName (in any case), or NULL if there is none
+    // With an index file the Label and its value stay valid until the next lookup, otherwise until CSFIndexFile_Close
+    if(IndexFile->Index)
+    {
+        return CSFIndex_Find(IndexFile->Index, LabelName, LabelNameLength);
+    }
+
+    Hash = CSFIndex_Hash(LabelName, LabelNameLength);
+
+    // Find the first entry with this Hash
+    for(Low = 0, High = IndexFile->NumEntries; Low < High;)
+    {
+        Middle = Low + (High - Low) / 2;
+
+        if(IndexFile->Entry[Middle].Hash < Hash)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    for(; Low < IndexFile->NumEntries && IndexFile->Entry[Low].Hash == Hash; Low++)
+    {
+        if((Label = CSFIndexFile_ReadLabel(IndexFile, IndexFile->Entry[Low].Offset, LabelName, LabelNameLength)))
+        {
+            return Label;
+        }
+    }
+
+    return NULL;
+}
+
+void
+CSFIndexFile_Close(CSFIndexFile *IndexFile)
+{
+    if(IndexFile == NULL)
+    {
+        return;
+    }
+
+    if(IndexFile->CSFData)
+    {
+        funmap(IndexFile->CSFData, IndexFile->CSFSize);
+    }
+
+    if(IndexFile->IndexData)
+    {
+        funmap(IndexFile->IndexData, IndexFile->IndexSize);
+    }
+
+    CSFIndex_Free(IndexFile->Index);
+    arena_free(IndexFile->Arena);
+    CSFReader_Close(IndexFile->Reader);
+    free(IndexFile->ValueBuffer);
+    free(IndexFile);
+}
@@ -0,0 +1,338 @@
+#include "csftools.h"
+
+static uint64_t
+CSFIntern_Hash(CSFString *String)
+{
+    uint64_t Hash = String->MagicHeader;
+    uint64_t Block;
+    uint32_t i;
+
+    // Eight bytes at a time, values are mostly short and this runs once per Label
+    for(i = 0; i + 8 <= String->ValueLength; i += 8)
+    {
+        memcpy(&Block, String->Value + i, 8);
+        Hash = CSFIndex_Mix(Hash ^ Block);
+    }
+
+    for(; i < String->ValueLength; i++)
+    {
+        Hash = (Hash ^ (uint8_t)String->Value[i]) * 0x100000001B3ULL;
+    }
+
+    for(i = 0; i < String->ExtraValueLength; i++)
+    {
+        Hash = (Hash ^ String->ExtraValue[i]) * 0x100000001B3ULL;
+    }
+
+    return CSFIndex_Mix(Hash ^ ((uint64_t)String->ValueLength << 32) ^ String->ExtraValueLength);
+}
+
+static int
+CSFIntern_Equal(CSFString *String, CSFString *OtherString)
+{
+    // Same as CSFDiff_ValueEqual, the ExtraValue of a STRW String counts as part of the value
+    return String->MagicHeader == OtherString->MagicHeader && String->ValueLength == OtherString->ValueLength && String->ExtraValueLength == OtherString->ExtraValueLength
+        && !memcmp(String->Value, OtherString->Value, String->ValueLength)
+        && (!String->ExtraValueLength || !memcmp(String->ExtraValue, OtherString->ExtraValue, String->ExtraValueLength));
+}
+
+static uint32_t
+CSFIntern_StringSlot(CSFIntern *Intern, CSFString *String)
+{
+    // Shared Strings are found by their address, that's all a writer has
+    return (uint32_t)CSFIndex_Mix((uint64_t)(uintptr_t)String) & (Intern->NumStringSlots - 1);
+}
+
+static int
+CSFIntern_GrowValues(CSFIntern *Intern)
+{
+    CSFInternSlot *Slot;
+    uint32_t NumSlots = Intern->NumValueSlots * 2;
+    uint32_t i, j;
+
+    // The value table is kept at most half full, so it doubles once it'd get fuller than that
+    if(!(Slot = calloc_c(Intern->Context, NumSlots, sizeof(CSFInternSlot))))
+    {
+        return Intern->Context->Error;
+    }
+
+    for(i = 0; i < Intern->NumValueSlots; i++)
+    {
+        if(!Intern->ValueSlot[i].Entry)
+        {
+            continue;
+        }
+
+        for(j = Intern->ValueSlot[i].Hash & (NumSlots - 1); Slot[j].Entry; j = (j + 1) & (NumSlots - 1));
+
+        Slot[j] = Intern->ValueSlot[i];
+    }
+
+    free(Intern->ValueSlot);
+
+    Intern->ValueSlot = Slot;
+    Intern->NumValueSlots = NumSlots;
+
+    return CSF_OK;
+}
+
+static int
+CSFIntern_GrowStrings(CSFIntern *Intern)
+{
+    CSFInternEntry **Slot;
+    uint32_t NumSlots = Intern->NumStringSlots * 2;
+    uint32_t i, j;
+
+    // Same for the table of shared entries
+    if(!(Slot = calloc_c(Intern->Context, NumSlots, sizeof(CSFInternEntry *))))
+    {
+        return Intern->Context->Error;
+    }
+
+    for(i = 0; i < Intern->NumStringSlots; i++)
+    {
+        if(!Intern->StringSlot[i])
+        {
+            continue;
+        }
+
+        for(j = (uint32_t)CSFIndex_Mix((uint64_t)(uintptr_t)&Intern->StringSlot[i]->String) & (NumSlots - 1); Slot[j]; j = (j + 1) & (NumSlots - 1));
+
+        Slot[j] = Intern->StringSlot[i];
+    }
+
+    free(Intern->StringSlot);
+
+    Intern->StringSlot = Slot;
+    Intern->NumStringSlots = NumSlots;
+
+    return CSF_OK;
+}
+
+static int
+CSFIntern_Share(CSFIntern *Intern, CSFInternEntry *Entry)
+{
+    uint32_t Slot;
+
+    // The entry got its second Label, so a writer has to find it from now on
+    if(Intern->NumShared * (uint64_t)2 >= Intern->NumStringSlots && CSFIntern_GrowStrings(Intern))
+    {
+        return Intern->Context->Error;
+    }
+
+    for(Slot = CSFIntern_StringSlot(Intern, &Entry->String); Intern->StringSlot[Slot]; Slot = (Slot + 1) & (Intern->NumStringSlots - 1));
+
+    Intern->StringSlot[Slot] = Entry;
+    Intern->NumShared++;
+
+    return CSF_OK;
+}
+
+static CSFInternEntry *
+CSFIntern_FindString(CSFIntern *Intern, CSFString *String)
+{
+    uint32_t Slot;
+
+    for(Slot = CSFIntern_StringSlot(Intern, String); Intern->StringSlot[Slot]; Slot = (Slot + 1) & (Intern->NumStringSlots - 1))
+    {
+        if(&Intern->StringSlot[Slot]->String == String)
+        {
+            return Intern->StringSlot[Slot];
+        }
+    }
+
+    return NULL;
+}
+
+CSFIntern *
+CSFIntern_Create(CSFContext *Context, CSFArena *Arena, size_t Size)
+{
+    CSFIntern *Intern;
+
+    // Entries and the values they copy are allocated from Arena, so Strings handed out stay valid as long as it does, even after CSFIntern_Free
+    // Size is the size of the STR file if it's known, or 0, a Label usually takes more than 64 bytes in one and growing the table later touches all of it again
+    if(!(Intern = calloc_c(Context, 1, sizeof(CSFIntern))))
+    {
+        return NULL;
+    }
+
+    Intern->Context = Context;
+    Intern->Arena = Arena;
+
+    for(Intern->NumValueSlots = 1024; Intern->NumValueSlots < Size / 32 && Intern->NumValueSlots < 1U << 30; Intern->NumValueSlots *= 2);
+
+    Intern->NumStringSlots = 64;
+
+    if(!(Intern->ValueSlot = calloc_c(Context, Intern->NumValueSlots, sizeof(CSFInternSlot)))
+        || !(Intern->StringSlot = calloc_c(Context, Intern->NumStringSlots, sizeof(CSFInternEntry *))))
+    {
+        CSFIntern_Free(Intern);
+        return NULL;
+    }
+
+    return Intern;
+}
+
+CSFString *
+CSFIntern_Add(CSFIntern *Intern, CSFString *String, int Copy)
+{
+    CSFInternEntry *Entry;
+    uint64_t Hash;
+    uint32_t Slot;
+
+    // Returns the String every Label with the same value (and ExtraValue) shares, String itself doesn't have to stay valid
+    // With Copy, the value and ExtraValue of a new one are copied into the arena, otherwise they keep pointing wherever String points (i.e. into a mapped STR file)
+    // Returns NULL if there's no memory
+    Hash = CSFIntern_Hash(String);
+
+    for(Slot = Hash & (Intern->NumValueSlots - 1); (Entry = Intern->ValueSlot[Slot].Entry); Slot = (Slot + 1) & (Intern->NumValueSlots - 1))
+    {
+        if(Intern->ValueSlot[Slot].Hash == Hash && CSFIntern_Equal(&Entry->String, String))
+        {
+            if(++Entry->NumLabels == 2 && CSFIntern_Share(Intern, Entry))
+            {
+                return NULL;
+            }
+
+            Intern->NumInterned++;
+            Intern->SavedBytes += sizeof(CSFString) + (Copy ? (uint64_t)String->ValueLength + String->ExtraValueLength : 0);
+
+            return &Entry->String;
+        }
+    }
+
+    if(!(Entry = arena_alloc(Intern->Arena, sizeof(CSFInternEntry))))
+    {
+        return NULL;
+    }
+
+    Entry->String = *String;
+    Entry->NumLabels = 1;
+    Entry->EncodedValueLength = 0;
+    Entry->EncodedValue = NULL;
+
+    if(Copy)
+    {
+        if(!(Entry->String.Value = arena_alloc(Intern->Arena, String->ValueLength)))
+        {
+            return NULL;
+        }
+
+        memcpy(Entry->String.Value, String->Value, String->ValueLength);
+
+        if(String->ExtraValue && !(Entry->String.ExtraValue = arena_alloc(Intern->Arena, String->ExtraValueLength)))
+        {
+            return NULL;
+        }
+
+        if(String->ExtraValue)
+        {
+            memcpy(Entry->String.ExtraValue, String->ExtraValue, String->ExtraValueLength);
+        }
+    }
+
+    Intern->ValueSlot[Slot].Hash = Hash;
+    Intern->ValueSlot[Slot].Entry = Entry;
+    Intern->NumEntries++;
+
+    if(Intern->NumEntries * (uint64_t)2 >= Intern->NumValueSlots && CSFIntern_GrowValues(Intern))
+    {
+        return NULL;
+    }
+
+    return &Entry->String;
+}
+
+int
+CSFIntern_Merge(CSFIntern *Intern, CSFIntern *Other)
+{
+    uint32_t i;
+
+    // Takes over the shared entries of Other, i.e. of one thread of CSFFileHeader_CreateParallel, Other can only be freed afterwards
+    // Parsing is done by then, so only what a writer looks up is merged, a value two threads both have stays in memory twice and is encoded once for each of them
+    for(i = 0; i < Other->NumValueSlots && !Intern->Context->Error; i++)
+    {
+        if(Other->ValueSlot[i].Entry && Other->ValueSlot[i].Entry->NumLabels > 1)
+        {
+            CSFIntern_Share(Intern, Other->ValueSlot[i].Entry);
+        }
+    }
+
+    Intern->NumEntries += Other->NumEntries;
+    Intern->NumInterned += Other->NumInterned;
+    Intern->SavedBytes += Other->SavedBytes;
+
+    return Intern->Context->Error;
+}
+
+void
+CSFIntern_WriteLabel(CSFIntern *Intern, CSFWriteBuffer *CSFFile_Buffer, CSFLabel *Label)
+{
+    CSFInternEntry *Entry;
+    uint64_t EncodeStart;
+
+    // Same as CSFFile_WriteLabel, but a String that several Labels share is only encoded for the first one of them, the others get a copy of that
+    if(!Label->NumStringPairs || !(Entry = CSFIntern_FindString(Intern, Label->String)))
+    {
+        CSFFile_WriteLabel(CSFFile_Buffer, Label);
+        return;
+    }
+
+    if(Entry->EncodedValue)
+    {
+        Intern->NumEncodesSaved++;
+    }
+    else
+    {
+        if(!(Entry->EncodedValue = arena_alloc(Intern->Arena, Entry->String.ValueLength * (size_t)2 + 1)))
+        {
+            return;
+        }
+
+        EncodeStart = csf_stats_start(CSFFile_Buffer->Context);
+        Entry->EncodedValueLength = (uint32_t)CSFString_Encode(Entry->EncodedValue, Entry->String.Value, Entry->String.ValueLength);
+        csf_stats_stop(CSFFile_Buffer->Context, CSF_STAT_TIME_ENCODE, EncodeStart);
+    }
+
+    CSFFile_WriteEncodedLabel(CSFFile_Buffer, Label, Entry->EncodedValue, Entry->EncodedValueLength);
+}
+
+void
+CSFIntern_WriteHeader(CSFIntern *Intern, CSFWriteBuffer *CSFFile_Buffer, CSFHeader *CSFFile_Header)
+{
+    uint32_t i;
+
+    // Writes a whole CSF file of Labels that are all known already, i.e. parsed from a STR file or imported from a JSON, CSV or PO file, and says what interning saved
+    writebuffer_write(CSFFile_Buffer, CSFFile_Header, sizeof(CSFHeader));
+
+    for(i = 0; i < CSFFile_Header->NumLabels && !Intern->Context->Error; i++)
+    {
+        CSFIntern_WriteLabel(Intern, CSFFile_Buffer, CSFFile_Header->Label[i]);
+    }
+
+    CSFIntern_Report(Intern);
+}
+
+void
+CSFIntern_Report(CSFIntern *Intern)
+{
+    // Says what interning saved, and adds it to the stats
+    csf_log(Intern->Context, CSF_LOG_INFO, "%u values are shared by more than one Label, which saved %llu bytes and %u encodes",
+        Intern->NumShared, (unsigned long long)Intern->SavedBytes, Intern->NumEncodesSaved);
+
+    csf_stats_add(Intern->Context, CSF_STAT_INTERNED_BYTES, Intern->SavedBytes);
+}
+
+void
+CSFIntern_Free(CSFIntern *Intern)
+{
+    if(Intern == NULL)
+    {
+        return;
+    }
+
+    // The entries belong to the arena
+    free(Intern->ValueSlot);
+    free(Intern->StringSlot);
+    free(Intern);
+}
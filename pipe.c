@@ -0,0 +1,428 @@
+#include "csftools.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+int
+ring_push(CSFRing *Ring, void *Item)
+{
+    uint32_t Head = __atomic_load_n(&Ring->Head, __ATOMIC_RELAXED);
+
+    // Only ever called by the one thread that fills the ring, returns 0 if it's full
+    if(Head - __atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE) == PIPELINE_NUM_BLOCKS)
+    {
+        return 0;
+    }
+
+    Ring->Slot[Head & (PIPELINE_NUM_BLOCKS - 1)] = Item;
+    __atomic_store_n(&Ring->Head, Head + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+void *
+ring_pop(CSFRing *Ring)
+{
+    uint32_t Tail = __atomic_load_n(&Ring->Tail, __ATOMIC_RELAXED);
+    void *Item;
+
+    // Only ever called by the one thread that empties the ring, returns NULL if it's empty
+    if(__atomic_load_n(&Ring->Head, __ATOMIC_ACQUIRE) == Tail)
+    {
+        return NULL;
+    }
+
+    Item = Ring->Slot[Tail & (PIPELINE_NUM_BLOCKS - 1)];
+    __atomic_store_n(&Ring->Tail, Tail + 1, __ATOMIC_RELEASE);
+
+    return Item;
+}
+
+uint32_t
+ring_count(CSFRing *Ring)
+{
+    return __atomic_load_n(&Ring->Head, __ATOMIC_ACQUIRE) - __atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE);
+}
+
+static int
+pipe_blocks_create(CSFContext *Context, CSFBlock *Block, CSFRing *Free, size_t Size)
+{
+    int i;
+
+    // Every block starts out empty in the Free ring
+    for(i = 0; i < PIPELINE_NUM_BLOCKS; i++)
+    {
+        if(!(Block[i].Data = malloc_c(Context, Size)))
+        {
+            return Context->Error;
+        }
+
+        Block[i].Size = Size;
+        Block[i].Used = 0;
+
+        ring_push(Free, &Block[i]);
+    }
+
+    return CSF_OK;
+}
+
+static void
+pipe_blocks_free(CSFBlock *Block)
+{
+    int i;
+
+    for(i = 0; i < PIPELINE_NUM_BLOCKS; i++)
+    {
+        free(Block[i].Data);
+    }
+}
+
+static void
+pipereader_fill(CSFPipeReader *Pipe, CSFBlock *Block)
+{
+#ifndef _WIN32
+    ssize_t n;
+#endif
+
+    // Reads the next part of the file into Block, Used is 0 at the end of the file or on an error
+    // Regular files are read with pread, so nothing depends on where the stream is, anything else is read as it comes
+#ifdef _WIN32
+    Block->Used = fread(Block->Data, 1, Block->Size, Pipe->Handle);
+    Pipe->Error = !Block->Used && ferror(Pipe->Handle);
+#else
+    Block->Used = 0;
+
+    while(Block->Used < Block->Size)
+    {
+        if(Pipe->Regular)
+        {
+            n = pread(fileno(Pipe->Handle), Block->Data + Block->Used, Block->Size - Block->Used, (off_t)Pipe->Offset);
+        }
+        else
+        {
+            n = read(fileno(Pipe->Handle), Block->Data + Block->Used, Block->Size - Block->Used);
+        }
+
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if(n < 0)
+        {
+            Pipe->Error = 1;
+            Block->Used = 0;
+            break;
+        }
+
+        Block->Used += (size_t)n;
+        Pipe->Offset += (uint64_t)n;
+
+        // A pipe hands out whatever it has, that's worth passing on instead of waiting for a full block
+        if(!n || !Pipe->Regular)
+        {
+            break;
+        }
+    }
+#endif
+}
+
+static void *
+pipereader_thread(void *Args)
+{
+    CSFPipeReader *Pipe = Args;
+    CSFBlock *Block;
+    uint32_t Spins = 0;
+
+    // Keeps every free block filled with the next part of the file, until the end of the file, an error, or until the reader is closed
+    while(!__atomic_load_n(&Pipe->Stop, __ATOMIC_ACQUIRE))
+    {
+        if(!(Block = ring_pop(&Pipe->Free)))
+        {
+            thread_backoff(&Spins);
+            continue;
+        }
+
+        Spins = 0;
+
+        pipereader_fill(Pipe, Block);
+
+        // There are only as many blocks as the ring has room for, so this always fits
+        ring_push(&Pipe->Full, Block);
+
+        if(!Block->Used)
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+CSFPipeReader *
+pipereader_open(CSFContext *Context, const char *path)
+{
+    CSFPipeReader *Pipe;
+#ifndef _WIN32
+    struct stat st;
+#endif
+
+    // Reads a file (or - for stdin) on a thread of its own, a few blocks ahead of pipereader_read, so waiting for the disk overlaps with whatever the caller does with the data
+    // If the thread can't be started, every block is read when it's needed instead
+    if(!(Pipe = calloc_c(Context, 1, sizeof(CSFPipeReader))))
+    {
+        return NULL;
+    }
+
+    Pipe->Context = Context;
+
+    if(!(Pipe->Handle = fopen_c(Context, path, "rb")) || pipe_blocks_create(Context, Pipe->Block, &Pipe->Free, PIPELINE_BLOCK_SIZE))
+    {
+        pipereader_close(Pipe);
+        return NULL;
+    }
+
+#ifndef _WIN32
+    Pipe->Regular = !fstat(fileno(Pipe->Handle), &st) && S_ISREG(st.st_mode);
+#endif
+
+    Pipe->Thread = thread_start(pipereader_thread, Pipe);
+
+    return Pipe;
+}
+
+size_t
+pipereader_read(CSFPipeReader *Pipe, void *data, size_t size)
+{
+    size_t Done = 0, n;
+    uint32_t Spins = 0;
+
+    // Same as fread, returns less than size only at the end of the file or on an error, pipereader_error tells which
+    while(Done < size)
+    {
+        if(!Pipe->Current || Pipe->CurrentOffset == Pipe->Current->Used)
+        {
+            if(Pipe->Eof)
+            {
+                break;
+            }
+
+            // The block that's used up goes back to be filled again, before waiting for the next one
+            if(Pipe->Current)
+            {
+                ring_push(&Pipe->Free, Pipe->Current);
+            }
+
+            if(!Pipe->Thread && (Pipe->Current = ring_pop(&Pipe->Free)))
+            {
+                pipereader_fill(Pipe, Pipe->Current);
+            }
+            else
+            {
+                while(!(Pipe->Current = ring_pop(&Pipe->Full)))
+                {
+                    thread_backoff(&Spins);
+                }
+            }
+
+            Pipe->CurrentOffset = 0;
+
+            if(!Pipe->Current->Used)
+            {
+                Pipe->Eof = 1;
+                break;
+            }
+        }
+
+        n = Pipe->Current->Used - Pipe->CurrentOffset < size - Done ? Pipe->Current->Used - Pipe->CurrentOffset : size - Done;
+
+        memcpy((uint8_t *)data + Done, Pipe->Current->Data + Pipe->CurrentOffset, n);
+
+        Pipe->CurrentOffset += n;
+        Done += n;
+    }
+
+    return Done;
+}
+
+int
+pipereader_error(CSFPipeReader *Pipe)
+{
+    // Same as ferror, only known for sure once pipereader_read came up short
+    return Pipe->Eof && Pipe->Error;
+}
+
+void
+pipereader_close(CSFPipeReader *Pipe)
+{
+    if(Pipe == NULL)
+    {
+        return;
+    }
+
+    // The thread may still be reading ahead, it stops once it's done with the block it's at
+    __atomic_store_n(&Pipe->Stop, 1, __ATOMIC_RELEASE);
+
+    if(Pipe->Thread)
+    {
+        thread_join(Pipe->Thread);
+    }
+
+    if(Pipe->Handle)
+    {
+        fclose_c(Pipe->Handle);
+    }
+
+    pipe_blocks_free(Pipe->Block);
+    free(Pipe);
+}
+
+static void
+pipewriter_write(CSFPipeWriter *Pipe, CSFBlock *Block)
+{
+    // Once a write failed, everything after it is dropped, same as for a CSFWriteBuffer
+    if(!__atomic_load_n(&Pipe->Error, __ATOMIC_RELAXED) && Block->Used && fwrite(Block->Data, Block->Used, 1, Pipe->Handle) != 1)
+    {
+        __atomic_store_n(&Pipe->Error, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void *
+pipewriter_thread(void *Args)
+{
+    CSFPipeWriter *Pipe = Args;
+    CSFBlock *Block;
+    uint32_t Spins = 0;
+    int Done;
+
+    // Writes every block in the order it was submitted and hands it back, until the writer is closed and nothing is left
+    // Done is checked before the ring, so a block submitted right before closing is still written
+    for(;;)
+    {
+        Done = __atomic_load_n(&Pipe->Done, __ATOMIC_ACQUIRE);
+
+        if((Block = ring_pop(&Pipe->Full)))
+        {
+            Spins = 0;
+
+            pipewriter_write(Pipe, Block);
+            ring_push(&Pipe->Free, Block);
+
+            continue;
+        }
+
+        if(Done)
+        {
+            break;
+        }
+
+        thread_backoff(&Spins);
+    }
+
+    return NULL;
+}
+
+CSFPipeWriter *
+pipewriter_create(CSFContext *Context, FILE *stream)
+{
+    CSFPipeWriter *Pipe;
+
+    // Writes blocks to stream on a thread of its own, so filling the next block overlaps with waiting for the disk, the stream is still owned by the caller
+    // If the thread can't be started, every block is written as it's submitted instead
+    if(!(Pipe = calloc_c(Context, 1, sizeof(CSFPipeWriter))))
+    {
+        return NULL;
+    }
+
+    Pipe->Context = Context;
+    Pipe->Handle = stream;
+
+    if(pipe_blocks_create(Context, Pipe->Block, &Pipe->Free, WRITEBUFFER_SIZE))
+    {
+        pipe_blocks_free(Pipe->Block);
+        free(Pipe);
+        return NULL;
+    }
+
+    Pipe->Thread = thread_start(pipewriter_thread, Pipe);
+
+    return Pipe;
+}
+
+int
+pipewriter_submit(CSFPipeWriter *Pipe, uint8_t **data, size_t *size, size_t used)
+{
+    CSFBlock *Block;
+    uint8_t *Data;
+    size_t Size;
+    uint32_t Spins = 0;
+
+    // Hands the first used bytes of *data to the thread to write, and replaces *data and *size with an empty block to fill in the meantime
+    // Returns 1 if any write so far failed
+    while(!(Block = ring_pop(&Pipe->Free)))
+    {
+        thread_backoff(&Spins);
+    }
+
+    Data = Block->Data;
+    Size = Block->Size;
+
+    Block->Data = *data;
+    Block->Size = *size;
+    Block->Used = used;
+
+    *data = Data;
+    *size = Size;
+
+    if(Pipe->Thread)
+    {
+        ring_push(&Pipe->Full, Block);
+    }
+    else
+    {
+        pipewriter_write(Pipe, Block);
+        ring_push(&Pipe->Free, Block);
+    }
+
+    return __atomic_load_n(&Pipe->Error, __ATOMIC_ACQUIRE);
+}
+
+int
+pipewriter_drain(CSFPipeWriter *Pipe)
+{
+    uint32_t Spins = 0;
+
+    // Waits until everything submitted so far is written, so the caller can use the stream directly, returns 1 if any write failed
+    while(ring_count(&Pipe->Free) != PIPELINE_NUM_BLOCKS)
+    {
+        thread_backoff(&Spins);
+    }
+
+    return __atomic_load_n(&Pipe->Error, __ATOMIC_ACQUIRE);
+}
+
+int
+pipewriter_close(CSFPipeWriter *Pipe)
+{
+    int Error;
+
+    // Writes whatever is left, returns 1 if any write failed
+    __atomic_store_n(&Pipe->Done, 1, __ATOMIC_RELEASE);
+
+    if(Pipe->Thread)
+    {
+        thread_join(Pipe->Thread);
+    }
+
+    Error = Pipe->Error;
+
+    pipe_blocks_free(Pipe->Block);
+    free(Pipe);
+
+    return Error;
+}
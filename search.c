@@ -0,0 +1,275 @@
+#include "csftools.h"
+
+#ifndef _WIN32
+#include <regex.h>
+#endif
+
+int
+CSFSearch_Init(CSFContext *Context, CSFSearch *Search, const char *Pattern, int Flags)
+{
+    size_t i;
+#ifndef _WIN32
+    char Message[CSF_ERROR_DETAIL_MAX];
+    int Error;
+#endif
+
+    // Flags without CSF_SEARCH_NAMES or CSF_SEARCH_VALUES search both
+    memset(Search, 0, sizeof(CSFSearch));
+
+    Search->Context = Context;
+    Search->Flags = Flags & (CSF_SEARCH_NAMES | CSF_SEARCH_VALUES) ? Flags : Flags | CSF_SEARCH_NAMES | CSF_SEARCH_VALUES;
+    Search->PatternLength = strlen(Pattern);
+
+    if(!(Search->Flags & CSF_SEARCH_REGEX))
+    {
+        if(!(Search->Pattern = malloc_c(Context, Search->PatternLength + 1)))
+        {
+            return Context->Error;
+        }
+
+        for(i = 0; i <= Search->PatternLength; i++)
+        {
+            Search->Pattern[i] = Search->Flags & CSF_SEARCH_IGNORE_CASE ? (char)tolower((unsigned char)Pattern[i]) : Pattern[i];
+        }
+
+        return CSF_OK;
+    }
+
+#ifdef _WIN32
+    return csf_error(Context, CSF_ERROR_PATTERN, "Regular expressions aren't supported on Windows", "", 0);
+#else
+    if(!(Search->Regex = malloc_c(Context, sizeof(regex_t))))
+    {
+        return Context->Error;
+    }
+
+    if((Error = regcomp(Search->Regex, Pattern, REG_EXTENDED | REG_NOSUB | (Search->Flags & CSF_SEARCH_IGNORE_CASE ? REG_ICASE : 0))))
+    {
+        regerror(Error, Search->Regex, Message, sizeof(Message));
+        free(Search->Regex);
+        Search->Regex = NULL;
+
+        return csf_error(Context, CSF_ERROR_PATTERN, "Invalid regular expression: ", Message, strlen(Message));
+    }
+
+    return CSF_OK;
+#endif
+}
+
+static int
+CSFSearch_Match(CSFSearch *Search, const char *Text, size_t TextLength)
+{
+    // A regular expression needs Text to be null-terminated, so it stops at the first null char of a value
+#ifndef _WIN32
+    if(Search->Regex)
+    {
+        return !regexec(Search->Regex, Text, 0, NULL, 0);
+    }
+#endif
+
+    return csf_memmem(Text, TextLength, Search->Pattern, Search->PatternLength, Search->Flags & CSF_SEARCH_IGNORE_CASE) != NULL;
+}
+
+int
+CSFSearch_Label(CSFSearch *Search, CSFLabel *Label)
+{
+    // Returns 1 if Label matches, its value has to be decoded already and null-terminated, like the ones of CSFFileHeader_Parse or of a reader
+    // For a regular expression the LabelName has to be null-terminated as well, CSFFileHeader_Search takes care of that
+    if(Search->Flags & CSF_SEARCH_NAMES && CSFSearch_Match(Search, Label->LabelName, Label->LabelNameLength))
+    {
+        return 1;
+    }
+
+    return Search->Flags & CSF_SEARCH_VALUES && Label->NumStringPairs && CSFSearch_Match(Search, Label->String->Value, Label->String->ValueLength);
+}
+
+static int
+CSFSearch_MatchName(CSFSearchJob *Job, CSFLabel *Label)
+{
+    char *NameBuffer;
+
+    // LabelNames of a file opened with InPlace point into the mapping, so a regular expression gets a null-terminated copy
+    if(!Job->Search->Regex)
+    {
+        return CSFSearch_Match(Job->Search, Label->LabelName, Label->LabelNameLength);
+    }
+
+    if(Job->NameBufferSize < Label->LabelNameLength + (size_t)1)
+    {
+        if(!(NameBuffer = realloc_c(&Job->Context, Job->NameBuffer, Label->LabelNameLength + (size_t)1)))
+        {
+            return 0;
+        }
+
+        Job->NameBuffer = NameBuffer;
+        Job->NameBufferSize = Label->LabelNameLength + (size_t)1;
+    }
+
+    memcpy(Job->NameBuffer, Label->LabelName, Label->LabelNameLength);
+    Job->NameBuffer[Label->LabelNameLength] = '\0';
+
+    return CSFSearch_Match(Job->Search, Job->NameBuffer, Label->LabelNameLength);
+}
+
+static void *
+CSFSearch_Thread(void *Args)
+{
+    CSFSearchJob *Job = Args;
+    CSFLabel *Label;
+    uint32_t i;
+
+    // A value is only decoded if it's searched or if its Label matched by name, since matches are returned with their values
+    for(i = Job->LabelStart; i < Job->LabelEnd && !Job->Context.Error; i++)
+    {
+        Label = Job->CSFFile_Header->Label[i];
+
+        Job->Match[i] = Job->Search->Flags & CSF_SEARCH_NAMES && CSFSearch_MatchName(Job, Label);
+
+        if(!Job->Match[i] && !(Job->Search->Flags & CSF_SEARCH_VALUES))
+        {
+            continue;
+        }
+
+        if(Job->Prescanned && CSFString_DecodePrescanned(Label->String, Job->Arena))
+        {
+            break;
+        }
+
+        if(!Job->Match[i])
+        {
+            Job->Match[i] = Label->NumStringPairs && CSFSearch_Match(Job->Search, Label->String->Value, Label->String->ValueLength);
+        }
+    }
+
+    free(Job->NameBuffer);
+
+    return NULL;
+}
+
+CSFHeader *
+CSFFileHeader_Search(CSFReader *Reader, CSFArena *Arena, CSFSearch *Search, int NumThreads)
+{
+    CSFHeader *CSFFile_Header = NULL;
+    CSFHeader *Found = NULL;
+    CSFSearchJob *Jobs = NULL;
+    uint8_t *Match = NULL;
+    uint64_t LengthTotal = 0;
+    uint64_t LengthSum = 0;
+    uint32_t i, n;
+    int j;
+
+    // Returns a CSFHeader of only the Labels that match Search, in the order of the file, everything is allocated from Arena
+    // Same as CSFFileHeader_ParseParallel, a mapped file opened with InPlace is walked once without decoding anything, then every thread matches its own range of Labels
+    // Values are decoded in place by the thread that matches them, so a search of only LabelNames only decodes the values of the Labels that matched
+    // Any other file is parsed as a whole first, the Labels point into the reader like the ones of CSFFileHeader_Parse
+    if(NumThreads < 1)
+    {
+        NumThreads = 1;
+    }
+
+    Reader->Prescan = Reader->InPlace;
+    CSFFile_Header = CSFFileHeader_Parse(Reader, Arena);
+    Reader->Prescan = 0;
+
+    if(!CSFFile_Header)
+    {
+        return NULL;
+    }
+
+    if(!(Jobs = calloc_c(Reader->Context, NumThreads, sizeof(CSFSearchJob))) || !(Match = calloc_c(Reader->Context, CSFFile_Header->NumLabels + 1, 1)))
+    {
+        free(Jobs);
+        return NULL;
+    }
+
+    // Ranges are split by LabelName and value length, that's about what every thread has to go through
+    for(i = 0; i < CSFFile_Header->NumLabels; i++)
+    {
+        LengthTotal += CSFFile_Header->Label[i]->LabelNameLength + (uint64_t)CSFFile_Header->Label[i]->String->ValueLength;
+    }
+
+    for(i = 0, j = 0; j < NumThreads; j++)
+    {
+        // Every job gets a context of its own, same as for CSFFileHeader_ParseParallel
+        Jobs[j].Context.Log = Reader->Context->Log;
+        Jobs[j].Context.UserData = Reader->Context->UserData;
+        Jobs[j].Context.Stats = Reader->Context->Stats;
+        Jobs[j].Arena = arena_create(&Jobs[j].Context, 0);
+        Jobs[j].Search = Search;
+        Jobs[j].CSFFile_Header = CSFFile_Header;
+        Jobs[j].Match = Match;
+        Jobs[j].Prescanned = Reader->InPlace;
+        Jobs[j].LabelStart = i;
+
+        while(i < CSFFile_Header->NumLabels && (j == NumThreads - 1 || LengthSum < LengthTotal * (j + 1) / NumThreads))
+        {
+            LengthSum += CSFFile_Header->Label[i]->LabelNameLength + (uint64_t)CSFFile_Header->Label[i]->String->ValueLength;
+            i++;
+        }
+
+        // A job without an arena does nothing, which is only an error if it had Labels to match
+        if(!Jobs[j].Arena && Jobs[j].LabelStart < i)
+        {
+            csf_error(&Jobs[j].Context, CSF_ERROR_MEMORY, "Couldn't allocate memory", "", 0);
+        }
+
+        Jobs[j].LabelEnd = Jobs[j].Arena ? i : Jobs[j].LabelStart;
+    }
+
+    threads_run(NumThreads, CSFSearch_Thread, Jobs, sizeof(CSFSearchJob));
+
+    for(j = 0; j < NumThreads; j++)
+    {
+        if(Jobs[j].Context.Error && !Reader->Context->Error)
+        {
+            *Reader->Context = Jobs[j].Context;
+        }
+
+        if(Jobs[j].Arena)
+        {
+            arena_merge(Arena, Jobs[j].Arena);
+        }
+    }
+
+    for(i = 0, n = 0; i < CSFFile_Header->NumLabels; i++)
+    {
+        n += Match[i];
+    }
+
+    if(!Reader->Context->Error && (Found = arena_alloc(Arena, sizeof(CSFHeader) + n * sizeof(CSFLabel *))))
+    {
+        memcpy(Found, CSFFile_Header, sizeof(CSFHeader));
+
+        Found->NumLabels = 0;
+        Found->NumStrings = 0;
+
+        for(i = 0; i < CSFFile_Header->NumLabels; i++)
+        {
+            if(Match[i])
+            {
+                Found->Label[Found->NumLabels++] = CSFFile_Header->Label[i];
+                Found->NumStrings += CSFFile_Header->Label[i]->NumStringPairs ? 1 : 0;
+            }
+        }
+    }
+
+    free(Match);
+    free(Jobs);
+
+    return Reader->Context->Error ? NULL : Found;
+}
+
+void
+CSFSearch_Free(CSFSearch *Search)
+{
+    // The CSFSearch itself belongs to the caller
+#ifndef _WIN32
+    if(Search->Regex)
+    {
+        regfree(Search->Regex);
+    }
+#endif
+
+    free(Search->Regex);
+    free(Search->Pattern);
+}
@@ -0,0 +1,842 @@
+#include "csftools.h"
+
+static STRReader *
+STRReader_OpenFile(CSFContext *Context, char *STRFile_Path, int InPlace, int Pipelined)
+{
+    STRReader *Reader;
+
+    if(!(Reader = calloc_c(Context, 1, sizeof(STRReader))))
+    {
+        return NULL;
+    }
+
+    Reader->Context = Context;
+    Reader->InPlace = InPlace;
+
+    if(strcmp(STRFile_Path, "-") && !Pipelined)
+    {
+        Reader->Data = fmap(STRFile_Path, &Reader->Size);
+    }
+
+    Reader->Mapped = Reader->Data != NULL;
+
+    if(!Reader->Mapped)
+    {
+        // Not a regular file (i.e. a pipe), so read it the slow way, or ahead of the window on a thread of its own
+        Reader->Capacity = STRREADER_WINDOW_SIZE;
+
+        if(Pipelined)
+        {
+            Reader->Pipe = pipereader_open(Context, STRFile_Path);
+        }
+        else
+        {
+            Reader->Handle = fopen_c(Context, STRFile_Path, "rb");
+        }
+
+        if((!Reader->Handle && !Reader->Pipe) || !(Reader->Data = malloc_c(Context, Reader->Capacity)))
+        {
+            STRReader_Close(Reader);
+            return NULL;
+        }
+    }
+
+    return Reader;
+}
+
+STRReader *
+STRReader_Open(CSFContext *Context, char *STRFile_Path, int InPlace)
+{
+    // Reads a STR file one Label at a time, values are unescaped in place and Labels point straight into the reader's data
+    // Regular files are mapped as a whole, pipes (and - for stdin) are read through a window that only keeps the current Label
+    // With InPlace, Labels of a mapped file stay valid until STRReader_Close, which CSFFileHeader_Create needs
+    // Otherwise the mapping is released as it's read, so memory use stays flat
+    // Returns NULL if the file can't be opened
+    return STRReader_OpenFile(Context, STRFile_Path, InPlace, 0);
+}
+
+STRReader *
+STRReader_OpenPipelined(CSFContext *Context, char *STRFile_Path)
+{
+    // Same as STRReader_Open, but the file is never mapped, a thread reads it a few blocks ahead of the window instead
+    // Reading a mapped file stops at every page that isn't there yet, which takes long on a network drive, this way the disk is waited for while Labels are parsed
+    return STRReader_OpenFile(Context, STRFile_Path, 0, 1);
+}
+
+void
+STRReader_Close(STRReader *Reader)
+{
+    if(Reader == NULL)
+    {
+        return;
+    }
+
+    if(Reader->Mapped)
+    {
+        // What's read through stdio is counted as it's read
+        csf_stats_add(Reader->Context, CSF_STAT_BYTES_READ, Reader->Size);
+        funmap(Reader->Data, Reader->Size);
+    }
+    else
+    {
+        if(Reader->Handle)
+        {
+            fclose_c(Reader->Handle);
+        }
+
+        pipereader_close(Reader->Pipe);
+        free(Reader->Data);
+    }
+
+    free(Reader);
+}
+
+static void
+STRReader_Error(STRReader *Reader, int Error, const char *Message, const char *LabelName, uint32_t LabelNameLength)
+{
+    // Keep the first error together with its line, and stop reading
+    if(Reader->Context->Error == CSF_OK)
+    {
+        csf_error(Reader->Context, Error, Message, LabelName, LabelNameLength);
+        Reader->Context->ErrorLine = Reader->Line;
+    }
+
+    Reader->Offset = Reader->Size;
+    Reader->Eof = 1;
+}
+
+static int
+STRReader_Fill(STRReader *Reader)
+{
+    char *Data;
+    size_t ReadSize;
+
+    // Move the current Label to the start of the window, grow the window if the Label fills it already, then read more of the file
+    // Returns 0 at the end of the file or on an error
+    if(Reader->Mapped || Reader->Eof)
+    {
+        return 0;
+    }
+
+    if(Reader->Keep)
+    {
+        memmove(Reader->Data, Reader->Data + Reader->Keep, Reader->Size - Reader->Keep);
+
+        Reader->Size -= Reader->Keep;
+        Reader->Offset -= Reader->Keep;
+        Reader->Keep = 0;
+    }
+
+    if(Reader->Size == Reader->Capacity)
+    {
+        if(!(Data = realloc_c(Reader->Context, Reader->Data, Reader->Capacity * 2)))
+        {
+            STRReader_Error(Reader, CSF_ERROR_MEMORY, "Couldn't allocate memory", "", 0);
+            return 0;
+        }
+
+        Reader->Capacity *= 2;
+        Reader->Data = Data;
+    }
+
+    if(Reader->Pipe)
+    {
+        ReadSize = pipereader_read(Reader->Pipe, Reader->Data + Reader->Size, Reader->Capacity - Reader->Size);
+    }
+    else
+    {
+        ReadSize = fread(Reader->Data + Reader->Size, 1, Reader->Capacity - Reader->Size, Reader->Handle);
+    }
+
+    Reader->Size += ReadSize;
+
+    csf_stats_add(Reader->Context, CSF_STAT_BYTES_READ, ReadSize);
+
+    if(!ReadSize)
+    {
+        if(Reader->Pipe ? pipereader_error(Reader->Pipe) : ferror(Reader->Handle))
+        {
+            STRReader_Error(Reader, CSF_ERROR_READ, "Couldn't read from STR file", "", 0);
+        }
+
+        Reader->Eof = 1;
+    }
+
+    return ReadSize != 0;
+}
+
+char *
+STRReader_NextLine(STRReader *Reader, size_t *STRFile_Line_Len)
+{
+    char *STRFile_Line, *STRFile_Line_End;
+
+    // Returns the next line trimmed of leading and trailing whitespaces, or NULL at the end of the file
+    // Lines aren't null-terminated and can be of any length, they stay valid until the next STRReader_Next
+    for(;;)
+    {
+        STRFile_Line = Reader->Data + Reader->Offset;
+        STRFile_Line_End = memchr(STRFile_Line, '\n', Reader->Size - Reader->Offset);
+
+        if(STRFile_Line_End || !STRReader_Fill(Reader))
+        {
+            break;
+        }
+    }
+
+    if(Reader->Offset >= Reader->Size)
+    {
+        return NULL;
+    }
+
+    if(!STRFile_Line_End)
+    {
+        STRFile_Line_End = Reader->Data + Reader->Size;
+    }
+
+    Reader->Offset = STRFile_Line_End - Reader->Data + 1;
+    Reader->Line++;
+
+    // Editors like to start UTF-8 files with a byte order mark, it's not part of the first line
+    if(Reader->Line == 1 && STRFile_Line_End - STRFile_Line >= 3 && !memcmp(STRFile_Line, "\xEF\xBB\xBF", 3))
+    {
+        STRFile_Line += 3;
+    }
+
+    while(STRFile_Line < STRFile_Line_End && isspace((unsigned char)*STRFile_Line))
+    {
+        STRFile_Line++;
+    }
+
+    while(STRFile_Line_End > STRFile_Line && isspace((unsigned char)*(STRFile_Line_End - 1)))
+    {
+        STRFile_Line_End--;
+    }
+
+    *STRFile_Line_Len = STRFile_Line_End - STRFile_Line;
+
+    return STRFile_Line;
+}
+
+static int
+STRFile_IsEndLine(char *STRFile_Line, size_t STRFile_Line_Len)
+{
+    return STRFile_Line_Len == 3 && toupper((unsigned char)STRFile_Line[0]) == 'E' && toupper((unsigned char)STRFile_Line[1]) == 'N' && toupper((unsigned char)STRFile_Line[2]) == 'D';
+}
+
+CSFLabel *
+STRReader_Next(STRReader *Reader)
+{
+    CSFLabel *Label = &Reader->Label;
+    CSFString *String = &Reader->String;
+    char *STRFile_Line;
+    size_t STRFile_Line_Len;
+    size_t LabelNameOffset = 0;
+    size_t ValueOffset = 0;
+    size_t ExtraValueOffset = 0;
+    int STRState;
+
+    // Returns the next Label, or NULL after the last one or on an error, which is kept in the reader's context
+    // The Label and its String are overwritten by the next call, copy them if they need to be kept
+    // The window may move while the Label is read, so LabelName and Value are kept as offsets from its start until the END line
+    Reader->Keep = Reader->Offset;
+
+    // Give back the pages that have already been read, they won't be needed again
+    if(Reader->Mapped && !Reader->InPlace && Reader->Offset - Reader->Discarded >= CSFREADER_DISCARD_SIZE)
+    {
+        fmap_discard(Reader->Data + Reader->Discarded, Reader->Offset - Reader->Discarded);
+        Reader->Discarded = Reader->Offset;
+    }
+
+    // Iterate through STR file
+    STRState = STR_STATE_LABEL;
+
+    while((STRFile_Line = STRReader_NextLine(Reader, &STRFile_Line_Len)))
+    {
+        // STRFile_Line is trimmed of leading and trailing whitespaces
+
+        // A label in a STR file is a triplet of lines:
+        // The first one naming the Label
+        // The second one starting and ending with apostrophes containing the String value
+        // The third one containing the case insensitive marker END
+
+        // Only parse line if it actually contains something other than whitespaces
+        // Also skip if it starts with "//"
+        if(STRFile_Line_Len > 0 && !(STRFile_Line_Len > 1 && STRFile_Line[0] == '/' && STRFile_Line[1] == '/'))
+        {
+            switch(STRState)
+            {
+            case STR_STATE_LABEL:
+                // Fill Label with data, LabelName points into the STR file
+                Label->MagicHeader = LBL_MAGIC;
+                Label->NumStringPairs = 1;
+
+                Label->LabelNameLength = STRFile_Line_Len;
+                LabelNameOffset = STRFile_Line - (Reader->Data + Reader->Keep);
+
+                STRState = STR_STATE_VALUE;
+
+                break;
+            case STR_STATE_VALUE:
+                // If this line doesn't start or end with apostrophes the STR file is malformed
+                // STR files do not contain newline chars in String values, a newline is denoted by the string "\n"
+                if(STRFile_Line_Len < 2 || STRFile_Line[0] != '"' || STRFile_Line[STRFile_Line_Len - 1] != '"')
+                {
+                    STRReader_Error(Reader, CSF_ERROR_FORMAT, "Malformed STR file, expected Value at Label ", Reader->Data + Reader->Keep + LabelNameOffset, Label->LabelNameLength);
+
+                    return NULL;
+                }
+                else
+                {
+                    // Fill String with data
+                    // Trim apostrophes from front and end, then unescape the value in place
+                    String->MagicHeader = STR_MAGIC;
+                    String->ValueLength = STRFile_UnescapeValue(STRFile_Line + 1, STRFile_Line_Len - 1 - 1);
+                    String->ExtraValueLength = 0;
+                    ValueOffset = STRFile_Line + 1 - (Reader->Data + Reader->Keep);
+
+                    STRState = STR_STATE_END;
+                }
+
+                break;
+            case STR_STATE_END:
+                // One line between the value and END is the ExtraValue of a STRW String, the game's own STR files name speech files there
+                // It's not quoted, a backslash escapes itself and \xHH any byte, and a line of only a backslash is an empty ExtraValue
+                if(!STRFile_IsEndLine(STRFile_Line, STRFile_Line_Len) && String->MagicHeader == STR_MAGIC)
+                {
+                    String->MagicHeader = STRW_MAGIC;
+                    String->ExtraValueLength = STRFile_Line_Len == 1 && STRFile_Line[0] == '\\' ? 0 : STRFile_UnescapeExtraValue(STRFile_Line, STRFile_Line_Len);
+                    ExtraValueOffset = STRFile_Line - (Reader->Data + Reader->Keep);
+                }
+                // If this line isn't END, my only friend the End, the STR file is malformed
+                else if(!STRFile_IsEndLine(STRFile_Line, STRFile_Line_Len))
+                {
+                    STRReader_Error(Reader, CSF_ERROR_FORMAT, "Malformed STR file, expected END at Label ", Reader->Data + Reader->Keep + LabelNameOffset, Label->LabelNameLength);
+
+                    return NULL;
+                }
+                else
+                {
+                    Label->LabelName = Reader->Data + Reader->Keep + LabelNameOffset;
+                    Label->String = String;
+                    String->Value = Reader->Data + Reader->Keep + ValueOffset;
+                    String->ExtraValue = String->MagicHeader == STRW_MAGIC ? (uint8_t *)Reader->Data + Reader->Keep + ExtraValueOffset : NULL;
+
+                    return Label;
+                }
+
+                break;
+            }
+        }
+    }
+
+    // A Label that isn't finished by the end of the file was silently dropped by older versions, keep doing that but say so
+    if(STRState != STR_STATE_LABEL && !Reader->Context->Error)
+    {
+        csf_log(Reader->Context, CSF_LOG_WARNING, "Label %.*s is incomplete at the end of the STR file, discarding", (int)Label->LabelNameLength, Reader->Data + Reader->Keep + LabelNameOffset);
+    }
+
+    return NULL;
+}
+
+size_t
+STRFile_UnescapeValue(char *StringValue, size_t StringValueLength)
+{
+    char *Src, *Dst, *End, *Escape;
+
+    // Unescape a value in place in a single pass, returns the new length
+    // Unknown escapes and a trailing backslash are kept as they are, STR files written by older versions didn't escape backslashes
+    Src = Dst = StringValue;
+    End = StringValue + StringValueLength;
+
+    while((Escape = memchr(Src, '\\', End - Src)))
+    {
+        // Nothing changes until the first escape, so don't move anything
+        if(Dst != Src)
+        {
+            memmove(Dst, Src, Escape - Src);
+        }
+
+        Dst += Escape - Src;
+        Src = Escape + 1;
+
+        if(Src == End)
+        {
+            *Dst++ = '\\';
+            break;
+        }
+
+        switch(*Src)
+        {
+        case 'n':
+            *Dst++ = '\n';
+            break;
+        case 't':
+            *Dst++ = '\t';
+            break;
+        case '\\':
+        case '"':
+            *Dst++ = *Src;
+            break;
+        default:
+            *Dst++ = '\\';
+            *Dst++ = *Src;
+            break;
+        }
+
+        Src++;
+    }
+
+    if(Dst != Src)
+    {
+        memmove(Dst, Src, End - Src);
+    }
+
+    return (Dst - StringValue) + (End - Src);
+}
+
+static int
+STRFile_HexDigit(char c)
+{
+    if(c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+
+    c = (char)toupper((unsigned char)c);
+
+    return c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+}
+
+size_t
+STRFile_UnescapeExtraValue(char *ExtraValue, size_t ExtraValueLength)
+{
+    char *Src, *Dst, *End;
+
+    // Unescape an ExtraValue in place, returns the new length
+    // \\ is a backslash and \xHH the byte HH, any other backslash is kept as it is
+    Src = Dst = ExtraValue;
+    End = ExtraValue + ExtraValueLength;
+
+    while(Src < End)
+    {
+        if(*Src == '\\' && End - Src >= 2 && Src[1] == '\\')
+        {
+            *Dst++ = '\\';
+            Src += 2;
+        }
+        else if(*Src == '\\' && End - Src >= 4 && Src[1] == 'x' && STRFile_HexDigit(Src[2]) >= 0 && STRFile_HexDigit(Src[3]) >= 0)
+        {
+            *Dst++ = (char)(STRFile_HexDigit(Src[2]) << 4 | STRFile_HexDigit(Src[3]));
+            Src += 4;
+        }
+        else
+        {
+            *Dst++ = *Src++;
+        }
+    }
+
+    return Dst - ExtraValue;
+}
+
+CSFHeader *
+CSFFileHeader_Create(STRReader *Reader, uint32_t LanguageId, CSFArena *Arena, CSFIntern *Intern)
+{
+    CSFHeader *CSFFile_Header = NULL;
+    CSFHeader *CSFFile_Header_Old = NULL;
+    CSFLabel *Label = NULL;
+    CSFString *String = NULL;
+    CSFLabel *ReaderLabel = NULL;
+    uint32_t CSFFile_Header_AllocSize = 10000;
+    int Copy;
+
+    // Read all Labels of a STR file into memory, everything is allocated from Arena
+    // Labels of a mapped file opened with InPlace point into the mapping, so the reader has to stay open as long as they're used
+    // With Intern, Labels with the same value share one String (and one copy of the value, if it's copied), Intern has to allocate from Arena as well
+    // Returns NULL on an error, whatever was allocated until then is released with the arena
+    if(!(CSFFile_Header = arena_alloc(Arena, sizeof(CSFHeader) + (CSFFile_Header_AllocSize * sizeof(CSFLabel *)))))
+    {
+        return NULL;
+    }
+
+    CSFFileHeader_Init(CSFFile_Header, LanguageId);
+
+    // Everything that's in the window of a pipe or might be discarded needs to be copied
+    Copy = !Reader->Mapped || !Reader->InPlace;
+
+    while((ReaderLabel = STRReader_Next(Reader)))
+    {
+        if(!(Label = arena_alloc(Arena, sizeof(CSFLabel))))
+        {
+            return NULL;
+        }
+
+        *Label = *ReaderLabel;
+
+        if(Copy)
+        {
+            if(!(Label->LabelName = arena_alloc(Arena, Label->LabelNameLength)))
+            {
+                return NULL;
+            }
+
+            memcpy(Label->LabelName, ReaderLabel->LabelName, Label->LabelNameLength);
+        }
+
+        if(Intern)
+        {
+            if(!(String = CSFIntern_Add(Intern, ReaderLabel->String, Copy)))
+            {
+                return NULL;
+            }
+        }
+        else
+        {
+            if(!(String = arena_alloc(Arena, sizeof(CSFString))))
+            {
+                return NULL;
+            }
+
+            *String = *ReaderLabel->String;
+
+            if(Copy)
+            {
+                if(!(String->Value = arena_alloc(Arena, String->ValueLength)))
+                {
+                    return NULL;
+                }
+
+                memcpy(String->Value, ReaderLabel->String->Value, String->ValueLength);
+
+                if(String->ExtraValue && !(String->ExtraValue = arena_alloc(Arena, String->ExtraValueLength)))
+                {
+                    return NULL;
+                }
+
+                if(String->ExtraValue)
+                {
+                    memcpy(String->ExtraValue, ReaderLabel->String->ExtraValue, String->ExtraValueLength);
+                }
+            }
+        }
+
+        Label->String = String;
+
+        // Check if the alloc'd memory is still big enough, if not allocate twice as much and copy the old header over
+        // The old header stays in the arena, but that's never more memory than the final header takes
+        if(CSFFile_Header->NumLabels == CSFFile_Header_AllocSize)
+        {
+            CSFFile_Header_AllocSize *= 2;
+            csf_stats_add(Reader->Context, CSF_STAT_LABEL_GROWTHS, 1);
+            CSFFile_Header_Old = CSFFile_Header;
+
+            if(!(CSFFile_Header = arena_alloc(Arena, sizeof(CSFHeader) + (CSFFile_Header_AllocSize * sizeof(CSFLabel *)))))
+            {
+                return NULL;
+            }
+
+            memcpy(CSFFile_Header, CSFFile_Header_Old, sizeof(CSFHeader) + (CSFFile_Header_Old->NumLabels * sizeof(CSFLabel *)));
+        }
+
+        // Add Label to CSFHeader, increase NumLabels and NumStrings
+        CSFFile_Header->Label[CSFFile_Header->NumLabels] = Label;
+
+        CSFFile_Header->NumLabels++;
+        CSFFile_Header->NumStrings++;
+    }
+
+    if(Reader->Context->Error)
+    {
+        return NULL;
+    }
+
+    return CSFFile_Header;
+}
+
+static size_t
+STRFile_FindLabelBoundary(char *STRFile_Data, size_t STRFile_Size, size_t Offset)
+{
+    char *STRFile_Line, *STRFile_Line_End;
+    int PreviousIsValue = -1;
+
+    // Find the first place after Offset where a new Label starts for sure, or STRFile_Size if there is none
+    // That's right after an END line, but a Label could be called END as well, so it only counts if the line before it was a value
+    // A Label can't be a value, and an END line before a Label named END isn't one either, so that can't go wrong in a valid STR file
+    // Start at the next full line, we don't know what the line before was so it can't count yet
+    if(Offset && !(STRFile_Line = memchr(STRFile_Data + Offset - 1, '\n', STRFile_Size - Offset + 1)))
+    {
+        return STRFile_Size;
+    }
+
+    Offset = Offset ? (size_t)(STRFile_Line - STRFile_Data + 1) : 0;
+
+    while(Offset < STRFile_Size)
+    {
+        STRFile_Line = STRFile_Data + Offset;
+
+        if(!(STRFile_Line_End = memchr(STRFile_Line, '\n', STRFile_Size - Offset)))
+        {
+            return STRFile_Size;
+        }
+
+        Offset = STRFile_Line_End - STRFile_Data + 1;
+
+        // Trim the line, same as STRReader_NextLine
+        while(STRFile_Line < STRFile_Line_End && isspace((unsigned char)*STRFile_Line))
+        {
+            STRFile_Line++;
+        }
+
+        while(STRFile_Line_End > STRFile_Line && isspace((unsigned char)*(STRFile_Line_End - 1)))
+        {
+            STRFile_Line_End--;
+        }
+
+        // Blank lines and comments don't count
+        if(STRFile_Line_End == STRFile_Line || (STRFile_Line_End - STRFile_Line > 1 && STRFile_Line[0] == '/' && STRFile_Line[1] == '/'))
+        {
+            continue;
+        }
+
+        if(PreviousIsValue == 1 && STRFile_IsEndLine(STRFile_Line, STRFile_Line_End - STRFile_Line))
+        {
+            return Offset;
+        }
+
+        PreviousIsValue = STRFile_Line_End - STRFile_Line >= 2 && STRFile_Line[0] == '"' && *(STRFile_Line_End - 1) == '"';
+    }
+
+    return STRFile_Size;
+}
+
+static void *
+CSFFileHeader_CreateThread(void *Args)
+{
+    CSFParseJob *Job = Args;
+
+    // The arena or the intern table couldn't be created, the error is in the job's context already
+    if(Job->Arena && !Job->Context.Error)
+    {
+        Job->CSFFile_Header = CSFFileHeader_Create(&Job->Reader, Job->LanguageId, Job->Arena, Job->Intern);
+    }
+
+    return NULL;
+}
+
+CSFHeader *
+CSFFileHeader_CreateParallel(STRReader *Reader, uint32_t LanguageId, CSFArena *Arena, CSFIntern *Intern, int NumThreads)
+{
+    CSFHeader *CSFFile_Header = NULL;
+    CSFParseJob *Jobs = NULL;
+    size_t ChunkStart, ChunkEnd;
+    uint32_t NumLabels = 0;
+    uint32_t Line = 0;
+    int i;
+
+    // Same as CSFFileHeader_Create, but the STR file is cut into chunks at Label boundaries which are parsed on NumThreads threads
+    // Each thread parses its chunk with a reader, a context and an arena of its own, the Labels of all chunks are put together in order afterwards
+    // Only works for mapped files opened with InPlace, everything else is parsed like CSFFileHeader_Create does
+    // Log of the reader's context may be called from any of the threads
+    // With Intern, every thread interns its own chunk and they're merged into Intern afterwards, so a value is shared at most once per thread
+    if(!Reader->Mapped || !Reader->InPlace || NumThreads < 2)
+    {
+        return CSFFileHeader_Create(Reader, LanguageId, Arena, Intern);
+    }
+
+    if(!(Jobs = calloc_c(Reader->Context, NumThreads, sizeof(CSFParseJob))))
+    {
+        return NULL;
+    }
+
+    for(i = 0, ChunkStart = 0; i < NumThreads; i++, ChunkStart = ChunkEnd)
+    {
+        ChunkEnd = i == NumThreads - 1 ? Reader->Size : STRFile_FindLabelBoundary(Reader->Data, Reader->Size, Reader->Size / NumThreads * (i + 1));
+
+        if(ChunkEnd < ChunkStart)
+        {
+            ChunkEnd = ChunkStart;
+        }
+
+        Jobs[i].Context.Log = Reader->Context->Log;
+        Jobs[i].Context.UserData = Reader->Context->UserData;
+        Jobs[i].Context.Stats = Reader->Context->Stats;
+        Jobs[i].Reader.Context = &Jobs[i].Context;
+        Jobs[i].Reader.Data = Reader->Data + ChunkStart;
+        Jobs[i].Reader.Size = ChunkEnd - ChunkStart;
+        Jobs[i].Reader.Mapped = 1;
+        Jobs[i].Reader.InPlace = 1;
+        Jobs[i].LanguageId = LanguageId;
+        Jobs[i].Arena = arena_create(&Jobs[i].Context, Jobs[i].Reader.Size / 32 * (sizeof(CSFLabel *) + sizeof(CSFLabel) + sizeof(CSFString)));
+
+        if(Intern && Jobs[i].Arena)
+        {
+            Jobs[i].Intern = CSFIntern_Create(&Jobs[i].Context, Jobs[i].Arena, Jobs[i].Reader.Size);
+        }
+    }
+
+    threads_run(NumThreads, CSFFileHeader_CreateThread, Jobs, sizeof(CSFParseJob));
+
+    // Hand the first error over to the caller's context, line numbers of a chunk start at its own beginning, so add up the lines of all chunks before it
+    for(i = 0; i < NumThreads; i++)
+    {
+        if(Jobs[i].Context.Error)
+        {
+            *Reader->Context = Jobs[i].Context;
+            Reader->Context->ErrorLine += Line;
+
+            break;
+        }
+
+        Line += Jobs[i].Reader.Line;
+        NumLabels += Jobs[i].CSFFile_Header->NumLabels;
+    }
+
+    if(!Reader->Context->Error && (CSFFile_Header = arena_alloc(Arena, sizeof(CSFHeader) + (NumLabels * sizeof(CSFLabel *)))))
+    {
+        CSFFileHeader_Init(CSFFile_Header, LanguageId);
+
+        // Put the Labels of all chunks together
+        for(i = 0; i < NumThreads; i++)
+        {
+            memcpy(CSFFile_Header->Label + CSFFile_Header->NumLabels, Jobs[i].CSFFile_Header->Label, Jobs[i].CSFFile_Header->NumLabels * sizeof(CSFLabel *));
+
+            CSFFile_Header->NumLabels += Jobs[i].CSFFile_Header->NumLabels;
+            CSFFile_Header->NumStrings += Jobs[i].CSFFile_Header->NumLabels;
+        }
+    }
+
+    // Hand the arenas of all threads over to the caller's one, so they're released with it even on an error, the interned Strings of each thread are in there as well
+    for(i = 0; i < NumThreads; i++)
+    {
+        if(CSFFile_Header && Jobs[i].Intern)
+        {
+            CSFIntern_Merge(Intern, Jobs[i].Intern);
+        }
+
+        CSFIntern_Free(Jobs[i].Intern);
+
+        if(Jobs[i].Arena)
+        {
+            arena_merge(Arena, Jobs[i].Arena);
+        }
+    }
+
+    free(Jobs);
+
+    // Merging the intern tables can run out of memory as well
+    if(Reader->Context->Error)
+    {
+        return NULL;
+    }
+
+    return CSFFile_Header;
+}
+
+void
+STRFile_WriteLabel(CSFWriteBuffer *STRFile_Buffer, CSFLabel *Label)
+{
+    // A label in a STR file is a triplet of lines:
+    // The first one naming the Label
+    // The second one starting and ending with apostrophes containing the String value
+    // The third one containing the marker END
+
+    // Write LabelName to file
+    writebuffer_write(STRFile_Buffer, Label->LabelName, Label->LabelNameLength);
+    writebuffer_puts(STRFile_Buffer, "\r\n");
+
+    // StringValues in STR files are contained by apostrophes
+    writebuffer_puts(STRFile_Buffer, "\"");
+    STRFile_WriteValue(STRFile_Buffer, Label->String->Value, Label->String->ValueLength);
+    writebuffer_puts(STRFile_Buffer, "\"\r\n");
+
+    // The ExtraValue of a STRW String gets a line of its own before END
+    if(Label->String->MagicHeader == STRW_MAGIC)
+    {
+        STRFile_WriteExtraValue(STRFile_Buffer, Label->String->ExtraValue, Label->String->ExtraValueLength);
+        writebuffer_puts(STRFile_Buffer, "\r\n");
+    }
+
+    // Write END to file to denote the end of this label with an empty line afterwards
+    writebuffer_puts(STRFile_Buffer, "END\r\n\r\n");
+}
+
+void
+STRFile_WriteValue(CSFWriteBuffer *STRFile_Buffer, const char *StringValue, size_t StringValueLength)
+{
+    const char *StringValueEnd, *StringValueLF, *StringValueBS, *Escape;
+
+    // A value ends at its first null char, if it has one
+    if((StringValueEnd = memchr(StringValue, '\0', StringValueLength)))
+    {
+        StringValueLength = StringValueEnd - StringValue;
+    }
+
+    StringValueEnd = StringValue + StringValueLength;
+
+    // STR files do not contain newline chars in String values, a newline is denoted by the string "\n"
+    // Backslashes are escaped as "\\" so they can't be mistaken for an escape, so we:
+    // Find the next newline or backslash, write everything up to it in one go, then write its escape instead
+    // Each memchr result is kept until it's been written, so the value is only scanned once for each char
+    StringValueLF = memchr(StringValue, '\n', StringValueLength);
+    StringValueBS = memchr(StringValue, '\\', StringValueLength);
+
+    while(StringValueLF || StringValueBS)
+    {
+        Escape = !StringValueBS || (StringValueLF && StringValueLF < StringValueBS) ? StringValueLF : StringValueBS;
+
+        writebuffer_write(STRFile_Buffer, StringValue, Escape - StringValue);
+        writebuffer_puts(STRFile_Buffer, *Escape == '\n' ? "\\n" : "\\\\");
+
+        StringValue = Escape + 1;
+
+        if(Escape == StringValueLF)
+        {
+            StringValueLF = memchr(StringValue, '\n', StringValueEnd - StringValue);
+        }
+        else
+        {
+            StringValueBS = memchr(StringValue, '\\', StringValueEnd - StringValue);
+        }
+    }
+
+    writebuffer_write(STRFile_Buffer, StringValue, StringValueEnd - StringValue);
+}
+
+void
+STRFile_WriteExtraValue(CSFWriteBuffer *STRFile_Buffer, const uint8_t *ExtraValue, size_t ExtraValueLength)
+{
+    char Escape[5];
+    size_t Start, i;
+
+    // Printable chars are written as they are, everything else (including spaces, which would be trimmed) as \xHH
+    // An ExtraValue that would be read as END or a comment gets its first char escaped, an empty one is a single backslash
+    if(!ExtraValueLength)
+    {
+        writebuffer_puts(STRFile_Buffer, "\\");
+        return;
+    }
+
+    for(Start = 0, i = 0; i < ExtraValueLength; i++)
+    {
+        if(ExtraValue[i] > ' ' && ExtraValue[i] < 0x7F && ExtraValue[i] != '\\'
+            && !(i == 0 && ((ExtraValueLength > 1 && ExtraValue[0] == '/' && ExtraValue[1] == '/') || STRFile_IsEndLine((char *)ExtraValue, ExtraValueLength))))
+        {
+            continue;
+        }
+
+        writebuffer_write(STRFile_Buffer, ExtraValue + Start, i - Start);
+
+        if(ExtraValue[i] == '\\')
+        {
+            writebuffer_puts(STRFile_Buffer, "\\\\");
+        }
+        else
+        {
+            sprintf(Escape, "\\x%02X", ExtraValue[i]);
+            writebuffer_puts(STRFile_Buffer, Escape);
+        }
+
+        Start = i + 1;
+    }
+
+    writebuffer_write(STRFile_Buffer, ExtraValue + Start, ExtraValueLength - Start);
+}
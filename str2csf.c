@@ -1,264 +1,271 @@
 #include "csftools.h"
 
-int
-main(int argc, char *argv[])
-{
-    // Not enough args
-    if(argc < 4)
-    {
-        printf_help_exit();
-    }
+#define TOOLNAME "str2csf"
 
-    printf("\n");
+static void
+printf_help_exit()
+{
+    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+    printf("%s supports the following arguments:\n\n", TOOLNAME);
+    printf("%s [-j threads] [-i] <str input> <csf output> <lang> to convert a str file to a csf file\n", TOOLNAME);
+    printf("%s [-j threads] [-i] -b <list> to convert every str input, csf output and lang in list\n", TOOLNAME);
+    printf("%s [-j threads] [-i] -d <directory> [-g pattern] <lang> to convert every str file in directory\n", TOOLNAME);
+    printf("%s [-j threads] [-i] --incremental <old csf> <str input> <csf output> <lang> to only encode what changed since old csf\n", TOOLNAME);
+    printf("inputs ending in .json, .csv or .po are read in that format instead, like csf2str writes them\n");
+    printf("-j parses the str file on the given number of threads, or converts that many files at once\n");
+    printf("-i also writes a .csfidx index file next to the csf file\n");
+    printf("--pipeline reads, encodes and writes on separate threads instead of mapping the input, for network drives\n");
+    printf("--stats prints how long each part took, how much was read and written and how much memory was allocated\n");
+    printf("--stats-json <file> writes the same as json, - for stdout\n");
+    printf("-g only converts the files matching pattern, *.str by default\n");
+    printf("please refer to the readme for the available languages\n");
+    printf("use - as input or output to read from stdin or write to stdout\n\n");
+    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
+    exit(1);
+}
 
-    // Exits on failure
-    STRFile_ConvertToCSFFile(argv[1], argv[2], argv[3]);
+static void
+printf_log(CSFContext *Context, int Level, const char *Message)
+{
+    fprintf(Context->UserData, "%s%s\n", Level == CSF_LOG_WARNING ? "Warning: " : "", Message);
+}
 
-    printf("\nSuccessfully converted %s to %s\n", argv[1], argv[2]);
+static void
+printf_log_batch(CSFContext *Context, int Level, const char *Message)
+{
+    CSFBatchJob *Job = Context->UserData;
 
-    return 0;
+    // Jobs run at the same time, so only warnings are printed, with the file they're about
+    if(Level == CSF_LOG_WARNING)
+    {
+        fprintf(Job->Batch->UserData, "Warning: %s: %s\n", Job->InputPath, Message);
+    }
 }
 
-void
-STRFile_ConvertToCSFFile(char *STRFile_Path, char *CSFFile_Path, char *LanguageString)
+static void
+printf_error(FILE *Stream, const char *Path, CSFContext *Context)
 {
-    FILE *STRFile_Handle, *CSFFile_Handle;
-    CSFHeader *CSFFile_Header = NULL;
-    CSFLabel *Label = NULL;
-    uint32_t LanguageId;
-    int i;
+    fprintf(Stream, "Error: ");
 
-    // Get LanguageId from argument
-    LanguageId = CSFFile_GetLanguageId(LanguageString);
-
-    if((int32_t)LanguageId == CSF_LANGUAGE_UNKNOWN)
+    if(Path)
     {
-        printf_error_exit("Unsupported language string, please refer to the readme for the available languages", "");
+        fprintf(Stream, "%s: ", Path);
     }
 
-    printf("Creating CSF file with language '%s'\n", LanguageString);
+    fprintf(Stream, "%s%s", Context->ErrorMessage, Context->ErrorDetail);
 
-    // Open STR file
-    STRFile_Handle = fopen_d(STRFile_Path, "rb");
+    if(Context->ErrorLine)
+    {
+        fprintf(Stream, " in line %u", Context->ErrorLine);
+    }
 
-    // Create CSFFile header from STR file
-    CSFFile_Header = CSFFileHeader_Create(STRFile_Handle, LanguageId);
+    fprintf(Stream, "\n");
+}
 
-    // Close STR file
-    fclose(STRFile_Handle);
+static int
+convert_batch(char *ListFile_Path, char *Directory, char *Pattern, char *LanguageString, int NumThreads, int WriteIndex, int Pipelined, CSFStats *Stats, FILE *Stream)
+{
+    CSFContext Context;
+    CSFBatch *Batch;
+    uint32_t NumFailed, i;
 
-    // Open output CSF file
-    CSFFile_Handle = fopen_d(CSFFile_Path, "wb");
+    CSFContext_Init(&Context);
+    Context.Stats = Stats;
 
-    // Write CSFHeader to file
-    fwrite(CSFFile_Header, sizeof(CSFHeader), 1, CSFFile_Handle);
+    fprintf(Stream, "\n");
 
-    // Iterate through labels
-    for(i = 0; i < CSFFile_Header->NumLabels; i++)
+    if(!(Batch = CSFBatch_Create(&Context, 1))
+        || (ListFile_Path && CSFBatch_AddList(Batch, ListFile_Path))
+        || (Directory && CSFBatch_AddDirectory(Batch, Directory, Pattern ? Pattern : "*.str", LanguageString)))
     {
-        Label = CSFFile_Header->Label[i];
+        printf_error(Stream, NULL, &Context);
+        CSFBatch_Free(Batch);
 
-        // Write Label struct members one by one to file due to alignment issues when compiling for x86_64
-        fwrite(&Label->MagicHeader, sizeof(Label->MagicHeader), 1, CSFFile_Handle);
-        fwrite(&Label->NumStringPairs, sizeof(Label->NumStringPairs), 1, CSFFile_Handle);
-        fwrite(&Label->LabelNameLength, sizeof(Label->LabelNameLength), 1, CSFFile_Handle);
+        return 1;
+    }
 
-        // Write non-null-terminated LabelName to file
-        fwrite(Label->LabelName, Label->LabelNameLength, 1, CSFFile_Handle);
+    Batch->WriteIndex = WriteIndex;
+    Batch->Pipelined = Pipelined;
+    Batch->Log = printf_log_batch;
+    Batch->UserData = Stream;
 
-        // Write String header to file
-        fwrite(Label->String, sizeof(CSFString) - sizeof(Label->String->Value), 1, CSFFile_Handle);
+    NumFailed = CSFBatch_Run(Batch, NumThreads);
 
-        // Write non-null-terminated String value to file, in the file it is a notted unicode string
-        // So not every char and add a notted '\0' after
-        while(*Label->String->Value)
+    // Results are printed in the order of the list, no matter which file was done first
+    for(i = 0; i < Batch->NumJobs; i++)
+    {
+        if(Batch->Job[i].Context.Error)
         {
-            fputc(~(*Label->String->Value), CSFFile_Handle);
-            fputc(~('\0'), CSFFile_Handle);
-
-            Label->String->Value++;
+            printf_error(Stream, Batch->Job[i].InputPath, &Batch->Job[i].Context);
+        }
+        else
+        {
+            fprintf(Stream, "Converted %s to %s\n", Batch->Job[i].InputPath, Batch->Job[i].OutputPath);
         }
     }
 
-    // Close output CSF file, done
-    fclose(CSFFile_Handle);
+    if(NumFailed)
+    {
+        fprintf(Stream, "\n%u of %u files failed to convert\n", NumFailed, Batch->NumJobs);
+    }
+    else
+    {
+        fprintf(Stream, "\nSuccessfully converted %u files\n", Batch->NumJobs);
+    }
+
+    CSFBatch_Free(Batch);
+
+    return NumFailed != 0;
 }
 
-CSFHeader *
-CSFFileHeader_Create(FILE *STRFile_Handle, uint32_t LanguageId)
+int
+main(int argc, char *argv[])
 {
-    CSFHeader *CSFFile_Header = NULL;
-    CSFLabel *Label = NULL;
-    CSFString *String = NULL;
-    char STRFile_Line[LINE_MAX];
-    char *StringValue = NULL;
-    char *StringValueLF = NULL;
-    int STRFile_Line_Len, STRState;
-    int CSFFile_Header_AllocSize = 10000;
-
-    // Initial header malloc
-    CSFFile_Header = malloc_d(sizeof(CSFHeader) + (CSFFile_Header_AllocSize * sizeof(CSFLabel *)));
-
-    // Set some default values, NumLabels and NumStrings will be updated while reading STR file
-    CSFFile_Header->MagicHeader = CSF_MAGIC;
-    CSFFile_Header->CSFVersion = CSF_VERSION_3;
-    CSFFile_Header->NumLabels = 0;
-    CSFFile_Header->NumStrings = 0;
-    CSFFile_Header->Unknown = 0;
-    CSFFile_Header->Language = LanguageId;
-
-    // Iterate through STR file
-    STRState = STR_STATE_LABEL;
-
-    while(fgets_t(STRFile_Line, LINE_MAX, STRFile_Handle))
-    {
-        // STRFile_Line is trimmed of leading and trailing whitespaces
-        STRFile_Line_Len = strlen(STRFile_Line);
-
-        // A label in a STR file is a triplet of lines:
-        // The first one naming the Label
-        // The second one starting and ending with apostrophes containing the String value
-        // The third one containing the case insensitive marker END
+    CSFContext Context;
+    char *ListFile_Path = NULL;
+    char *Directory = NULL;
+    char *Pattern = NULL;
+    char *PreviousCSFFile_Path = NULL;
+    int NumThreads = 1;
+    int WriteIndex = 0;
+    int Pipelined = 0;
+    int Error;
+    CSFStats StatsBuffer;
+    CSFStats *Stats = NULL;
+    char *StatsFile_Path = NULL;
+    int PrintStats = 0;
+    FILE *Stream;
+    int i;
 
-        // Only parse line if it actually contains something other than whitespaces
-        // Also skip if it starts with "//"
-        if(STRFile_Line_Len > 0 && (STRFile_Line[0] != '/' && STRFile_Line[1] != '/'))
+    // Options come first, a lone - is a file name
+    for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if(!strcmp(argv[i], "-j") && i + 1 < argc)
         {
-            switch(STRState)
+            NumThreads = atoi(argv[++i]);
+
+            if(NumThreads < 1)
             {
-            case STR_STATE_LABEL:
-                // Create Label, fill with data and copy Line contents into LabelName
-                Label = malloc_d(sizeof(CSFLabel));
-
-                Label->MagicHeader = LBL_MAGIC;
-                Label->NumStringPairs = 1;
-
-                Label->LabelNameLength = STRFile_Line_Len;
-                Label->LabelName = malloc_d(STRFile_Line_Len + 1);
-
-                strcpy(Label->LabelName, STRFile_Line);
-
-                STRState = STR_STATE_VALUE;
-
-                break;
-            case STR_STATE_VALUE:
-                // If this line doesn't start or end with apostrophes the STR file is malformed
-                // STR files do not contain newline chars in String values, a newline is denoted by the string "\n"
-                if(STRFile_Line[0] != '"' || STRFile_Line[STRFile_Line_Len - 1] != '"')
-                {
-                    printf_error_exit("Malformed STR file, expected Value at Label ", Label->LabelName);
-                }
-                else
-                {
-                    // Create String for Label, fill with data
-                    // Take care of newline strings, then trim apostrophes from front and end, then finally add new values to String
-                    // Finally add String to Label
-                    String = malloc_d(sizeof(CSFString));
-
-                    String->MagicHeader = STR_MAGIC;
-
-                    StringValue = malloc_d(STRFile_Line_Len + 1);
-                    strcpy(StringValue, STRFile_Line);
-
-                    while((StringValueLF = strstr(StringValue, "\\n")))
-                    {
-                        *StringValueLF = '\0';
-                        *(++StringValueLF) = '\n';
-
-                        strcat(StringValue, StringValueLF);
-
-                        STRFile_Line_Len--;
-                    }
-
-                    StringValue[STRFile_Line_Len - 1] = '\0';
-                    StringValue++;
-
-                    String->ValueLength = STRFile_Line_Len - 1 - 1;
-                    String->Value = StringValue;
-
-                    Label->String = String;
-
-                    STRState = STR_STATE_END;
-                }
-
-                break;
-            case STR_STATE_END:
-                // If this line isn't END, my only friend the End, the STR file is malformed
-                if(strcmp(strupr(STRFile_Line), "END"))
-                {
-                    printf_error_exit("Malformed STR file, expected END at Label ", Label->LabelName);
-                }
-                else
-                {
-                    // Check if the alloc'd memory is still big enough, if not allocate twice as much
-                    if(CSFFile_Header->NumLabels == CSFFile_Header_AllocSize)
-                    {
-                        CSFFile_Header_AllocSize *= 2;
-                        CSFFile_Header = realloc_d(CSFFile_Header, sizeof(CSFHeader) + (CSFFile_Header_AllocSize * sizeof(CSFLabel *)));
-                    }
-
-                    // Add Label to CSFHeader, increase NumLabels and NumStrings
-                    CSFFile_Header->Label[CSFFile_Header->NumLabels] = Label;
-
-                    CSFFile_Header->NumLabels++;
-                    CSFFile_Header->NumStrings++;
-
-                    STRState = STR_STATE_LABEL;
-                }
-
-                break;
+                printf_help_exit();
             }
         }
+        else if(!strcmp(argv[i], "-i"))
+        {
+            WriteIndex = 1;
+        }
+        else if(!strcmp(argv[i], "--pipeline"))
+        {
+            Pipelined = 1;
+        }
+        else if(!strcmp(argv[i], "-b") && i + 1 < argc)
+        {
+            ListFile_Path = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-d") && i + 1 < argc)
+        {
+            Directory = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-g") && i + 1 < argc)
+        {
+            Pattern = argv[++i];
+        }
+        else if(!strcmp(argv[i], "--stats"))
+        {
+            PrintStats = 1;
+        }
+        else if(!strcmp(argv[i], "--stats-json") && i + 1 < argc)
+        {
+            StatsFile_Path = argv[++i];
+        }
+        else if(!strcmp(argv[i], "--incremental") && i + 1 < argc)
+        {
+            PreviousCSFFile_Path = argv[++i];
+        }
+        else
+        {
+            printf_help_exit();
+        }
     }
 
-    return CSFFile_Header;
-}
-
-uint32_t
-CSFFile_GetLanguageId(char *LanguageString)
-{
-    if(!strcmp(CSF_LANGUAGE_STRING_ENUS, LanguageString))
-    {
-        return CSF_LANGUAGE_ID_ENUS;
-    }
-    else if(!strcmp(CSF_LANGUAGE_STRING_ENUK, LanguageString))
-    {
-        return CSF_LANGUAGE_ID_ENUK;
-    }
-    else if(!strcmp(CSF_LANGUAGE_STRING_DE, LanguageString))
-    {
-        return CSF_LANGUAGE_ID_DE;
-    }
-    else if(!strcmp(CSF_LANGUAGE_STRING_FRFR, LanguageString))
-    {
-        return CSF_LANGUAGE_ID_FRFR;
-    }
-    else if(!strcmp(CSF_LANGUAGE_STRING_ES, LanguageString))
-    {
-        return CSF_LANGUAGE_ID_ES;
-    }
-    else if(!strcmp(CSF_LANGUAGE_STRING_IT, LanguageString))
+    if(PrintStats || StatsFile_Path)
     {
-        return CSF_LANGUAGE_ID_IT;
+        memset(&StatsBuffer, 0, sizeof(CSFStats));
+        Stats = &StatsBuffer;
     }
-    else if(!strcmp(CSF_LANGUAGE_STRING_JA, LanguageString))
-    {
-        return CSF_LANGUAGE_ID_JA;
-    }
-    else if(!strcmp(CSF_LANGUAGE_STRING_JW, LanguageString))
+
+    // Messages go to stdout, unless the stats json or one of the outputs goes there
+    Stream = StatsFile_Path && !strcmp(StatsFile_Path, "-") ? stderr : stdout;
+
+    // Batches take all of their files from the list or the directory, the language of a directory is the only argument
+    if(ListFile_Path || Directory)
     {
-        return CSF_LANGUAGE_ID_JW;
+        if(argc - i != (Directory != NULL) || PreviousCSFFile_Path)
+        {
+            printf_help_exit();
+        }
+
+        Error = convert_batch(ListFile_Path, Directory, Pattern, Directory ? argv[i] : NULL, NumThreads, WriteIndex, Pipelined, Stats, Stream);
     }
-    else if(!strcmp(CSF_LANGUAGE_STRING_KO, LanguageString))
+    else
     {
-        return CSF_LANGUAGE_ID_KO;
+        // Not enough args
+        if(argc - i < 3 || Pattern)
+        {
+            printf_help_exit();
+        }
+
+        // An index points into the CSF file, so there needs to be one
+        if(WriteIndex && !strcmp(argv[i + 1], "-"))
+        {
+            printf_help_exit();
+        }
+
+        if(!strcmp(argv[i + 1], "-"))
+        {
+            Stream = stderr;
+        }
+
+        CSFContext_Init(&Context);
+        Context.Log = printf_log;
+        Context.UserData = Stream;
+        Context.Stats = Stats;
+
+        fprintf(Stream, "\n");
+
+        if(PreviousCSFFile_Path)
+        {
+            STRFile_ConvertToCSFFileIncremental(&Context, argv[i], argv[i + 1], argv[i + 2], PreviousCSFFile_Path, NumThreads, Pipelined);
+        }
+        else
+        {
+            STRFile_ConvertToCSFFile(&Context, argv[i], argv[i + 1], argv[i + 2], NumThreads, Pipelined);
+        }
+
+        if((Error = Context.Error || (WriteIndex && CSFIndexFile_Write(&Context, argv[i + 1], NULL))))
+        {
+            printf_error(Stream, NULL, &Context);
+        }
+        else
+        {
+            fprintf(Stream, "\nSuccessfully converted %s to %s\n", argv[i], argv[i + 1]);
+        }
     }
-    else if(!strcmp(CSF_LANGUAGE_STRING_CN, LanguageString))
+
+    if(PrintStats)
     {
-        return CSF_LANGUAGE_ID_CN;
+        csf_stats_print(Stream, Stats);
     }
-    else
+
+    if(StatsFile_Path)
     {
-        return CSF_LANGUAGE_UNKNOWN;
+        CSFContext_Init(&Context);
+
+        if(csf_stats_write_json(&Context, StatsFile_Path, TOOLNAME, Stats))
+        {
+            printf_error(stderr, NULL, &Context);
+            Error = 1;
+        }
     }
+
+    return Error != 0;
 }
@@ -0,0 +1,326 @@
+#include "csftools.h"
+
+static int
+CSFTable_Grow(CSFTable *Table, uint32_t Capacity)
+{
+    uint32_t **Array[5] = { &Table->NameOffset, &Table->NameLength, &Table->ValueOffset, &Table->ValueLength, &Table->ExtraValueLength };
+    uint32_t *Grown;
+    uint8_t *Flags;
+    int i;
+
+    // Every array gets room for Capacity Labels, if one of them can't grow the ones before it are just larger than needed
+    for(i = 0; i < 5; i++)
+    {
+        if(!(Grown = realloc_c(Table->Context, *Array[i], Capacity * sizeof(uint32_t))))
+        {
+            return Table->Context->Error;
+        }
+
+        *Array[i] = Grown;
+    }
+
+    if(!(Flags = realloc_c(Table->Context, Table->Flags, Capacity)))
+    {
+        return Table->Context->Error;
+    }
+
+    // Only growing past the first guess counts, same as for CSFFileHeader_Create
+    if(Table->Capacity)
+    {
+        csf_stats_add(Table->Context, CSF_STAT_LABEL_GROWTHS, 1);
+    }
+
+    Table->Flags = Flags;
+    Table->Capacity = Capacity;
+
+    return CSF_OK;
+}
+
+static int
+CSFTable_GrowBlob(CSFTable *Table, size_t Size)
+{
+    uint8_t *Blob;
+    size_t Capacity;
+
+    // Offsets are 32 bit, which is plenty for any file the game can read
+    if(Size > UINT32_MAX - Table->BlobSize)
+    {
+        return csf_error(Table->Context, CSF_ERROR_MEMORY, "Labels of the CSF table are larger than 4 GB", "", 0);
+    }
+
+    for(Capacity = Table->BlobCapacity ? Table->BlobCapacity : ARENA_BLOCK_MIN; Capacity < Table->BlobSize + Size; Capacity *= 2);
+
+    if(Capacity > UINT32_MAX)
+    {
+        Capacity = UINT32_MAX;
+    }
+
+    if(!(Blob = realloc_c(Table->Context, Table->Blob, Capacity)))
+    {
+        return Table->Context->Error;
+    }
+
+    Table->Blob = Blob;
+    Table->BlobCapacity = Capacity;
+
+    return CSF_OK;
+}
+
+static void
+CSFTable_Shrink(CSFTable *Table)
+{
+    uint32_t **Array[5] = { &Table->NameOffset, &Table->NameLength, &Table->ValueOffset, &Table->ValueLength, &Table->ExtraValueLength };
+    uint32_t *Shrunk;
+    uint8_t *Flags, *Blob;
+    int i;
+
+    // Once everything is read, give back what the arrays and the Blob were guessed or grown too large
+    // Shrinking hardly ever fails, and if it does they just stay as they are
+    if(Table->Header.NumLabels && Table->Header.NumLabels < Table->Capacity)
+    {
+        for(i = 0; i < 5; i++)
+        {
+            if((Shrunk = realloc(*Array[i], Table->Header.NumLabels * sizeof(uint32_t))))
+            {
+                *Array[i] = Shrunk;
+            }
+        }
+
+        if((Flags = realloc(Table->Flags, Table->Header.NumLabels)))
+        {
+            Table->Flags = Flags;
+        }
+
+        Table->Capacity = Table->Header.NumLabels;
+    }
+
+    if(Table->BlobSize && Table->BlobSize < Table->BlobCapacity && (Blob = realloc(Table->Blob, Table->BlobSize)))
+    {
+        Table->Blob = Blob;
+        Table->BlobCapacity = Table->BlobSize;
+    }
+}
+
+CSFTable *
+CSFTable_Create(CSFContext *Context, uint32_t LanguageId)
+{
+    CSFTable *Table;
+
+    // An empty table with the header of a new CSF file, Labels are added with CSFTable_Add
+    if(!(Table = calloc_c(Context, 1, sizeof(CSFTable))))
+    {
+        return NULL;
+    }
+
+    Table->Context = Context;
+
+    CSFFileHeader_Init(&Table->Header, LanguageId);
+
+    return Table;
+}
+
+int
+CSFTable_Add(CSFTable *Table, CSFLabel *Label)
+{
+    CSFString *String = Label->String;
+    uint32_t ExtraValueLength;
+    uint32_t i = Table->Header.NumLabels;
+
+    // Copies Label to the end of the table, nothing of it has to stay valid afterwards
+    ExtraValueLength = Label->NumStringPairs && String->MagicHeader == STRW_MAGIC ? String->ExtraValueLength : 0;
+
+    if(i == Table->Capacity && CSFTable_Grow(Table, Table->Capacity ? Table->Capacity * 2 : 1024))
+    {
+        return Table->Context->Error;
+    }
+
+    if(Table->BlobSize + Label->LabelNameLength + ExtraValueLength + String->ValueLength > Table->BlobCapacity
+        && CSFTable_GrowBlob(Table, (size_t)Label->LabelNameLength + ExtraValueLength + String->ValueLength))
+    {
+        return Table->Context->Error;
+    }
+
+    Table->Flags[i] = (Label->NumStringPairs ? 0 : CSF_TABLE_NO_STRING) | (Label->NumStringPairs && String->MagicHeader == STRW_MAGIC ? CSF_TABLE_STRW : 0);
+
+    Table->NameOffset[i] = (uint32_t)Table->BlobSize;
+    Table->NameLength[i] = Label->LabelNameLength;
+    memcpy(Table->Blob + Table->BlobSize, Label->LabelName, Label->LabelNameLength);
+    Table->BlobSize += Label->LabelNameLength;
+
+    if(ExtraValueLength)
+    {
+        memcpy(Table->Blob + Table->BlobSize, String->ExtraValue, ExtraValueLength);
+        Table->BlobSize += ExtraValueLength;
+    }
+
+    Table->ExtraValueLength[i] = ExtraValueLength;
+
+    Table->ValueOffset[i] = (uint32_t)Table->BlobSize;
+    Table->ValueLength[i] = String->ValueLength;
+    memcpy(Table->Blob + Table->BlobSize, String->Value, String->ValueLength);
+    Table->BlobSize += String->ValueLength;
+
+    Table->Header.NumLabels++;
+    Table->Header.NumStrings += Label->NumStringPairs ? 1 : 0;
+
+    return CSF_OK;
+}
+
+void
+CSFTable_GetLabel(CSFTable *Table, uint32_t i, CSFLabel *Label, CSFString *String)
+{
+    // Fills Label and String with Label i of the table, pointing into the Blob, so they're valid until the next CSFTable_Add
+    // Values aren't null-terminated here
+    Label->MagicHeader = LBL_MAGIC;
+    Label->NumStringPairs = Table->Flags[i] & CSF_TABLE_NO_STRING ? 0 : 1;
+    Label->LabelNameLength = Table->NameLength[i];
+    Label->LabelName = (char *)Table->Blob + Table->NameOffset[i];
+    Label->String = String;
+
+    String->MagicHeader = Table->Flags[i] & CSF_TABLE_STRW ? STRW_MAGIC : STR_MAGIC;
+    String->ValueLength = Table->ValueLength[i];
+    String->Value = (char *)Table->Blob + Table->ValueOffset[i];
+    String->ExtraValueLength = Table->ExtraValueLength[i];
+    String->ExtraValue = Table->Flags[i] & CSF_TABLE_STRW ? Table->Blob + Table->NameOffset[i] + Table->NameLength[i] : NULL;
+}
+
+CSFTable *
+CSFTable_Load(CSFContext *Context, char *Path, uint32_t LanguageId)
+{
+    CSFReader *CSFFile_Reader = NULL;
+    STRReader *STRFile_Reader = NULL;
+    CSFTable *Table;
+    CSFLabel *Label;
+    uint64_t Start;
+
+    // Reads all Labels of a CSF or a STR file into a table, depending on the extension of Path
+    // LanguageId is only used for STR files, a CSF file has its own
+    // The file is read one Label at a time and released as it's read, so it's closed again once this returns
+    if(!(Table = CSFTable_Create(Context, LanguageId)))
+    {
+        return NULL;
+    }
+
+    Start = csf_stats_start(Context);
+
+    if(CSFFile_IsCSFPath(Path))
+    {
+        if((CSFFile_Reader = CSFReader_Open(Context, Path, 0)))
+        {
+            Table->Header.CSFVersion = CSFFile_Reader->Header.CSFVersion;
+            Table->Header.Unknown = CSFFile_Reader->Header.Unknown;
+            Table->Header.Language = CSFFile_Reader->Header.Language;
+
+            // The values are about half as long in UTF-8 as in the file, unless they're Japanese, Korean or Chinese
+            if(!CSFTable_Grow(Table, CSFFile_Reader->Header.NumLabels + 1) && CSFFile_Reader->Mapped)
+            {
+                CSFTable_GrowBlob(Table, CSFFile_Reader->Size / 2);
+            }
+
+            while(!Context->Error && (Label = CSFReader_Next(CSFFile_Reader)))
+            {
+                CSFTable_Add(Table, Label);
+            }
+
+            // Same as CSFFileHeader_Parse, the file's own count stays, which doesn't always match its Labels
+            Table->Header.NumStrings = CSFFile_Reader->Header.NumStrings;
+        }
+    }
+    else
+    {
+        if((STRFile_Reader = STRReader_Open(Context, Path, 0)))
+        {
+            // LabelNames and values of a STR file are never longer than the file itself
+            if(!CSFTable_Grow(Table, (STRFile_Reader->Mapped ? STRFile_Reader->Size : STRREADER_WINDOW_SIZE) / 32 + 1) && STRFile_Reader->Mapped)
+            {
+                CSFTable_GrowBlob(Table, STRFile_Reader->Size);
+            }
+
+            while(!Context->Error && (Label = STRReader_Next(STRFile_Reader)))
+            {
+                CSFTable_Add(Table, Label);
+            }
+        }
+    }
+
+    CSFReader_Close(CSFFile_Reader);
+    STRReader_Close(STRFile_Reader);
+
+    csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+
+    if(Context->Error)
+    {
+        CSFTable_Free(Table);
+        return NULL;
+    }
+
+    CSFTable_Shrink(Table);
+
+    return Table;
+}
+
+int
+CSFTable_Save(CSFContext *Context, CSFTable *Table, char *Path)
+{
+    FILE *Handle;
+    CSFWriteBuffer *Buffer = NULL;
+    CSFLabel Label;
+    CSFString String;
+    uint32_t i;
+
+    // Writes all Labels of the table to a CSF or a STR file, depending on the extension of Path
+    // The Labels are in the Blob in the order they were added, so this reads the Blob and the arrays from start to end
+    if((Handle = fopen_c(Context, Path, "wb")))
+    {
+        Buffer = writebuffer_create(Context, Handle);
+    }
+
+    if(Buffer)
+    {
+        if(CSFFile_IsCSFPath(Path))
+        {
+            writebuffer_write(Buffer, &Table->Header, sizeof(CSFHeader));
+        }
+
+        for(i = 0; i < Table->Header.NumLabels && !Context->Error; i++)
+        {
+            CSFTable_GetLabel(Table, i, &Label, &String);
+
+            if(CSFFile_IsCSFPath(Path))
+            {
+                CSFFile_WriteLabel(Buffer, &Label);
+            }
+            else
+            {
+                STRFile_WriteLabel(Buffer, &Label);
+            }
+        }
+
+        writebuffer_close(Buffer);
+    }
+
+    if(Handle && fclose_c(Handle))
+    {
+        csf_error(Context, CSF_ERROR_WRITE, "Couldn't write to ", Path, strlen(Path));
+    }
+
+    return Context->Error;
+}
+
+void
+CSFTable_Free(CSFTable *Table)
+{
+    if(Table == NULL)
+    {
+        return;
+    }
+
+    free(Table->NameOffset);
+    free(Table->NameLength);
+    free(Table->ValueOffset);
+    free(Table->ValueLength);
+    free(Table->ExtraValueLength);
+    free(Table->Flags);
+    free(Table->Blob);
+    free(Table);
+}
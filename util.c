@@ -1,188 +1,1833 @@
+// copy_file_range needs this before any system header
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include "csftools.h"
 
+#include <stdarg.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <sched.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CSF_SIMD_X86
+#include <immintrin.h>
+#endif
+
+void
+CSFContext_Init(CSFContext *Context)
+{
+    memset(Context, 0, sizeof(CSFContext));
+}
+
+int
+csf_error(CSFContext *Context, int Error, const char *Message, const char *Detail, size_t DetailLength)
+{
+    // Record an error in Context and return it, only the first error is kept since everything after it is usually a consequence of it
+    // Detail doesn't need to be null-terminated (i.e. a LabelName pointing into a mapped file), it's cut off if it's too long
+    if(Context->Error == CSF_OK)
+    {
+        if(DetailLength > CSF_ERROR_DETAIL_MAX - 1)
+        {
+            DetailLength = CSF_ERROR_DETAIL_MAX - 1;
+        }
+
+        Context->Error = Error;
+        Context->ErrorMessage = Message;
+        memcpy(Context->ErrorDetail, Detail, DetailLength);
+        Context->ErrorDetail[DetailLength] = '\0';
+    }
+
+    return Context->Error;
+}
+
 void
-printf_help_exit()
+csf_log(CSFContext *Context, int Level, const char *Format, ...)
+{
+    char Message[CSF_LOG_MAX];
+    va_list Args;
+
+    // Messages are only formatted if someone wants them
+    if(Context->Log == NULL)
+    {
+        return;
+    }
+
+    va_start(Args, Format);
+    vsnprintf(Message, sizeof(Message), Format, Args);
+    va_end(Args);
+
+    Context->Log(Context, Level, Message);
+}
+
+uint64_t
+csf_time()
 {
-    printf("%s v%i.%i by withmorten\n\n", TOOLNAME, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
-    printf("%s supports the following arguments:\n\n", TOOLNAME);
-#ifdef CSF2STR
-    printf("%s <csf input> <str output> to convert a csf file to a str file\n\n", TOOLNAME);
-#elif STR2CSF
-    printf("%s <str input> <csf output> <lang> to convert a str file to a csf file\n", TOOLNAME);
-    printf("please refer to the readme for the available languages\n\n");
+    // A monotonic clock in nanoseconds
+#ifdef _WIN32
+    LARGE_INTEGER Counter, Frequency;
+
+    QueryPerformanceCounter(&Counter);
+    QueryPerformanceFrequency(&Frequency);
+
+    return (uint64_t)(Counter.QuadPart / Frequency.QuadPart) * 1000000000 + (uint64_t)(Counter.QuadPart % Frequency.QuadPart) * 1000000000 / Frequency.QuadPart;
+#else
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+
+    return (uint64_t)Now.tv_sec * 1000000000 + Now.tv_nsec;
 #endif
-    printf("%s's source and readme are available at https://github.com/withmorten/csftools\n", TOOLNAME);
-    exit(1);
+}
+
+uint64_t
+csf_stats_start(CSFContext *Context)
+{
+    // The clock is only read if someone wants the times
+    return Context->Stats ? csf_time() : 0;
 }
 
 void
-printf_error_exit(char *message, char *labelname)
+csf_stats_stop(CSFContext *Context, int Counter, uint64_t Start)
 {
-    printf("Error: %s%s\n", message, labelname);
-    exit(1);
+    if(Context->Stats)
+    {
+        csf_stats_add(Context, Counter, csf_time() - Start);
+    }
 }
 
-FILE *
-fopen_d(const char *path, const char *mode)
+void
+csf_stats_add(CSFContext *Context, int Counter, uint64_t Value)
 {
-    FILE *f;
+    if(Context->Stats)
+    {
+        __atomic_fetch_add(&Context->Stats->Counter[Counter], Value, __ATOMIC_RELAXED);
+    }
+}
 
-    f = fopen(path, mode);
+const char *
+csf_stats_name(int Counter)
+{
+    const char *CSFStatNames[] =
+    {
+        "total_ns",
+        "open_ns",
+        "parse_ns",
+        "decode_ns",
+        "write_ns",
+        "encode_ns",
+        "bytes_read",
+        "bytes_written",
+        "allocations",
+        "allocated_bytes",
+        "reallocations",
+        "label_growths",
+        "interned_bytes"
+    };
 
-    if(f == NULL)
+    if(Counter >= 0 && Counter < CSF_STAT_NUM)
+    {
+        return CSFStatNames[Counter];
+    }
+    else
     {
-        printf("Error: couldn't fopen() file %s, exiting\n", path);
-        exit(1);
+        return NULL;
     }
+}
 
-    return f;
+void
+csf_stats_print(FILE *Stream, CSFStats *Stats)
+{
+    const char *Name;
+    int i;
+
+    // The counters as a table for people, times are in nanoseconds, they're shown in milliseconds
+    fprintf(Stream, "\nStats:\n");
+
+    for(i = 0; i < CSF_STAT_NUM; i++)
+    {
+        Name = csf_stats_name(i);
+
+        if(i <= CSF_STAT_TIME_ENCODE)
+        {
+            fprintf(Stream, "%-16.*s %14.3f ms\n", (int)strlen(Name) - 3, Name, Stats->Counter[i] / 1e6);
+        }
+        else
+        {
+            fprintf(Stream, "%-16s %14llu\n", Name, (unsigned long long)Stats->Counter[i]);
+        }
+    }
 }
 
-void *
-malloc_d(size_t size)
+int
+csf_stats_write_json(CSFContext *Context, const char *Path, const char *Tool, CSFStats *Stats)
 {
-    void *m;
+    FILE *Handle;
+    int i;
 
-    m = malloc(size);
+    // The counters as one json object for scripts, along with the tool and version that wrote them, - is stdout
+    if(!(Handle = fopen_c(Context, Path, "w")))
+    {
+        return Context->Error;
+    }
 
-    if(m == NULL && size != 0)
+    fprintf(Handle, "{\n    \"tool\": \"%s\",\n    \"version\": \"%i.%i\"", Tool, CSFTOOLS_VERSION_MAJOR, CSFTOOLS_VERSION_MINOR);
+
+    for(i = 0; i < CSF_STAT_NUM; i++)
     {
-        printf("Error: couldn't malloc() %i bytes of memory, exiting\n", (int)size);
-        exit(1);
+        fprintf(Handle, ",\n    \"%s\": %llu", csf_stats_name(i), (unsigned long long)Stats->Counter[i]);
     }
 
-    return m;
+    fprintf(Handle, "\n}\n");
+
+    if(fclose_c(Handle))
+    {
+        csf_error(Context, CSF_ERROR_WRITE, "Couldn't write to ", Path, strlen(Path));
+    }
+
+    return Context->Error;
 }
 
-void *
-calloc_d(size_t nitems, size_t size)
+void
+threads_run(int NumThreads, void *(*Function)(void *), void *Args, size_t ArgSize)
 {
-    void *m;
+    pthread_t *Threads;
+    int *Started;
+    int i;
 
-    m = calloc(nitems, size);
+    // Run Function on NumThreads threads, each one gets its own element of the Args array, and wait for all of them to finish
+    // If a thread can't be created (or there's no memory to keep track of them) its job is simply run on the calling thread
+    Threads = malloc(NumThreads * (sizeof(pthread_t) + sizeof(int)));
+    Started = (int *)(Threads + NumThreads);
 
-    if(m == NULL && size != 0)
+    for(i = 0; i < NumThreads; i++)
+    {
+        if(Threads != NULL && !pthread_create(&Threads[i], NULL, Function, (uint8_t *)Args + i * ArgSize))
+        {
+            Started[i] = 1;
+        }
+        else
+        {
+            Function((uint8_t *)Args + i * ArgSize);
+
+            if(Threads != NULL)
+            {
+                Started[i] = 0;
+            }
+        }
+    }
+
+    for(i = 0; Threads != NULL && i < NumThreads; i++)
     {
-        printf("Error: couldn't calloc() %i bytes of memory, exiting\n", (int)size);
-        exit(1);
+        if(Started[i])
+        {
+            pthread_join(Threads[i], NULL);
+        }
     }
 
-    return m;
+    free(Threads);
 }
 
-void *
-realloc_d(void *ptr, size_t size)
+static void *
+threads_pool_worker(void *Args)
 {
-    void *m;
+    CSFPool *Pool = *(CSFPool **)Args;
+    size_t i;
 
-    m = realloc(ptr, size);
+    // Keep taking the next job until there are none left, so a slow job doesn't hold up the ones after it
+    while((i = __atomic_fetch_add(&Pool->Next, 1, __ATOMIC_RELAXED)) < Pool->NumArgs)
+    {
+        Pool->Function(Pool->Args + i * Pool->ArgSize);
+    }
 
-    if(m == NULL && size != 0)
+    return NULL;
+}
+
+void
+threads_run_pool(int NumThreads, void *(*Function)(void *), void *Args, size_t ArgSize, size_t NumArgs)
+{
+    CSFPool Pool;
+    CSFPool *Worker = &Pool;
+    CSFPool **Workers;
+    int i;
+
+    // Run Function once for each of the NumArgs elements of the Args array, on a pool of NumThreads threads, and wait until all of them are done
+    Pool.Function = Function;
+    Pool.Args = Args;
+    Pool.ArgSize = ArgSize;
+    Pool.NumArgs = NumArgs;
+    Pool.Next = 0;
+
+    if((size_t)NumThreads > NumArgs)
     {
-        printf("Error: couldn't realloc() %i bytes of memory, exiting\n", (int)size);
-        exit(1);
+        NumThreads = NumArgs;
     }
 
-    return m;
+    // Not worth any threads, or no memory for them
+    if(NumThreads < 2 || !(Workers = malloc(NumThreads * sizeof(CSFPool *))))
+    {
+        threads_pool_worker(&Worker);
+        return;
+    }
+
+    for(i = 0; i < NumThreads; i++)
+    {
+        Workers[i] = &Pool;
+    }
+
+    threads_run(NumThreads, threads_pool_worker, Workers, sizeof(CSFPool *));
+
+    free(Workers);
 }
 
 void *
-recalloc_d(void *ptr, size_t ptrsize,  size_t nitems, size_t size)
+thread_start(void *(*Function)(void *), void *Args)
 {
-    void *m;
-
-    m = calloc_d(nitems, size);
+    pthread_t *Thread;
 
-    memcpy(m, ptr, ptrsize);
+    // Runs Function on a thread of its own until thread_join, returns NULL if the thread can't be started
+    if(!(Thread = malloc(sizeof(pthread_t))))
+    {
+        return NULL;
+    }
 
-    free(ptr);
+    if(pthread_create(Thread, NULL, Function, Args))
+    {
+        free(Thread);
+        return NULL;
+    }
 
-    return m;
+    return Thread;
 }
 
+void
+thread_join(void *Thread)
+{
+    pthread_join(*(pthread_t *)Thread, NULL);
+    free(Thread);
+}
 
-char *
-fgets_t(char *str, int n, FILE *stream)
+void
+thread_backoff(uint32_t *Spins)
 {
-    if(!fgets(str, n, stream))
+#ifndef _WIN32
+    struct timespec Delay = { 0, 100000 };
+#endif
+
+    // Waits a bit for another thread, Spins counts how often in a row, the caller resets it once there's something to do again
+    // The first few times only give up the rest of the time slice, after that it's probably waiting for a disk and sleeps
+#ifdef _WIN32
+    Sleep(*Spins < 64 ? 0 : 1);
+#else
+    if(*Spins < 64)
     {
-        return NULL;
+        sched_yield();
     }
     else
     {
-        return strtrim(str);
+        nanosleep(&Delay, NULL);
+    }
+#endif
+
+    (*Spins)++;
+}
+
+int
+wildcard_match(const char *Pattern, const char *Name)
+{
+    const char *Star = NULL;
+    const char *StarName = NULL;
+
+    // * matches any number of chars, ? matches a single one, case doesn't matter since file names on Windows don't care either
+    // When something doesn't match after a *, let that * take one more char and try again
+    while(*Name)
+    {
+        if(*Pattern == '*')
+        {
+            Star = Pattern++;
+            StarName = Name;
+        }
+        else if(*Pattern == '?' || tolower((unsigned char)*Pattern) == tolower((unsigned char)*Name))
+        {
+            Pattern++;
+            Name++;
+        }
+        else if(Star)
+        {
+            Pattern = Star + 1;
+            Name = ++StarName;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    while(*Pattern == '*')
+    {
+        Pattern++;
     }
+
+    return *Pattern == '\0';
+}
+
+static int
+dir_list_compare(const void *a, const void *b)
+{
+    return strcmp(*(char **)a, *(char **)b);
 }
 
-char *
-strtrim(char *str)
+char **
+dir_list(CSFArena *Arena, const char *Path, uint32_t *Count)
 {
-    // Adapted from https://stackoverflow.com/a/122974
+    char **Names = NULL;
+    char **Names_Old = NULL;
+    uint32_t Names_AllocSize = 64;
+    const char *Name;
+    size_t Name_Len;
+#ifdef _WIN32
+    HANDLE d;
+    WIN32_FIND_DATAA e;
+    char *Pattern;
+#else
+    DIR *d;
+    struct dirent *e;
+    struct stat st;
+    char *FullPath;
+#endif
+
+    // Returns the names of all regular files in the directory Path, sorted, everything is allocated from Arena
+    // Returns NULL if the directory can't be read
+    *Count = 0;
+
+    if(!(Names = arena_alloc(Arena, Names_AllocSize * sizeof(char *))))
+    {
+        return NULL;
+    }
+
+#ifdef _WIN32
+    if(!(Pattern = arena_alloc(Arena, strlen(Path) + 3)))
+    {
+        return NULL;
+    }
+
+    strcpy(Pattern, Path);
+    strcat(Pattern, "\\*");
+
+    if((d = FindFirstFileA(Pattern, &e)) == INVALID_HANDLE_VALUE)
+    {
+        csf_error(Arena->Context, CSF_ERROR_OPEN, "Couldn't read directory ", Path, strlen(Path));
+        return NULL;
+    }
+
+    do
+    {
+        if(e.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            continue;
+        }
+
+        Name = e.cFileName;
+#else
+    if(!(d = opendir(Path)))
+    {
+        csf_error(Arena->Context, CSF_ERROR_OPEN, "Couldn't read directory ", Path, strlen(Path));
+        return NULL;
+    }
+
+    while((e = readdir(d)))
+    {
+        Name = e->d_name;
+
+        if(!(FullPath = malloc_c(Arena->Context, strlen(Path) + strlen(Name) + 2)))
+        {
+            break;
+        }
+
+        sprintf(FullPath, "%s/%s", Path, Name);
+
+        if(stat(FullPath, &st) || !S_ISREG(st.st_mode))
+        {
+            free(FullPath);
+            continue;
+        }
+
+        free(FullPath);
+#endif
+
+        // Same as the Labels of CSFFileHeader_Create, allocate twice as much if it's full and copy the old array over
+        if(*Count == Names_AllocSize)
+        {
+            Names_AllocSize *= 2;
+            Names_Old = Names;
+
+            if(!(Names = arena_alloc(Arena, Names_AllocSize * sizeof(char *))))
+            {
+                break;
+            }
+
+            memcpy(Names, Names_Old, *Count * sizeof(char *));
+        }
 
-    size_t len = 0;
-    char *frontp = str;
-    char *endp = NULL;
+        Name_Len = strlen(Name);
 
-    if(str == NULL)
+        if(!(Names[*Count] = arena_alloc(Arena, Name_Len + 1)))
+        {
+            break;
+        }
+
+        memcpy(Names[*Count], Name, Name_Len + 1);
+        (*Count)++;
+#ifdef _WIN32
+    } while(FindNextFileA(d, &e));
+
+    FindClose(d);
+#else
+    }
+
+    closedir(d);
+#endif
+
+    if(Arena->Context->Error)
     {
         return NULL;
     }
 
-    if(*str == '\0')
+    qsort(Names, *Count, sizeof(char *), dir_list_compare);
+
+    return Names;
+}
+
+FILE *
+fopen_c(CSFContext *Context, const char *path, const char *mode)
+{
+    FILE *f;
+
+    // - is stdin or stdout, depending on mode, those must be closed with fclose_c so they stay open
+    if(!strcmp(path, "-"))
+    {
+        f = *mode == 'r' ? stdin : stdout;
+
+#ifdef _WIN32
+        _setmode(_fileno(f), _O_BINARY);
+#endif
+
+        return f;
+    }
+
+    f = fopen(path, mode);
+
+    if(f == NULL)
     {
-        return str;
+        csf_error(Context, CSF_ERROR_OPEN, "Couldn't open file ", path, strlen(path));
     }
 
-    len = strlen(str);
-    endp = str + len;
+    return f;
+}
 
-    // Move the front and back pointers to address the first non-whitespace characters from each end.
-    while(isspace((unsigned char)*frontp))
+int
+fclose_c(FILE *stream)
+{
+    // Same as fclose, but stdin and stdout only get flushed since they don't belong to us
+    if(stream == stdin || stream == stdout)
     {
-        ++frontp;
+        return fflush(stream);
     }
 
-    if(endp != frontp)
+    return fclose(stream);
+}
+
+FILE *
+fopen_replace(CSFContext *Context, const char *path, char **temp_path)
+{
+#ifndef _WIN32
+    struct stat st;
+#endif
+    FILE *f;
+
+    // Opens path for writing through a temporary file next to it, which fclose_replace only renames to path if nothing failed
+    // So a conversion that fails halfway never leaves a broken file behind, whatever was at path before stays as it was
+    // - and files that exist but aren't regular (i.e. /dev/null or a named pipe) are written to as they are, *temp_path is NULL then
+    *temp_path = NULL;
+
+    if(!strcmp(path, "-")
+#ifndef _WIN32
+        || (!stat(path, &st) && !S_ISREG(st.st_mode))
+#endif
+        )
     {
-        while(isspace((unsigned char)*(--endp)) && endp != frontp);
+        return fopen_c(Context, path, "wb");
     }
 
-    if((str + len - 1) != endp)
+    if(!(*temp_path = malloc_c(Context, strlen(path) + sizeof(".tmp"))))
     {
-        *(endp + 1) = '\0';
+        return NULL;
     }
-    else if(frontp != str &&  endp == frontp)
+
+    sprintf(*temp_path, "%s.tmp", path);
+
+    if(!(f = fopen_c(Context, *temp_path, "wb")))
     {
-        *str = '\0';
+        free(*temp_path);
+        *temp_path = NULL;
     }
 
-    // Shift the string so that it starts at str so that if it's dynamically allocated we can still free it on the returned pointer.
-    // Note the reuse of endp to mean the front of the string buffer now.
-    endp = str;
+    return f;
+}
+
+int
+fclose_replace(CSFContext *Context, FILE *stream, const char *path, char *temp_path)
+{
+    // Closes a file of fopen_replace, if Context has an error by then the temporary file is removed instead of replacing path
+    if(fclose_c(stream))
+    {
+        csf_error(Context, CSF_ERROR_WRITE, "Couldn't write to ", path, strlen(path));
+    }
 
-    if(frontp != str)
+    if(temp_path)
     {
-        while(*frontp)
+        // Windows can't rename over an existing file
+#ifdef _WIN32
+        if(!Context->Error)
+        {
+            remove(path);
+        }
+#endif
+
+        if(Context->Error || rename(temp_path, path))
         {
-            *endp++ = *frontp++;
+            remove(temp_path);
+            csf_error(Context, CSF_ERROR_WRITE, "Couldn't replace ", path, strlen(path));
         }
 
-        *endp = '\0';
+        free(temp_path);
     }
 
-    return str;
+    return Context->Error;
 }
 
-char *
-strupr(char* str)
+void *
+fmap(const char *path, size_t *size)
 {
-    char *tmp = str;
+    // Map a whole file into memory, private and copy-on-write so callers can decode in place without touching the file
+    // Returns NULL if the file isn't a regular non-empty file (i.e. a pipe) or can't be opened, the caller is expected to fall back to stdio then
+#ifdef _WIN32
+    HANDLE f, m;
+    LARGE_INTEGER s;
+    void *p;
+
+    f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if(f == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    if(GetFileType(f) != FILE_TYPE_DISK || !GetFileSizeEx(f, &s) || s.QuadPart == 0)
+    {
+        CloseHandle(f);
+        return NULL;
+    }
+
+    m = CreateFileMappingA(f, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(f);
 
-    while(*tmp)
+    if(m == NULL)
     {
-        *tmp = toupper((unsigned char)*tmp);
-        tmp++;
+        return NULL;
     }
 
-    return str;
+    p = MapViewOfFile(m, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(m);
+
+    if(p == NULL)
+    {
+        return NULL;
+    }
+
+    *size = (size_t)s.QuadPart;
+
+    return p;
+#else
+    int fd;
+    struct stat st;
+    void *p;
+
+    fd = open(path, O_RDONLY);
+
+    if(fd == -1)
+    {
+        return NULL;
+    }
+
+    if(fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(p == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    *size = (size_t)st.st_size;
+
+    return p;
+#endif
+}
+
+void
+fmap_discard(void *ptr, size_t size)
+{
+    // Tell the OS that part of a mapping won't be needed anymore, so its pages don't count against us
+    // Pages that get touched again are simply read from the file again
+#ifdef _WIN32
+    (void)ptr;
+    (void)size;
+#else
+    uintptr_t start, end;
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    start = ((uintptr_t)ptr + pagesize - 1) & ~(uintptr_t)(pagesize - 1);
+    end = ((uintptr_t)ptr + size) & ~(uintptr_t)(pagesize - 1);
+
+    if(end > start)
+    {
+        madvise((void *)start, end - start, MADV_DONTNEED);
+    }
+#endif
+}
+
+void
+funmap(void *ptr, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+void *
+malloc_c(CSFContext *Context, size_t size)
+{
+    void *m;
+
+    m = malloc(size);
+
+    if(m == NULL && size != 0)
+    {
+        csf_error(Context, CSF_ERROR_MEMORY, "Couldn't allocate memory", "", 0);
+    }
+
+    csf_stats_add(Context, CSF_STAT_ALLOCATIONS, 1);
+    csf_stats_add(Context, CSF_STAT_ALLOCATED_BYTES, size);
+
+    return m;
+}
+
+void *
+calloc_c(CSFContext *Context, size_t nitems, size_t size)
+{
+    void *m;
+
+    m = calloc(nitems, size);
+
+    if(m == NULL && nitems != 0 && size != 0)
+    {
+        csf_error(Context, CSF_ERROR_MEMORY, "Couldn't allocate memory", "", 0);
+    }
+
+    csf_stats_add(Context, CSF_STAT_ALLOCATIONS, 1);
+    csf_stats_add(Context, CSF_STAT_ALLOCATED_BYTES, nitems * size);
+
+    return m;
+}
+
+void *
+realloc_c(CSFContext *Context, void *ptr, size_t size)
+{
+    void *m;
+
+    // Like realloc, ptr is still valid (and still needs to be freed) if this fails
+    m = realloc(ptr, size);
+
+    if(m == NULL && size != 0)
+    {
+        csf_error(Context, CSF_ERROR_MEMORY, "Couldn't allocate memory", "", 0);
+    }
+
+    // A realloc is counted as an allocation of its new size, and as a reallocation if it grows an existing block
+    csf_stats_add(Context, CSF_STAT_ALLOCATIONS, 1);
+    csf_stats_add(Context, CSF_STAT_ALLOCATED_BYTES, size);
+    csf_stats_add(Context, CSF_STAT_REALLOCATIONS, ptr != NULL);
+
+    return m;
+}
+
+CSFArena *
+arena_create(CSFContext *Context, size_t size)
+{
+    CSFArena *arena;
+
+    // An arena hands out memory from large blocks and frees everything at once in arena_free
+    // size is the size of the first block, further blocks double in size so even a bad guess only costs a handful of allocations
+    if((arena = malloc_c(Context, sizeof(CSFArena))) == NULL)
+    {
+        return NULL;
+    }
+
+    arena->Context = Context;
+    arena->Block = NULL;
+    arena->BlockSize = size < ARENA_BLOCK_MIN ? ARENA_BLOCK_MIN : size;
+
+    return arena;
+}
+
+void *
+arena_alloc(CSFArena *arena, size_t size)
+{
+    CSFArenaBlock *block;
+    void *m;
+
+    // Keep everything aligned for any type
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    block = arena->Block;
+
+    if(block == NULL || block->Size - block->Used < size)
+    {
+        if(block != NULL)
+        {
+            arena->BlockSize *= 2;
+        }
+
+        if(arena->BlockSize < size)
+        {
+            arena->BlockSize = size;
+        }
+
+        if((block = malloc_c(arena->Context, sizeof(CSFArenaBlock) + arena->BlockSize)) == NULL)
+        {
+            return NULL;
+        }
+
+        block->Next = arena->Block;
+        block->Size = arena->BlockSize;
+        block->Used = 0;
+
+        arena->Block = block;
+    }
+
+    m = block->Data + block->Used;
+    block->Used += size;
+
+    return m;
+}
+
+void *
+arena_calloc(CSFArena *arena, size_t nitems, size_t size)
+{
+    void *m;
+
+    if((m = arena_alloc(arena, nitems * size)) != NULL)
+    {
+        memset(m, 0, nitems * size);
+    }
+
+    return m;
+}
+
+void
+arena_merge(CSFArena *arena, CSFArena *other)
+{
+    CSFArenaBlock *block;
+
+    // Hand all blocks of other over to arena, so they're released with it, other is freed
+    // New allocations keep coming from arena's current block
+    if(other->Block)
+    {
+        for(block = other->Block; block->Next; block = block->Next);
+
+        if(arena->Block)
+        {
+            block->Next = arena->Block->Next;
+            arena->Block->Next = other->Block;
+        }
+        else
+        {
+            arena->Block = other->Block;
+        }
+    }
+
+    free(other);
+}
+
+void
+arena_free(CSFArena *arena)
+{
+    CSFArenaBlock *block, *next;
+
+    if(arena == NULL)
+    {
+        return;
+    }
+
+    for(block = arena->Block; block; block = next)
+    {
+        next = block->Next;
+        free(block);
+    }
+
+    free(arena);
+}
+
+CSFWriteBuffer *
+writebuffer_create(CSFContext *Context, FILE *stream)
+{
+    CSFWriteBuffer *buffer;
+
+    // Collects small writes and flushes them to stream in large blocks, the stream is still owned by the caller
+    if((buffer = malloc_c(Context, sizeof(CSFWriteBuffer))) == NULL)
+    {
+        return NULL;
+    }
+
+    buffer->Context = Context;
+    buffer->Handle = stream;
+    buffer->Used = 0;
+    buffer->Size = WRITEBUFFER_SIZE;
+    buffer->Pipe = NULL;
+
+    if((buffer->Data = malloc_c(Context, buffer->Size)) == NULL)
+    {
+        free(buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+
+CSFWriteBuffer *
+writebuffer_create_pipelined(CSFContext *Context, FILE *stream)
+{
+    CSFWriteBuffer *buffer;
+
+    // Same as writebuffer_create, but full buffers are written on a thread of their own while the next one is filled
+    if((buffer = writebuffer_create(Context, stream)) && !(buffer->Pipe = pipewriter_create(Context, stream)))
+    {
+        writebuffer_close(buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+
+static void
+writebuffer_submit(CSFWriteBuffer *buffer)
+{
+    // Writes what's in the buffer, or hands it to the thread of a pipelined buffer, which may not have written it yet when this returns
+    if(buffer->Context->Error == CSF_OK && buffer->Used)
+    {
+        if(buffer->Pipe ? pipewriter_submit(buffer->Pipe, &buffer->Data, &buffer->Size, buffer->Used) : fwrite(buffer->Data, buffer->Used, 1, buffer->Handle) != 1)
+        {
+            csf_error(buffer->Context, CSF_ERROR_WRITE, "Couldn't write to output file", "", 0);
+        }
+    }
+
+    csf_stats_add(buffer->Context, CSF_STAT_BYTES_WRITTEN, buffer->Used);
+
+    buffer->Used = 0;
+}
+
+int
+writebuffer_flush(CSFWriteBuffer *buffer)
+{
+    // Everything written to the buffer is in the stream afterwards, so the caller can use the stream directly
+    writebuffer_submit(buffer);
+
+    if(buffer->Pipe && pipewriter_drain(buffer->Pipe))
+    {
+        csf_error(buffer->Context, CSF_ERROR_WRITE, "Couldn't write to output file", "", 0);
+    }
+
+    return buffer->Context->Error;
+}
+
+void
+writebuffer_write(CSFWriteBuffer *buffer, const void *data, size_t size)
+{
+    if(size > buffer->Size - buffer->Used)
+    {
+        writebuffer_submit(buffer);
+
+        // Don't bother copying anything that wouldn't fit anyway, the thread of a pipelined buffer needs to be done with everything before it first
+        if(size > buffer->Size)
+        {
+            if(writebuffer_flush(buffer) == CSF_OK && fwrite(data, size, 1, buffer->Handle) != 1)
+            {
+                csf_error(buffer->Context, CSF_ERROR_WRITE, "Couldn't write to output file", "", 0);
+            }
+
+            csf_stats_add(buffer->Context, CSF_STAT_BYTES_WRITTEN, size);
+
+            return;
+        }
+    }
+
+    memcpy(buffer->Data + buffer->Used, data, size);
+    buffer->Used += size;
+}
+
+void *
+writebuffer_reserve(CSFWriteBuffer *buffer, size_t size)
+{
+    uint8_t *m;
+
+    // Returns space for size bytes in the buffer for the caller to fill directly, i.e. to encode into without a scratch buffer
+    // The buffer grows if size doesn't fit into it at all, if that fails NULL is returned and the error is kept in the context
+    if(size > buffer->Size - buffer->Used)
+    {
+        writebuffer_submit(buffer);
+
+        if(size > buffer->Size)
+        {
+            if((m = realloc_c(buffer->Context, buffer->Data, size)) == NULL)
+            {
+                return NULL;
+            }
+
+            buffer->Size = size;
+            buffer->Data = m;
+        }
+    }
+
+    m = buffer->Data + buffer->Used;
+    buffer->Used += size;
+
+    return m;
+}
+
+void
+writebuffer_unreserve(CSFWriteBuffer *buffer, size_t size)
+{
+    // Gives back the last size bytes of the last writebuffer_reserve, for when less was needed than reserved
+    buffer->Used -= size;
+}
+
+void
+writebuffer_puts(CSFWriteBuffer *buffer, const char *str)
+{
+    writebuffer_write(buffer, str, strlen(str));
+}
+
+void
+writebuffer_copy(CSFWriteBuffer *buffer, FILE *stream, const uint8_t *data, size_t offset, size_t size)
+{
+#ifdef __linux__
+    loff_t in;
+    ssize_t n;
+#endif
+
+    // Writes size bytes at offset of stream, of which data is a mapping, i.e. Labels of a CSF file that are copied as they are
+    // Large ranges are copied by the kernel without passing through here, with copy_file_range or sendfile, anything else is written from data
+#ifdef __linux__
+    if(size >= WRITEBUFFER_COPY_MIN && writebuffer_flush(buffer) == CSF_OK && fflush(buffer->Handle) == 0)
+    {
+        in = (loff_t)offset;
+
+        while(size)
+        {
+            if((n = copy_file_range(fileno(stream), &in, fileno(buffer->Handle), NULL, size, 0)) <= 0
+                && (n = sendfile(fileno(buffer->Handle), fileno(stream), &in, size)) <= 0)
+            {
+                break;
+            }
+
+            csf_stats_add(buffer->Context, CSF_STAT_BYTES_WRITTEN, (uint64_t)n);
+            size -= (size_t)n;
+        }
+
+        offset = (size_t)in;
+    }
+#else
+    (void)stream;
+#endif
+
+    writebuffer_write(buffer, data + offset, size);
+}
+
+int
+writebuffer_close(CSFWriteBuffer *buffer)
+{
+    int Error;
+
+    // Returns the first error of any write to this buffer
+    Error = writebuffer_flush(buffer);
+
+    if(buffer->Pipe && pipewriter_close(buffer->Pipe) && !Error)
+    {
+        Error = csf_error(buffer->Context, CSF_ERROR_WRITE, "Couldn't write to output file", "", 0);
+    }
+
+    free(buffer->Data);
+    free(buffer);
+
+    return Error;
+}
+
+// String values in CSF files are notted UTF-16LE, the following kernels convert between them and the UTF-8 values used everywhere else
+// The best kernel is picked at runtime, the AVX2 and SSE2 ones convert blocks of ASCII chars at once, which is what English values are made of
+// The AVX2 ones also do blocks of 3 byte chars at once, which is what Japanese, Korean and Chinese values are mostly made of, the scalar ones take care of the rest
+
+static size_t
+CSFString_Decode_Scalar(uint8_t *Value, size_t n, const uint8_t *EncodedValue, size_t ValueLength, size_t *Decoded, size_t Stop, int InPlace)
+{
+    uint32_t c, d;
+    size_t i, Units, Length;
+
+    // Decodes the chars that start before Stop, a surrogate pair may go one unit past it
+    // In place it stops before the first char that would overwrite units that weren't decoded yet
+    for(i = *Decoded; i < Stop; i += Units)
+    {
+        c = (uint16_t)~(EncodedValue[i * 2] | EncodedValue[i * 2 + 1] << 8);
+        Units = 1;
+
+        if(c >= 0xD800 && c < 0xDC00 && i + 1 < ValueLength)
+        {
+            d = (uint16_t)~(EncodedValue[i * 2 + 2] | EncodedValue[i * 2 + 3] << 8);
+
+            if(d >= 0xDC00 && d < 0xE000)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (d - 0xDC00);
+                Units = 2;
+            }
+        }
+
+        Length = c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+
+        if(InPlace && n + Length > (i + Units) * 2)
+        {
+            break;
+        }
+
+        // A lone surrogate gets the 3 bytes it would have if it was a char, so it comes back the same from CSFString_Encode
+        switch(Length)
+        {
+        case 1:
+            Value[n] = (uint8_t)c;
+            break;
+        case 2:
+            Value[n] = (uint8_t)(0xC0 | c >> 6);
+            Value[n + 1] = (uint8_t)(0x80 | (c & 0x3F));
+            break;
+        case 3:
+            Value[n] = (uint8_t)(0xE0 | c >> 12);
+            Value[n + 1] = (uint8_t)(0x80 | (c >> 6 & 0x3F));
+            Value[n + 2] = (uint8_t)(0x80 | (c & 0x3F));
+            break;
+        default:
+            Value[n] = (uint8_t)(0xF0 | c >> 18);
+            Value[n + 1] = (uint8_t)(0x80 | (c >> 12 & 0x3F));
+            Value[n + 2] = (uint8_t)(0x80 | (c >> 6 & 0x3F));
+            Value[n + 3] = (uint8_t)(0x80 | (c & 0x3F));
+            break;
+        }
+
+        n += Length;
+    }
+
+    *Decoded = i;
+
+    return n;
+}
+
+static uint32_t
+CSFString_EncodeChar(const uint8_t *Value, size_t ValueLength, size_t i, size_t *Length)
+{
+    uint32_t c;
+
+    // Returns the char that starts at Value[i] and how many bytes it has
+    // Bytes that aren't valid UTF-8 are taken as Latin-1 chars, which is what older STR files are made of
+    c = Value[i];
+    *Length = 1;
+
+    if(c >= 0xC2 && c < 0xE0 && i + 1 < ValueLength && (Value[i + 1] & 0xC0) == 0x80)
+    {
+        c = (c & 0x1F) << 6 | (Value[i + 1] & 0x3F);
+        *Length = 2;
+    }
+    else if(c >= 0xE0 && c < 0xF0 && i + 2 < ValueLength && (Value[i + 1] & 0xC0) == 0x80 && (Value[i + 2] & 0xC0) == 0x80)
+    {
+        // Surrogates are taken as they are, CSFString_Decode gives them 3 bytes if they aren't a pair
+        c = (c & 0x0F) << 12 | (Value[i + 1] & 0x3F) << 6 | (Value[i + 2] & 0x3F);
+        *Length = c >= 0x800 ? 3 : 1;
+    }
+    else if(c >= 0xF0 && c < 0xF5 && i + 3 < ValueLength && (Value[i + 1] & 0xC0) == 0x80 && (Value[i + 2] & 0xC0) == 0x80 && (Value[i + 3] & 0xC0) == 0x80)
+    {
+        c = (c & 0x07) << 18 | (Value[i + 1] & 0x3F) << 12 | (Value[i + 2] & 0x3F) << 6 | (Value[i + 3] & 0x3F);
+        *Length = c >= 0x10000 && c < 0x110000 ? 4 : 1;
+    }
+
+    return *Length == 1 ? Value[i] : c;
+}
+
+static size_t
+CSFString_Encode_Scalar(uint8_t *EncodedValue, size_t n, const uint8_t *Value, size_t ValueLength, size_t *Encoded, size_t Stop)
+{
+    uint32_t c;
+    size_t i, Length;
+
+    // Encodes the chars that start before Stop, the last one may go up to 3 bytes past it
+    for(i = *Encoded; i < Stop; i += Length)
+    {
+        c = CSFString_EncodeChar(Value, ValueLength, i, &Length);
+
+        if(c >= 0x10000)
+        {
+            c -= 0x10000;
+            EncodedValue[n * 2] = (uint8_t)~(c >> 10 & 0xFF);
+            EncodedValue[n * 2 + 1] = (uint8_t)~(0xD8 | c >> 18);
+            c = 0xDC00 | (c & 0x3FF);
+            n++;
+        }
+
+        EncodedValue[n * 2] = (uint8_t)~(c & 0xFF);
+        EncodedValue[n * 2 + 1] = (uint8_t)~(c >> 8);
+        n++;
+    }
+
+    *Encoded = i;
+
+    return n;
+}
+
+#ifdef CSF_SIMD_X86
+__attribute__((target("sse2"))) static size_t
+CSFString_Decode_SSE2(uint8_t *Value, const uint8_t *EncodedValue, size_t ValueLength, size_t *Decoded, int InPlace)
+{
+    __m128i Ones = _mm_set1_epi8(-1);
+    __m128i NonASCII = _mm_set1_epi16((short)0xFF80);
+    __m128i a, b;
+    size_t i, n, Stop;
+
+    for(i = 0, n = 0; i < ValueLength; )
+    {
+        if(i + 16 <= ValueLength)
+        {
+            a = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(EncodedValue + i * 2)), Ones);
+            b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(EncodedValue + i * 2 + 16)), Ones);
+
+            // 16 ASCII chars, in place the output is always behind the input
+            if(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), NonASCII), _mm_setzero_si128())) == 0xFFFF)
+            {
+                _mm_storeu_si128((__m128i *)(Value + n), _mm_packus_epi16(a, b));
+                i += 16;
+                n += 16;
+                continue;
+            }
+        }
+
+        Stop = i + 16 < ValueLength ? i + 16 : ValueLength;
+        n = CSFString_Decode_Scalar(Value, n, EncodedValue, ValueLength, &i, Stop, InPlace);
+
+        if(i < Stop)
+        {
+            break;
+        }
+    }
+
+    *Decoded = i;
+
+    return n;
+}
+
+__attribute__((target("sse2"))) static size_t
+CSFString_Encode_SSE2(uint8_t *EncodedValue, const uint8_t *Value, size_t ValueLength)
+{
+    __m128i Ones = _mm_set1_epi8(-1);
+    __m128i Zero = _mm_setzero_si128();
+    __m128i a;
+    size_t i, n, Stop;
+
+    for(i = 0, n = 0; i < ValueLength; )
+    {
+        if(i + 16 <= ValueLength)
+        {
+            a = _mm_loadu_si128((const __m128i *)(Value + i));
+
+            if(!_mm_movemask_epi8(a))
+            {
+                _mm_storeu_si128((__m128i *)(EncodedValue + n * 2), _mm_xor_si128(_mm_unpacklo_epi8(a, Zero), Ones));
+                _mm_storeu_si128((__m128i *)(EncodedValue + n * 2 + 16), _mm_xor_si128(_mm_unpackhi_epi8(a, Zero), Ones));
+                i += 16;
+                n += 16;
+                continue;
+            }
+        }
+
+        Stop = i + 16 < ValueLength ? i + 16 : ValueLength;
+        n = CSFString_Encode_Scalar(EncodedValue, n, Value, ValueLength, &i, Stop);
+    }
+
+    return n;
+}
+
+__attribute__((target("avx2"))) static size_t
+CSFString_Decode_AVX2(uint8_t *Value, const uint8_t *EncodedValue, size_t ValueLength, size_t *Decoded, int InPlace)
+{
+    __m256i Ones = _mm256_set1_epi8(-1);
+    __m256i NonASCII = _mm256_set1_epi16((short)0xFF80);
+    __m128i TwoBytes = _mm_set1_epi16((short)0xF800);
+    __m128i Surrogates = _mm_set1_epi16((short)0xD800);
+    __m128i LowBits = _mm_set1_epi16(0x3F);
+    __m128i Trail = _mm_set1_epi16(0x80);
+    __m128i Lead = _mm_set1_epi16(0xE0);
+    // Where the lead, middle and trail bytes of 8 chars go in 24 output bytes, out of lead and middle bytes packed into one vector and trail bytes into another
+    __m128i FirstLeads = _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5);
+    __m128i FirstTrails = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+    __m128i LastLeads = _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i LastTrails = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i a, b;
+    __m128i c, High, Bytes, Trails;
+    size_t i, n, Stop;
+
+    for(i = 0, n = 0; i < ValueLength; )
+    {
+        if(i + 32 <= ValueLength)
+        {
+            a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(EncodedValue + i * 2)), Ones);
+            b = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(EncodedValue + i * 2 + 32)), Ones);
+
+            // 32 ASCII chars, packus works per 128-bit lane, so the 64-bit blocks need to be put back in order afterwards
+            if(_mm256_testz_si256(_mm256_or_si256(a, b), NonASCII))
+            {
+                _mm256_storeu_si256((__m256i *)(Value + n), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+                i += 32;
+                n += 32;
+                continue;
+            }
+        }
+
+        // 8 chars from U+0800 to U+FFFF that aren't surrogates become 24 bytes, in place that only fits once the output is far enough behind
+        if(i + 8 <= ValueLength && (!InPlace || n + 8 <= i * 2))
+        {
+            c = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(EncodedValue + i * 2)), _mm256_castsi256_si128(Ones));
+            High = _mm_and_si128(c, TwoBytes);
+
+            if(!_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(High, _mm_setzero_si128()), _mm_cmpeq_epi16(High, Surrogates))))
+            {
+                Bytes = _mm_packus_epi16(_mm_or_si128(_mm_srli_epi16(c, 12), Lead), _mm_or_si128(_mm_and_si128(_mm_srli_epi16(c, 6), LowBits), Trail));
+                Trails = _mm_packus_epi16(_mm_or_si128(_mm_and_si128(c, LowBits), Trail), _mm_setzero_si128());
+
+                _mm_storeu_si128((__m128i *)(Value + n), _mm_or_si128(_mm_shuffle_epi8(Bytes, FirstLeads), _mm_shuffle_epi8(Trails, FirstTrails)));
+                _mm_storel_epi64((__m128i *)(Value + n + 16), _mm_or_si128(_mm_shuffle_epi8(Bytes, LastLeads), _mm_shuffle_epi8(Trails, LastTrails)));
+                i += 8;
+                n += 24;
+                continue;
+            }
+        }
+
+        Stop = i + 8 < ValueLength ? i + 8 : ValueLength;
+        n = CSFString_Decode_Scalar(Value, n, EncodedValue, ValueLength, &i, Stop, InPlace);
+
+        if(i < Stop)
+        {
+            break;
+        }
+    }
+
+    *Decoded = i;
+
+    return n;
+}
+
+__attribute__((target("avx2"))) static size_t
+CSFString_Encode_AVX2(uint8_t *EncodedValue, const uint8_t *Value, size_t ValueLength)
+{
+    __m256i Ones = _mm256_set1_epi8(-1);
+    __m128i LeadMask = _mm_set1_epi16(0xF0);
+    __m128i Lead = _mm_set1_epi16(0xE0);
+    __m128i TrailMask = _mm_set1_epi16(0xC0);
+    __m128i Trail = _mm_set1_epi16(0x80);
+    __m128i LowBits = _mm_set1_epi16(0x3F);
+    __m128i TwoBytes = _mm_set1_epi16((short)0xF800);
+    // Where the lead, middle and trail bytes of 8 chars are in 24 input bytes, loaded as bytes 0 to 15 and 8 to 23
+    __m128i LeadsFirst = _mm_setr_epi8(0, -1, 3, -1, 6, -1, 9, -1, 12, -1, 15, -1, -1, -1, -1, -1);
+    __m128i LeadsLast = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 10, -1, 13, -1);
+    __m128i MiddlesFirst = _mm_setr_epi8(1, -1, 4, -1, 7, -1, 10, -1, 13, -1, -1, -1, -1, -1, -1, -1);
+    __m128i MiddlesLast = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 8, -1, 11, -1, 14, -1);
+    __m128i TrailsFirst = _mm_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1);
+    __m128i TrailsLast = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 9, -1, 12, -1, 15, -1);
+    __m256i a;
+    __m128i First, Last, Leads, Middles, Trails, c, Invalid;
+    size_t i, n, Stop;
+
+    for(i = 0, n = 0; i < ValueLength; )
+    {
+        if(i + 32 <= ValueLength)
+        {
+            a = _mm256_loadu_si256((const __m256i *)(Value + i));
+
+            if(!_mm256_movemask_epi8(a))
+            {
+                _mm256_storeu_si256((__m256i *)(EncodedValue + n * 2), _mm256_xor_si256(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)), Ones));
+                _mm256_storeu_si256((__m256i *)(EncodedValue + n * 2 + 32), _mm256_xor_si256(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(a, 1)), Ones));
+                i += 32;
+                n += 32;
+                continue;
+            }
+        }
+
+        // 8 chars of 3 bytes become 8 units
+        if(i + 24 <= ValueLength)
+        {
+            First = _mm_loadu_si128((const __m128i *)(Value + i));
+            Last = _mm_loadu_si128((const __m128i *)(Value + i + 8));
+
+            Leads = _mm_or_si128(_mm_shuffle_epi8(First, LeadsFirst), _mm_shuffle_epi8(Last, LeadsLast));
+            Middles = _mm_or_si128(_mm_shuffle_epi8(First, MiddlesFirst), _mm_shuffle_epi8(Last, MiddlesLast));
+            Trails = _mm_or_si128(_mm_shuffle_epi8(First, TrailsFirst), _mm_shuffle_epi8(Last, TrailsLast));
+
+            c = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_and_si128(Leads, _mm_set1_epi16(0x0F)), 12), _mm_slli_epi16(_mm_and_si128(Middles, LowBits), 6)), _mm_and_si128(Trails, LowBits));
+
+            // Anything else than a lead byte and two trail bytes, or a char below U+0800 that has too many bytes, goes through the scalar kernel
+            Invalid = _mm_or_si128(_mm_cmpeq_epi16(_mm_and_si128(c, TwoBytes), _mm_setzero_si128()), _mm_xor_si128(_mm_cmpeq_epi16(_mm_and_si128(Leads, LeadMask), Lead), _mm256_castsi256_si128(Ones)));
+            Invalid = _mm_or_si128(Invalid, _mm_xor_si128(_mm_cmpeq_epi16(_mm_and_si128(Middles, TrailMask), Trail), _mm256_castsi256_si128(Ones)));
+            Invalid = _mm_or_si128(Invalid, _mm_xor_si128(_mm_cmpeq_epi16(_mm_and_si128(Trails, TrailMask), Trail), _mm256_castsi256_si128(Ones)));
+
+            if(!_mm_movemask_epi8(Invalid))
+            {
+                _mm_storeu_si128((__m128i *)(EncodedValue + n * 2), _mm_xor_si128(c, _mm256_castsi256_si128(Ones)));
+                i += 24;
+                n += 8;
+                continue;
+            }
+        }
+
+        Stop = i + 16 < ValueLength ? i + 16 : ValueLength;
+        n = CSFString_Encode_Scalar(EncodedValue, n, Value, ValueLength, &i, Stop);
+    }
+
+    return n;
+}
+#endif
+
+size_t
+CSFString_Decode(char *Value, const uint8_t *EncodedValue, size_t ValueLength, size_t *Decoded)
+{
+    int InPlace;
+
+    // Decode (not) ValueLength UTF-16LE units to UTF-8 and return its length in bytes, Value needs to hold ValueLength * 3 bytes
+    // Surrogate pairs become one 4 byte char, a lone surrogate becomes a 3 byte char of its own, so nothing is lost
+    // Value may be EncodedValue itself to decode in place, then it stops at the first char that doesn't fit anymore
+    // Decoded is set to the number of units that were decoded, the rest is left as it was
+    InPlace = (const uint8_t *)Value == EncodedValue;
+    *Decoded = 0;
+
+#ifdef CSF_SIMD_X86
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return CSFString_Decode_AVX2((uint8_t *)Value, EncodedValue, ValueLength, Decoded, InPlace);
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        return CSFString_Decode_SSE2((uint8_t *)Value, EncodedValue, ValueLength, Decoded, InPlace);
+    }
+#endif
+
+    return CSFString_Decode_Scalar((uint8_t *)Value, 0, EncodedValue, ValueLength, Decoded, ValueLength, InPlace);
+}
+
+size_t
+CSFString_Encode(uint8_t *EncodedValue, const char *Value, size_t ValueLength)
+{
+    size_t i = 0;
+
+    // Encode ValueLength bytes of UTF-8 as notted UTF-16LE units and return how many there are, EncodedValue needs to hold ValueLength * 2 bytes
+#ifdef CSF_SIMD_X86
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return CSFString_Encode_AVX2(EncodedValue, (const uint8_t *)Value, ValueLength);
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        return CSFString_Encode_SSE2(EncodedValue, (const uint8_t *)Value, ValueLength);
+    }
+#endif
+
+    return CSFString_Encode_Scalar(EncodedValue, 0, (const uint8_t *)Value, ValueLength, &i, ValueLength);
+}
+
+static int
+CSFString_EqualUnit(const uint8_t *EncodedValue, size_t n, uint32_t c)
+{
+    return EncodedValue[n * 2] == (uint8_t)~(c & 0xFF) && EncodedValue[n * 2 + 1] == (uint8_t)~(c >> 8);
+}
+
+static int
+CSFString_EqualEncoded_Scalar(const uint8_t *Value, size_t ValueLength, const uint8_t *EncodedValue, size_t EncodedLength, size_t *i, size_t *n, size_t Stop)
+{
+    uint32_t c;
+    size_t Length;
+
+    // Same as CSFString_Encode_Scalar, but every unit is compared instead of written, returns 0 at the first one that differs
+    for(; *i < Stop; *i += Length)
+    {
+        c = CSFString_EncodeChar(Value, ValueLength, *i, &Length);
+
+        if(c >= 0x10000)
+        {
+            c -= 0x10000;
+
+            if(*n + 1 >= EncodedLength || !CSFString_EqualUnit(EncodedValue, *n, 0xD800 | c >> 10) || !CSFString_EqualUnit(EncodedValue, *n + 1, 0xDC00 | (c & 0x3FF)))
+            {
+                return 0;
+            }
+
+            *n += 2;
+        }
+        else
+        {
+            if(*n >= EncodedLength || !CSFString_EqualUnit(EncodedValue, *n, c))
+            {
+                return 0;
+            }
+
+            *n += 1;
+        }
+    }
+
+    return 1;
+}
+
+#ifdef CSF_SIMD_X86
+__attribute__((target("sse2"))) static int
+CSFString_EqualEncoded_SSE2(const uint8_t *Value, size_t ValueLength, const uint8_t *EncodedValue, size_t EncodedLength)
+{
+    __m128i Ones = _mm_set1_epi8(-1);
+    __m128i a;
+    size_t i, n, Stop;
+
+    // 16 ASCII chars are widened and notted and compared with 16 units at once, anything else goes through the scalar compare
+    for(i = 0, n = 0; i < ValueLength; )
+    {
+        if(i + 16 <= ValueLength && n + 16 <= EncodedLength)
+        {
+            a = _mm_loadu_si128((const __m128i *)(Value + i));
+
+            if(!_mm_movemask_epi8(a))
+            {
+                if(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(_mm_xor_si128(_mm_unpacklo_epi8(a, _mm_setzero_si128()), Ones), _mm_loadu_si128((const __m128i *)(EncodedValue + n * 2))),
+                    _mm_cmpeq_epi8(_mm_xor_si128(_mm_unpackhi_epi8(a, _mm_setzero_si128()), Ones), _mm_loadu_si128((const __m128i *)(EncodedValue + n * 2 + 16))))) != 0xFFFF)
+                {
+                    return 0;
+                }
+
+                i += 16;
+                n += 16;
+                continue;
+            }
+        }
+
+        Stop = i + 16 < ValueLength ? i + 16 : ValueLength;
+
+        if(!CSFString_EqualEncoded_Scalar(Value, ValueLength, EncodedValue, EncodedLength, &i, &n, Stop))
+        {
+            return 0;
+        }
+    }
+
+    return n == EncodedLength;
+}
+
+__attribute__((target("avx2"))) static int
+CSFString_EqualEncoded_AVX2(const uint8_t *Value, size_t ValueLength, const uint8_t *EncodedValue, size_t EncodedLength)
+{
+    __m256i Ones = _mm256_set1_epi8(-1);
+    __m128i a;
+    size_t i, n, Stop;
+
+    for(i = 0, n = 0; i < ValueLength; )
+    {
+        if(i + 16 <= ValueLength && n + 16 <= EncodedLength)
+        {
+            a = _mm_loadu_si128((const __m128i *)(Value + i));
+
+            if(!_mm_movemask_epi8(a))
+            {
+                if((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_xor_si256(_mm256_cvtepu8_epi16(a), Ones), _mm256_loadu_si256((const __m256i *)(EncodedValue + n * 2)))) != 0xFFFFFFFF)
+                {
+                    return 0;
+                }
+
+                i += 16;
+                n += 16;
+                continue;
+            }
+        }
+
+        Stop = i + 16 < ValueLength ? i + 16 : ValueLength;
+
+        if(!CSFString_EqualEncoded_Scalar(Value, ValueLength, EncodedValue, EncodedLength, &i, &n, Stop))
+        {
+            return 0;
+        }
+    }
+
+    return n == EncodedLength;
+}
+#endif
+
+int
+CSFString_EqualEncoded(const char *Value, size_t ValueLength, const uint8_t *EncodedValue, size_t EncodedLength)
+{
+    size_t i = 0, n = 0;
+
+    // Returns 1 if ValueLength bytes of UTF-8 are exactly the EncodedLength notted UTF-16LE units of EncodedValue, without encoding them anywhere
+    // It's the same as comparing the output of CSFString_Encode, but stops at the first unit that differs
+    // A char has at least as many bytes as units, so a longer encoded value can't be the same
+    if(EncodedLength > ValueLength)
+    {
+        return 0;
+    }
+
+#ifdef CSF_SIMD_X86
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return CSFString_EqualEncoded_AVX2((const uint8_t *)Value, ValueLength, EncodedValue, EncodedLength);
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        return CSFString_EqualEncoded_SSE2((const uint8_t *)Value, ValueLength, EncodedValue, EncodedLength);
+    }
+#endif
+
+    return CSFString_EqualEncoded_Scalar((const uint8_t *)Value, ValueLength, EncodedValue, EncodedLength, &i, &n, ValueLength) && n == EncodedLength;
+}
+
+static int
+csf_memmem_equal(const uint8_t *a, const uint8_t *b, size_t size, int IgnoreCase)
+{
+    size_t i;
+
+    if(!IgnoreCase)
+    {
+        return !memcmp(a, b, size);
+    }
+
+    for(i = 0; i < size && tolower(a[i]) == tolower(b[i]); i++);
+
+    return i == size;
+}
+
+static const uint8_t *
+csf_memmem_Scalar(const uint8_t *Haystack, size_t HaystackLength, const uint8_t *Needle, size_t NeedleLength, int IgnoreCase, size_t i)
+{
+    // Starts at i, so the SIMD versions can leave the last few bytes to this
+    for(; i + NeedleLength <= HaystackLength; i++)
+    {
+        if(csf_memmem_equal(Haystack + i, Needle, NeedleLength, IgnoreCase))
+        {
+            return Haystack + i;
+        }
+    }
+
+    return NULL;
+}
+
+#ifdef CSF_SIMD_X86
+__attribute__((target("sse2"))) static const uint8_t *
+csf_memmem_SSE2(const uint8_t *Haystack, size_t HaystackLength, const uint8_t *Needle, size_t NeedleLength, int IgnoreCase)
+{
+    __m128i First = _mm_set1_epi8((char)Needle[0]);
+    __m128i Last = _mm_set1_epi8((char)Needle[NeedleLength - 1]);
+    __m128i OtherFirst = _mm_set1_epi8((char)(IgnoreCase ? toupper(Needle[0]) : Needle[0]));
+    __m128i OtherLast = _mm_set1_epi8((char)(IgnoreCase ? toupper(Needle[NeedleLength - 1]) : Needle[NeedleLength - 1]));
+    __m128i a, b;
+    unsigned int Mask;
+    size_t i;
+
+    // 16 possible starts at a time, only those where the first and the last byte of Needle match are compared in full
+    for(i = 0; i + NeedleLength + 15 <= HaystackLength; i += 16)
+    {
+        a = _mm_loadu_si128((const __m128i *)(Haystack + i));
+        b = _mm_loadu_si128((const __m128i *)(Haystack + i + NeedleLength - 1));
+
+        Mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_or_si128(_mm_cmpeq_epi8(a, First), _mm_cmpeq_epi8(a, OtherFirst)),
+            _mm_or_si128(_mm_cmpeq_epi8(b, Last), _mm_cmpeq_epi8(b, OtherLast))));
+
+        for(; Mask; Mask &= Mask - 1)
+        {
+            if(csf_memmem_equal(Haystack + i + __builtin_ctz(Mask), Needle, NeedleLength, IgnoreCase))
+            {
+                return Haystack + i + __builtin_ctz(Mask);
+            }
+        }
+    }
+
+    return csf_memmem_Scalar(Haystack, HaystackLength, Needle, NeedleLength, IgnoreCase, i);
+}
+
+__attribute__((target("avx2"))) static const uint8_t *
+csf_memmem_AVX2(const uint8_t *Haystack, size_t HaystackLength, const uint8_t *Needle, size_t NeedleLength, int IgnoreCase)
+{
+    __m256i First = _mm256_set1_epi8((char)Needle[0]);
+    __m256i Last = _mm256_set1_epi8((char)Needle[NeedleLength - 1]);
+    __m256i OtherFirst = _mm256_set1_epi8((char)(IgnoreCase ? toupper(Needle[0]) : Needle[0]));
+    __m256i OtherLast = _mm256_set1_epi8((char)(IgnoreCase ? toupper(Needle[NeedleLength - 1]) : Needle[NeedleLength - 1]));
+    __m256i a, b;
+    unsigned int Mask;
+    size_t i;
+
+    // Same as csf_memmem_SSE2, 32 possible starts at a time
+    for(i = 0; i + NeedleLength + 31 <= HaystackLength; i += 32)
+    {
+        a = _mm256_loadu_si256((const __m256i *)(Haystack + i));
+        b = _mm256_loadu_si256((const __m256i *)(Haystack + i + NeedleLength - 1));
+
+        Mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_or_si256(_mm256_cmpeq_epi8(a, First), _mm256_cmpeq_epi8(a, OtherFirst)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(b, Last), _mm256_cmpeq_epi8(b, OtherLast))));
+
+        for(; Mask; Mask &= Mask - 1)
+        {
+            if(csf_memmem_equal(Haystack + i + __builtin_ctz(Mask), Needle, NeedleLength, IgnoreCase))
+            {
+                return Haystack + i + __builtin_ctz(Mask);
+            }
+        }
+    }
+
+    return csf_memmem_Scalar(Haystack, HaystackLength, Needle, NeedleLength, IgnoreCase, i);
+}
+#endif
+
+const char *
+csf_memmem(const char *Haystack, size_t HaystackLength, const char *Needle, size_t NeedleLength, int IgnoreCase)
+{
+    // Returns where Needle first is in Haystack, or NULL, neither has to be null-terminated
+    // IgnoreCase only ignores the case of ASCII letters, with it Needle has to be lowercase already
+    if(!NeedleLength)
+    {
+        return Haystack;
+    }
+
+#ifdef CSF_SIMD_X86
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return (const char *)csf_memmem_AVX2((const uint8_t *)Haystack, HaystackLength, (const uint8_t *)Needle, NeedleLength, IgnoreCase);
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        return (const char *)csf_memmem_SSE2((const uint8_t *)Haystack, HaystackLength, (const uint8_t *)Needle, NeedleLength, IgnoreCase);
+    }
+#endif
+
+    return (const char *)csf_memmem_Scalar((const uint8_t *)Haystack, HaystackLength, (const uint8_t *)Needle, NeedleLength, IgnoreCase, 0);
+}
+
+static size_t
+csf_escape_length_Scalar(const uint8_t *Value, size_t ValueLength, size_t i)
+{
+    for(; i < ValueLength && Value[i] >= ' ' && Value[i] != '"' && Value[i] != '\\'; i++);
+
+    return i;
+}
+
+#ifdef CSF_SIMD_X86
+__attribute__((target("sse2"))) static size_t
+csf_escape_length_SSE2(const uint8_t *Value, size_t ValueLength)
+{
+    __m128i Control = _mm_set1_epi8(' ' - 1);
+    __m128i Quote = _mm_set1_epi8('"');
+    __m128i Backslash = _mm_set1_epi8('\\');
+    __m128i a;
+    unsigned int Mask;
+    size_t i;
+
+    // A byte is a control char if it's the same as its unsigned minimum with 0x1F
+    for(i = 0; i + 16 <= ValueLength; i += 16)
+    {
+        a = _mm_loadu_si128((const __m128i *)(Value + i));
+
+        Mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(a, Control), a),
+            _mm_or_si128(_mm_cmpeq_epi8(a, Quote), _mm_cmpeq_epi8(a, Backslash))));
+
+        if(Mask)
+        {
+            return i + __builtin_ctz(Mask);
+        }
+    }
+
+    return csf_escape_length_Scalar(Value, ValueLength, i);
+}
+
+__attribute__((target("avx2"))) static size_t
+csf_escape_length_AVX2(const uint8_t *Value, size_t ValueLength)
+{
+    __m256i Control = _mm256_set1_epi8(' ' - 1);
+    __m256i Quote = _mm256_set1_epi8('"');
+    __m256i Backslash = _mm256_set1_epi8('\\');
+    __m256i a;
+    unsigned int Mask;
+    size_t i;
+
+    for(i = 0; i + 32 <= ValueLength; i += 32)
+    {
+        a = _mm256_loadu_si256((const __m256i *)(Value + i));
+
+        Mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(a, Control), a),
+            _mm256_or_si256(_mm256_cmpeq_epi8(a, Quote), _mm256_cmpeq_epi8(a, Backslash))));
+
+        if(Mask)
+        {
+            return i + __builtin_ctz(Mask);
+        }
+    }
+
+    return csf_escape_length_Scalar(Value, ValueLength, i);
+}
+#endif
+
+size_t
+csf_escape_length(const char *Value, size_t ValueLength)
+{
+    // Returns how many bytes at the start of Value none of the text formats has to escape, i.e. up to the first control char, quote or backslash
+    // Writers copy that much as it is and only look at the byte after it themselves
+#ifdef CSF_SIMD_X86
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return csf_escape_length_AVX2((const uint8_t *)Value, ValueLength);
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        return csf_escape_length_SSE2((const uint8_t *)Value, ValueLength);
+    }
+#endif
+
+    return csf_escape_length_Scalar((const uint8_t *)Value, ValueLength, 0);
 }
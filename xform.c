@@ -0,0 +1,247 @@
+#include "csftools.h"
+
+static int
+CSFTransform_CompareRecords(const void *a, const void *b)
+{
+    const CSFTransformRecord *RecordA = a;
+    const CSFTransformRecord *RecordB = b;
+    uint32_t i;
+    int Difference;
+
+    // By LabelName without case like the game looks them up, and by Index for equal ones, so the sort is stable
+    for(i = 0; i < RecordA->LabelNameLength && i < RecordB->LabelNameLength; i++)
+    {
+        if((Difference = tolower((unsigned char)RecordA->LabelName[i]) - tolower((unsigned char)RecordB->LabelName[i])))
+        {
+            return Difference;
+        }
+    }
+
+    if(RecordA->LabelNameLength != RecordB->LabelNameLength)
+    {
+        return RecordA->LabelNameLength < RecordB->LabelNameLength ? -1 : 1;
+    }
+
+    return RecordA->Index < RecordB->Index ? -1 : RecordA->Index > RecordB->Index;
+}
+
+static int
+CSFTransform_HasPrefix(CSFTransform *Transform, CSFLabel *Label)
+{
+    size_t Prefix_Len;
+    uint32_t i, j;
+
+    if(!Transform->NumPrefixes)
+    {
+        return 1;
+    }
+
+    for(i = 0; i < Transform->NumPrefixes; i++)
+    {
+        Prefix_Len = strlen(Transform->Prefix[i]);
+
+        for(j = 0; j < Prefix_Len && j < Label->LabelNameLength; j++)
+        {
+            if(tolower((unsigned char)Label->LabelName[j]) != tolower((unsigned char)Transform->Prefix[i][j]))
+            {
+                break;
+            }
+        }
+
+        if(j == Prefix_Len)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void
+CSFTransform_Init(CSFTransform *Transform)
+{
+    // Changes nothing until told otherwise
+    memset(Transform, 0, sizeof(CSFTransform));
+
+    Transform->LanguageId = -1;
+    Transform->CSFVersion = -1;
+}
+
+int
+CSFFile_Transform(CSFContext *Context, char *InputFile_Path, char *OutputFile_Path, CSFTransform *Transform)
+{
+    CSFReader *Reader;
+    CSFLabel *Label;
+    CSFHeader CSFFile_Header;
+    CSFTransformRecord *Record = NULL;
+    uint32_t NumRecords = 0;
+    FILE *InputFile_Handle = NULL;
+    FILE *OutputFile_Handle = NULL;
+    CSFWriteBuffer *OutputFile_Buffer = NULL;
+    char *TempFile_Path = NULL;
+    size_t RunOffset, RunSize;
+    uint64_t Start, TotalStart;
+    uint32_t i;
+
+    // Changes the header of a CSF file and which Labels it has in which order, without decoding or encoding any of them
+    // Every Label that's kept is copied byte for byte from the input, adjacent ones together, so large runs are copied by the kernel
+    TotalStart = csf_stats_start(Context);
+
+    Start = csf_stats_start(Context);
+
+    if((Reader = CSFReader_Open(Context, InputFile_Path, 1)) && !Reader->Mapped)
+    {
+        csf_error(Context, CSF_ERROR_OPEN, "Input has to be a regular file, not a pipe: ", InputFile_Path, strlen(InputFile_Path));
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_OPEN, Start);
+
+    if(Context->Error)
+    {
+        goto done;
+    }
+
+    // Values stay encoded, only where each Label starts and ends is needed
+    Reader->Prescan = 1;
+
+    if(!(Record = malloc_c(Context, Reader->Header.NumLabels * sizeof(CSFTransformRecord) + 1)))
+    {
+        goto done;
+    }
+
+    memcpy(&CSFFile_Header, &Reader->Header, sizeof(CSFHeader));
+
+    Start = csf_stats_start(Context);
+
+    for(i = 0; (Label = CSFReader_Next(Reader)); i++)
+    {
+        // Labels without a String or with an empty value and no ExtraValue count as empty
+        if((Transform->DropEmpty && (!Label->NumStringPairs || (!Label->String->ValueLength && !Label->String->ExtraValueLength)))
+            || !CSFTransform_HasPrefix(Transform, Label))
+        {
+            CSFFile_Header.NumLabels--;
+            CSFFile_Header.NumStrings -= Label->NumStringPairs < CSFFile_Header.NumStrings ? Label->NumStringPairs : CSFFile_Header.NumStrings;
+            continue;
+        }
+
+        Record[NumRecords].Offset = Reader->LabelOffset;
+        Record[NumRecords].Size = Reader->Offset - Reader->LabelOffset;
+        Record[NumRecords].LabelName = Label->LabelName;
+        Record[NumRecords].LabelNameLength = Label->LabelNameLength;
+        Record[NumRecords].Index = i;
+        NumRecords++;
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_PARSE, Start);
+
+    if(Context->Error)
+    {
+        goto done;
+    }
+
+    if(Transform->Sort)
+    {
+        qsort(Record, NumRecords, sizeof(CSFTransformRecord), CSFTransform_CompareRecords);
+    }
+
+    if(Transform->LanguageId != -1)
+    {
+        CSFFile_Header.Language = (uint32_t)Transform->LanguageId;
+    }
+
+    if(Transform->CSFVersion != -1)
+    {
+        CSFFile_Header.CSFVersion = (uint32_t)Transform->CSFVersion;
+    }
+
+    csf_log(Context, CSF_LOG_INFO, "Keeping %u of %u Labels", NumRecords, Reader->Header.NumLabels);
+
+    // The input may be the output file and is still mapped, so write to a temporary file and replace the output with it at the end
+    if(strcmp(OutputFile_Path, "-"))
+    {
+        if(!(TempFile_Path = malloc_c(Context, strlen(OutputFile_Path) + sizeof(".tmp"))))
+        {
+            goto done;
+        }
+
+        sprintf(TempFile_Path, "%s.tmp", OutputFile_Path);
+    }
+
+    Start = csf_stats_start(Context);
+
+    // The kernel copies from a file descriptor of the input, the mapping is only for what's written through the buffer
+    if((InputFile_Handle = fopen_c(Context, InputFile_Path, "rb"))
+        && (OutputFile_Handle = fopen_c(Context, TempFile_Path ? TempFile_Path : OutputFile_Path, "wb")))
+    {
+        OutputFile_Buffer = writebuffer_create(Context, OutputFile_Handle);
+    }
+
+    if(OutputFile_Buffer)
+    {
+        writebuffer_write(OutputFile_Buffer, &CSFFile_Header, sizeof(CSFHeader));
+
+        for(i = 0; i < NumRecords && !Context->Error; i++)
+        {
+            RunOffset = Record[i].Offset;
+            RunSize = Record[i].Size;
+
+            while(i + 1 < NumRecords && Record[i + 1].Offset == RunOffset + RunSize)
+            {
+                RunSize += Record[++i].Size;
+            }
+
+            writebuffer_copy(OutputFile_Buffer, InputFile_Handle, Reader->Data, RunOffset, RunSize);
+        }
+
+        writebuffer_close(OutputFile_Buffer);
+    }
+
+    if(OutputFile_Handle && fclose_c(OutputFile_Handle))
+    {
+        csf_error(Context, CSF_ERROR_WRITE, "Couldn't write to ", OutputFile_Path, strlen(OutputFile_Path));
+    }
+
+    if(InputFile_Handle)
+    {
+        fclose(InputFile_Handle);
+        InputFile_Handle = NULL;
+    }
+
+    // The input can't be replaced while it's mapped
+    CSFReader_Close(Reader);
+    Reader = NULL;
+
+    if(OutputFile_Handle && TempFile_Path)
+    {
+        // Windows can't rename over an existing file
+#ifdef _WIN32
+        if(!Context->Error)
+        {
+            remove(OutputFile_Path);
+        }
+#endif
+
+        if(Context->Error || rename(TempFile_Path, OutputFile_Path))
+        {
+            remove(TempFile_Path);
+            csf_error(Context, CSF_ERROR_WRITE, "Couldn't replace ", OutputFile_Path, strlen(OutputFile_Path));
+        }
+    }
+
+    csf_stats_stop(Context, CSF_STAT_TIME_WRITE, Start);
+
+done:
+    // Release everything, done
+    if(InputFile_Handle)
+    {
+        fclose(InputFile_Handle);
+    }
+
+    free(TempFile_Path);
+    free(Record);
+    CSFReader_Close(Reader);
+
+    csf_stats_stop(Context, CSF_STAT_TIME_TOTAL, TotalStart);
+
+    return Context->Error;
+}